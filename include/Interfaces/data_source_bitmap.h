@@ -0,0 +1,49 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "Interfaces/data_source.h"
+#include "include/data_code/fic_search_index.h"
+
+#include <optional>
+
+// Evaluates search filters as bitmap algebra over FicSearchIndex
+// and only loads the page of survivors from the database.
+// Filters that can't be expressed over the index (text search, randomization, real genres etc.)
+// are passed to the wrapped FicSourceDirect as is.
+class FicSourceBitmap : public FicSource
+{
+public:
+    FicSourceBitmap(QSharedPointer<const core::FicSearchIndex> index, QSharedPointer<FicSourceDirect> directSource);
+    virtual ~FicSourceBitmap() = default;
+    virtual void FetchData(const core::StoryFilter &filter, QVector<core::Fanfic>*) override;
+    int GetFicCount(const core::StoryFilter &filter) override;
+
+    bool CanEvaluate(const core::StoryFilter &filter) const;
+    Roaring Evaluate(const core::StoryFilter &filter) const;
+    // sorted survivors of the requested page
+    std::vector<uint32_t> SortAndPage(const Roaring& fics, const core::StoryFilter &filter) const;
+
+    QSharedPointer<const core::FicSearchIndex> index;
+    QSharedPointer<FicSourceDirect> directSource;
+
+private:
+    Roaring IgnoredFandomFics() const;
+    Roaring SlashFics(const core::StoryFilter &filter) const;
+    Roaring ActiveFics(const core::StoryFilter &filter) const;
+    std::optional<std::vector<size_t>> GenreIndices(const QStringList& genres) const;
+};
@@ -99,6 +99,9 @@ class Fanfics : public IDBWebIDIndex {
     QHash<int, core::FicWeightPtr> GetHashOfAllFicsWithEnoughFavesForWeights(int faves);
 
     bool ProcessSlashFicsBasedOnWords( std::function<SlashPresence (QString, QString, QString)> func);
+    bool ProcessFicsForSearchIndex(std::function<void(const core::FicSearchRecord&)> processor);
+    // db id, ffn id in ascending order of db id
+    bool ProcessFicIdPairs(std::function<void(int, int)> processor);
 
     bool AssignChapter(int, int);
     bool AssignScore(int, int);
@@ -115,6 +118,8 @@ class Fanfics : public IDBWebIDIndex {
     // to return an ID list for recommendations creator
     QSet<int> ConvertFFNSourceFicsToDB(QString userToken);
     QHash<uint32_t, core::FicWeightPtr> GetFicsForRecCreation();
+    // same data as GetFicsForRecCreation, looked up by database id
+    QHash<uint32_t, core::FicWeightPtr> GetFicsForRecCreation(QList<int> ids);
 
     bool ConvertFFNTaggedFicsToDB(QHash<int, int>& hash);
     bool ConvertDBFicsToFFN(QHash<int, int>& hash);
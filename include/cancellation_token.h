@@ -0,0 +1,110 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+
+// Tells long running work that nobody is waiting for its result anymore.
+// Copies share the state, a default constructed token is never cancelled.
+// The check function is polled at most once per pollInterval, whatever captures it has to outlive every copy of the token.
+class CancellationToken
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    static constexpr std::chrono::milliseconds pollInterval{1};
+
+    CancellationToken() = default;
+    CancellationToken(std::function<bool()> check, Clock::time_point deadline = Clock::time_point::max())
+        : state(std::make_shared<State>())
+    {
+        state->check = std::move(check);
+        state->deadline = deadline;
+    }
+
+    bool IsCancelled() const{
+        if(!state)
+            return false;
+        if(state->cancelled.load(std::memory_order_relaxed))
+            return true;
+        const auto now = Clock::now();
+        if(now >= state->deadline)
+        {
+            state->cancelled = true;
+            return true;
+        }
+        if(state->check)
+        {
+            const auto ticks = now.time_since_epoch().count();
+            auto nextPoll = state->nextPoll.load(std::memory_order_relaxed);
+            // a single thread polls at a time, the others go on with their work
+            if(ticks >= nextPoll
+                    && state->nextPoll.compare_exchange_strong(nextPoll, ticks + std::chrono::duration_cast<Clock::duration>(pollInterval).count())
+                    && state->check())
+            {
+                state->cancelled = true;
+                return true;
+            }
+        }
+        return false;
+    }
+    void Cancel(){
+        if(!state)
+            state = std::make_shared<State>();
+        state->cancelled = true;
+    }
+
+private:
+    struct State{
+        std::atomic<bool> cancelled{false};
+        std::atomic<Clock::rep> nextPoll{0};
+        std::function<bool()> check;
+        Clock::time_point deadline = Clock::time_point::max();
+    };
+    std::shared_ptr<State> state;
+};
+
+// makes the token of the request visible to code it can't be passed to,
+// like the progress handler of the thread's sqlite connections
+class CancellationScope
+{
+public:
+    explicit CancellationScope(const CancellationToken& token):previous(CurrentSlot()){
+        CurrentSlot() = &token;
+    }
+    ~CancellationScope(){
+        CurrentSlot() = previous;
+    }
+    CancellationScope(const CancellationScope&) = delete;
+    CancellationScope& operator=(const CancellationScope&) = delete;
+
+    // the token of the innermost scope on this thread
+    static const CancellationToken& Current(){
+        static const CancellationToken never;
+        const auto* token = CurrentSlot();
+        return token ? *token : never;
+    }
+
+private:
+    static const CancellationToken*& CurrentSlot(){
+        thread_local const CancellationToken* current = nullptr;
+        return current;
+    }
+    const CancellationToken* previous = nullptr;
+};
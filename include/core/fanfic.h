@@ -189,7 +189,8 @@ struct FanficDataForRecommendationCreation
     int authorId = -1;
 
     QList<int> fandoms;
-    QStringList genres;
+    // genre_stats::GenreMask() of every genre in genreString
+    uint32_t genreMask = 0;
 
     QString genreString;
 
@@ -210,6 +211,25 @@ inline QTextStream &operator<<(QTextStream &out, const FanficDataForRecommendati
 
 typedef QSharedPointer<FanficDataForRecommendationCreation> FicWeightPtr;
 
+// attributes of a fic that the in-memory search index is built from
+struct FicSearchRecord
+{
+    int id = -1;
+    int fandom1 = -1;
+    int fandom2 = -1;
+    int wordCount = 0;
+    int favourites = 0;
+    int reviews = 0;
+    bool complete = false;
+    bool ratedM = false;
+    bool keywordsResult = false;
+    bool filterPass1 = false;
+    bool filterPass2 = false;
+    QString genreString;
+    QDate published;
+    QDate updated;
+};
+
 struct FanficCompletionStatus{
     int ficId = -1;
     bool finished = false;
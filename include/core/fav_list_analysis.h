@@ -69,6 +69,7 @@ struct FicListDataAccumulator{
     // favs, explorer, megaexplorer, fav size category
     void AddFavourites(int favCount);
     void AddFandoms(const QList<int>& fandoms);
+    void AddFandoms(int fandom1, int fandom2);
     // wordcount average fic wordcount, size factors
     void AddWordcount(int wordcount, int chapters);
     void ProcessIntoResult();
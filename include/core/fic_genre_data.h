@@ -20,16 +20,167 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include <QVector>
 #include <QStringList>
 #include <QDataStream>
+#include <QHash>
 #include "logger/QsLog.h"
 #include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 
 namespace genre_stats
 {
 
+// fixed genre enumeration
+// values match the indices of interfaces::GenreIndex and are the bit positions of every genre mask
+enum EGenre{
+    g_general       = 0,
+    g_humor         = 1,
+    g_poetry        = 2,
+    g_adventure     = 3,
+    g_mystery       = 4,
+    g_horror        = 5,
+    g_parody        = 6,
+    g_angst         = 7,
+    g_supernatural  = 8,
+    g_suspense      = 9,
+    g_romance       = 10,
+    g_not_found     = 11,
+    g_scifi         = 12,
+    g_fantasy       = 13,
+    g_spiritual     = 14,
+    g_tragedy       = 15,
+    g_western       = 16,
+    g_crime         = 17,
+    g_family        = 18,
+    g_hurt_comfort  = 19,
+    g_friendship    = 20,
+    g_drama         = 21,
+    g_count         = 22,
+};
+
+// moods that list mood statistics are accumulated into
+enum EGenreMood{
+    gm_none         = 0,
+    gm_neutral      = 1,
+    gm_funny        = 2,
+    gm_shocky       = 3,
+    gm_flirty       = 4,
+    gm_dramatic     = 5,
+    gm_hurty        = 6,
+    gm_bondy        = 7,
+    gm_count        = 8,
+};
+
+constexpr std::array<const char*, g_count> genreNames = {{
+    "General", "Humor", "Poetry", "Adventure", "Mystery", "Horror", "Parody", "Angst",
+    "Supernatural", "Suspense", "Romance", "not found", "Sci-Fi", "Fantasy", "Spiritual",
+    "Tragedy", "Western", "Crime", "Family", "Hurt/Comfort", "Friendship", "Drama"
+}};
+
+constexpr std::array<const char*, gm_count> moodNames = {{
+    "", "Neutral", "Funny", "Shocky", "Flirty", "Dramatic", "Hurty", "Bondy"
+}};
+
+constexpr std::array<EGenreMood, g_count> genreMoods = {{
+    gm_none,        // General
+    gm_funny,       // Humor
+    gm_none,        // Poetry
+    gm_neutral,     // Adventure
+    gm_neutral,     // Mystery
+    gm_shocky,      // Horror
+    gm_funny,       // Parody
+    gm_dramatic,    // Angst
+    gm_neutral,     // Supernatural
+    gm_neutral,     // Suspense
+    gm_flirty,      // Romance
+    gm_none,        // not found
+    gm_neutral,     // Sci-Fi
+    gm_neutral,     // Fantasy
+    gm_neutral,     // Spiritual
+    gm_dramatic,    // Tragedy
+    gm_neutral,     // Western
+    gm_neutral,     // Crime
+    gm_bondy,       // Family
+    gm_hurty,       // Hurt/Comfort
+    gm_bondy,       // Friendship
+    gm_dramatic     // Drama
+}};
+
+constexpr uint32_t GenreMask(EGenre genre){return 1u << genre;}
+constexpr uint32_t MoodMask(EGenreMood mood){return mood == gm_none ? 0u : 1u << mood;}
+
+// bit per mood of the genres in the mask, gm_none is never set
+constexpr uint32_t MoodMaskForGenres(uint32_t genreMask){
+    uint32_t result = 0;
+    for(int genre = 0; genre < g_count; genre++)
+        if(genreMask & (1u << genre))
+            result |= MoodMask(genreMoods[genre]);
+    return result;
+}
+
+// -1 for names that aren't ffn genres
+inline int GenreForName(const QString& name){
+    static const QHash<QString, int> genres = [](){
+        QHash<QString, int> result;
+        for(int genre = 0; genre < g_count; genre++)
+            result[QString::fromLatin1(genreNames[genre])] = genre;
+        return result;
+    }();
+    return genres.value(name.trimmed(), -1);
+}
+
+inline EGenreMood MoodForName(const QString& name){
+    for(int mood = gm_neutral; mood < gm_count; mood++)
+        if(name == QLatin1String(moodNames[mood]))
+            return static_cast<EGenreMood>(mood);
+    return gm_none;
+}
+
+inline uint32_t GenreMaskFromNames(const QStringList& names){
+    uint32_t mask = 0;
+    for(const auto& name : names)
+    {
+        auto genre = GenreForName(name);
+        if(genre >= 0)
+            mask |= 1u << genre;
+    }
+    return mask;
+}
+
+// ffn genre string as it's stored in fanfics.genres, "Hurt/Comfort" is the only genre that contains a slash
+inline uint32_t GenreMaskFromString(const QString& genreString){
+    uint32_t mask = 0;
+    if(genreString.isEmpty())
+        return mask;
+    QString rest = genreString;
+    if(rest.contains(QStringLiteral("Hurt/Comfort")))
+    {
+        mask |= GenreMask(g_hurt_comfort);
+        rest.remove(QStringLiteral("Hurt/Comfort"));
+    }
+    return mask | GenreMaskFromNames(rest.split(QStringLiteral("/"), Qt::SkipEmptyParts));
+}
+
 struct GenreBit
 {
+    // fixed point relevance, relevanceOne corresponds to 1.0
+    static constexpr int relevanceOne = 1 << 12;
+    static uint16_t ToFixedRelevance(float value){
+        return static_cast<uint16_t>(std::clamp(std::lround(value * relevanceOne), 0l, 65535l));
+    }
+
+    // fills genreMask and weight from genres and relevance
+    // needs to be called whenever either of them is changed
+    void UpdateMask(){
+        genreMask = GenreMaskFromNames(genres);
+        weight = ToFixedRelevance(relevance);
+    }
+    float Weight() const {return static_cast<float>(weight)/relevanceOne;}
+
     QStringList genres;
     float relevance = 0.f;
+    uint32_t genreMask = 0;
+    uint16_t weight = 0;
     bool isDetected = false;
     bool isInTheOriginal = false;
     void Log(){
@@ -71,6 +222,7 @@ inline QDataStream &operator>>(QDataStream & in, GenreBit & data){
     in >> data.relevance;
     in >> data.isDetected;
     in >> data.isInTheOriginal;
+    data.UpdateMask();
     return in;
 }
 
@@ -163,6 +315,30 @@ struct ListMoodData
     float strengthNonHurty =0.0f;
 
     float strengthOther =0.0f;
+    float MoodValue(EGenreMood mood) const{
+        switch(mood){
+        case gm_neutral: return strengthNeutral;
+        case gm_funny: return strengthFunny;
+        case gm_shocky: return strengthShocky;
+        case gm_flirty: return strengthFlirty;
+        case gm_dramatic: return strengthDramatic;
+        case gm_hurty: return strengthHurty;
+        case gm_bondy: return strengthBondy;
+        default: return 0.f;
+        }
+    }
+    void AddMoodValue(EGenreMood mood, float value){
+        switch(mood){
+        case gm_neutral: strengthNeutral+=value; break;
+        case gm_funny: strengthFunny+=value; break;
+        case gm_shocky: strengthShocky+=value; break;
+        case gm_flirty: strengthFlirty+=value; break;
+        case gm_dramatic: strengthDramatic+=value; break;
+        case gm_hurty: strengthHurty+=value; break;
+        case gm_bondy: strengthBondy+=value; break;
+        default: break;
+        }
+    }
     void DivideByCount(int count){
         strengthNone =strengthNone/static_cast<float>(count);
         strengthNeutral=strengthNeutral/static_cast<float>(count);
@@ -277,6 +453,8 @@ struct GenreMoodData{
     std::array<double, 22> listGenreData;
     genre_stats::ListMoodData listMoodData;
     QStringList moodAxis;
+    // MoodMask() of every mood in moodAxis
+    uint32_t moodAxisMask = 0;
 };
 
 
@@ -63,11 +63,16 @@ public:
         ficData.reset(new RecommendationListFicData());
     }
     static RecPtr NewRecList() { return QSharedPointer<RecommendationList>(new RecommendationList);}
+    // "fics similar to X" list, the server answers these from its similar fic table
+    // for as long as nothing but the source fic and the list name is changed
+    static RecPtr NewSimilarFicList();
+    static constexpr int similarFicListSize = 90;
+    // true if the calculation params are the ones of NewSimilarFicList and there's no user data to apply
+    bool IsSimilarFicList() const;
     void Log();
     void PassSetupParamsInto(RecommendationList& other);
     bool success = false;
     bool isAutomatic = true;
-    bool adjusting = false;
     bool useWeighting = false;
     bool useMoodAdjustment = false;
     bool hasAuxDataFilled = false;
@@ -87,6 +92,10 @@ public:
     int ficFavouritesCutoff = 0;
     int resultLimit = 0;
     uint16_t ratioCutoff = std::numeric_limits<uint16_t>::max();
+    // candidate recommenders are picked by their sketches instead of being every list that shares a fic with the user
+    // the value is the estimated share of a recommender's list the user needs to have for them to be counted exactly
+    // lower values keep more of the exact candidates at the cost of counting more of them, 0 counts all of them
+    double sketchContainment = 0;
 
     double quadraticDeviation = -1;
     double ratioMedian = -1;
@@ -0,0 +1,55 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "include/data_code/author_table.h"
+#include "include/core/fic_genre_data.h"
+
+#include <QHash>
+#include <vector>
+#include <cstdint>
+
+namespace core{
+
+// mood strengths of every recommender as fixed width rows addressed by author ordinal
+// built once the mood distributions are loaded so that a mood adjusted list
+// compares itself to every author in a single pass over contiguous memory
+struct AuthorMoodMatrix
+{
+    // one lane per genre_stats::EGenreMood except gm_none, padded to a full avx register
+    static constexpr int moodLanes = 8;
+    struct alignas(32) Row{
+        float values[moodLanes] = {};
+    };
+    static Row RowFor(const genre_stats::ListMoodData& moodData);
+
+    void Build(const QHash<uint32_t, genre_stats::ListMoodData>& moods, const AuthorOrdinals& authorOrdinals);
+    void Clear();
+    bool IsEmpty() const {return rows.empty();}
+    uint32_t Size() const {return static_cast<uint32_t>(rows.size());}
+    bool HasMoods(uint32_t ordinal) const {return ordinal < hasMoods.size() && hasMoods[ordinal];}
+
+    // sums of absolute mood differences between the list and every author, written by author ordinal
+    // neutral covers every mood, touchy leaves out neutral and funny ones
+    // rows are compared with AVX when the cpu has it
+    void CalcDifferences(const Row& list, double* neutral, double* touchy) const;
+
+    std::vector<Row> rows;
+    std::vector<uint8_t> hasMoods;
+};
+
+}
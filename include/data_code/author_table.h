@@ -0,0 +1,108 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "include/reclist_author_result.h"
+#include "third_party/roaring/roaring.hh"
+
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
+namespace core{
+
+// dense numbering of every author that has favourites, built once the favourites are loaded
+// authors are addressed by their ordinal which is the position of the author id
+// in the list of all author ids sorted in ascending order
+struct AuthorOrdinals
+{
+    static constexpr uint32_t invalidOrdinal = std::numeric_limits<uint32_t>::max();
+
+    void Build(const QHash<int, Roaring>& faves);
+    void Clear();
+
+    uint32_t Size() const {return static_cast<uint32_t>(ids.size());}
+    uint32_t OrdinalFor(int authorId) const{
+        if(!ordinals.empty())
+            return authorId >= 0 && static_cast<size_t>(authorId) < ordinals.size() ? ordinals[static_cast<size_t>(authorId)] : invalidOrdinal;
+        auto it = std::lower_bound(ids.cbegin(), ids.cend(), authorId);
+        if(it == ids.cend() || *it != authorId)
+            return invalidOrdinal;
+        return static_cast<uint32_t>(it - ids.cbegin());
+    }
+
+    std::vector<int> ids;
+    // points into the favourites hash the ordinals were built from
+    std::vector<const Roaring*> favourites;
+    // id -> ordinal, only built when ids are dense enough for it to be small
+    std::vector<uint32_t> ordinals;
+};
+
+// per-request AuthorResult storage of the recommendation calculators
+// entries are kept in a flat array by author ordinal and are reset one by one
+// so that a reused table only pays for the authors the previous request touched
+struct AuthorResultTable
+{
+    void Init(const AuthorOrdinals* authorOrdinals);
+    void Reset();
+
+    // creates a default entry for the author if there wasn't one, like std::unordered_map does
+    AuthorResult& operator[](int authorId);
+    bool Contains(int authorId) const;
+    // authors in the order they were first touched
+    template <typename Func>
+    void ForEach(Func func){
+        for(size_t i = 0; i < touched.size(); i++)
+            func(authors[touched[i]]);
+        for(auto& author : authorsOutsideOrdinals)
+            func(author.second);
+    }
+
+    const AuthorOrdinals* ordinals = nullptr;
+    std::vector<AuthorResult> authors;
+    std::vector<uint8_t> used;
+    std::vector<uint32_t> touched;
+    // authors without favourites, shouldn't normally happen
+    std::unordered_map<int, AuthorResult> authorsOutsideOrdinals;
+};
+
+// tables are handed out one per running calculation and go back to the pool once it's finished
+class AuthorResultTablePool
+{
+public:
+    ~AuthorResultTablePool();
+    void SetOrdinals(const AuthorOrdinals* authorOrdinals);
+    QSharedPointer<AuthorResultTable> Acquire();
+
+private:
+    void Release(AuthorResultTable* table, uint32_t tableGeneration);
+
+    QMutex lock;
+    const AuthorOrdinals* ordinals = nullptr;
+    // used until the favourites are loaded, every author goes to authorsOutsideOrdinals then
+    AuthorOrdinals noOrdinals;
+    std::vector<AuthorResultTable*> freeTables;
+    // tables created for a previous set of ordinals aren't returned to the pool
+    uint32_t generation = 0;
+};
+
+}
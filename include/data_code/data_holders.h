@@ -5,6 +5,7 @@
 #include "Interfaces/genres.h"
 #include "threaded_data/threaded_load.h"
 #include "threaded_data/threaded_save.h"
+#include "threaded_data/snapshot.h"
 #include "third_party/roaring/roaring.hh"
 
 
@@ -0,0 +1,70 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "include/calc_data_holder.h"
+#include "include/core/experimental/fic_relations.h"
+
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <vector>
+#include <limits>
+#include <cstdint>
+
+namespace core{
+
+struct FicCooccurrenceSettings{
+    // run files are written here and removed once their partition is merged
+    QString workFolder = "TempData/cooccurrence";
+    // pairs are split by a hash of their row fic so that every partition is merged on its own
+    uint32_t partitions = 64;
+    // pairs a single thread keeps in memory over all partitions before spilling them as sorted runs
+    uint32_t bufferedPairs = 1u << 23;
+    // pairs met in fewer lists are dropped
+    uint32_t minimumSupport = 2;
+    // neighbours kept per fic, the ones met in the most lists, 0 keeps all of them
+    uint32_t topNeighbours = 100;
+    int threads = 1;
+};
+
+// amount of favourite lists that have both fics, in compressed sparse row form
+// row i holds the neighbours of fics[i] at [rowOffsets[i], rowOffsets[i+1]) by descending count
+struct FicCooccurrenceMatrix{
+    static constexpr uint32_t invalidRow = std::numeric_limits<uint32_t>::max();
+    uint32_t RowFor(uint32_t ficId) const;
+    uint32_t Size() const {return static_cast<uint32_t>(fics.size());}
+    bool Save(const QString& fileName) const;
+    bool Load(const QString& fileName);
+
+    // ascending
+    std::vector<uint32_t> fics;
+    // amount of lists every fic of the rows is in
+    std::vector<uint32_t> listCounts;
+    std::vector<uint64_t> rowOffsets;
+    std::vector<uint32_t> neighbours;
+    std::vector<uint32_t> counts;
+};
+
+// pairs of every list are counted out of core: threads spill sorted runs per partition to disk
+// that are then merged partition by partition into the rows of the matrix
+FicCooccurrenceMatrix BuildFicCooccurrence(const QVector<ListWithIdentifier>& lists, const FicCooccurrenceSettings& settings);
+
+// row -> neighbour entries of the matrix in the form FicRelations is stored in the database
+QList<FicWeightResult> FicRelationsFromMatrix(const FicCooccurrenceMatrix& matrix, const QHash<uint32_t, FicWeightPtr>& fics);
+
+}
@@ -0,0 +1,104 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "include/core/fic_genre_data.h"
+#include "third_party/roaring/roaring.hh"
+
+#include <QHash>
+#include <QList>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
+namespace core{
+
+// sums of genre weights and mood counts over a list of fics
+struct FicGenreAccumulator
+{
+    void Clear(){
+        genreWeights.fill(0.f);
+        moodCounts.fill(0);
+        ficCount = 0;
+    }
+    // genre factors and mood strengths of the list, both are divided by the size of the list
+    void Finalize(int listSize, std::array<double, 22>& genreFactors, genre_stats::ListMoodData& moodData) const;
+
+    std::array<float, genre_stats::g_count> genreWeights{};
+    std::array<uint32_t, genre_stats::gm_count> moodCounts{};
+    // fics of the list that have genre data
+    uint32_t ficCount = 0;
+};
+
+// Original genres of every fic from the genre composites in the form mood statistics are accumulated in:
+// a short list of genre weights and the mood mask of the fic
+// built once the composites are loaded so that lists don't need to go through genre bits of their fics
+struct FicGenreVectors
+{
+    static constexpr uint32_t invalidRow = std::numeric_limits<uint32_t>::max();
+
+    struct GenreWeight{
+        uint8_t genre;
+        float weight;
+    };
+    struct Row{
+        uint32_t firstEntry = 0;
+        uint8_t entryCount = 0;
+        uint8_t moodMask = 0;
+    };
+
+    void Build(const QHash<int, QList<genre_stats::GenreBit>>& composites);
+    void Clear();
+    bool IsEmpty() const {return rows.empty();}
+
+    uint32_t RowFor(uint32_t ficId) const{
+        if(!rowOfFic.empty())
+            return ficId < rowOfFic.size() ? rowOfFic[ficId] : invalidRow;
+        auto it = std::lower_bound(ids.cbegin(), ids.cend(), ficId);
+        if(it == ids.cend() || *it != ficId)
+            return invalidRow;
+        return static_cast<uint32_t>(it - ids.cbegin());
+    }
+    void Accumulate(uint32_t row, FicGenreAccumulator& accumulator) const{
+        const auto& ficRow = rows[row];
+        for(uint32_t entry = ficRow.firstEntry; entry < ficRow.firstEntry + ficRow.entryCount; entry++)
+            accumulator.genreWeights[entries[entry].genre] += entries[entry].weight;
+        for(int mood = genre_stats::gm_neutral; mood < genre_stats::gm_count; mood++)
+            if(ficRow.moodMask & (1u << mood))
+                accumulator.moodCounts[mood]++;
+        accumulator.ficCount++;
+    }
+    void Accumulate(const Roaring& fics, FicGenreAccumulator& accumulator) const{
+        for(auto ficId : fics)
+        {
+            auto row = RowFor(ficId);
+            if(row != invalidRow)
+                Accumulate(row, accumulator);
+        }
+    }
+
+    // ascending fic ids, row i belongs to ids[i]
+    std::vector<uint32_t> ids;
+    std::vector<Row> rows;
+    std::vector<GenreWeight> entries;
+    // direct fic id -> row lookup, only built when fic ids are dense enough
+    std::vector<uint32_t> rowOfFic;
+};
+
+}
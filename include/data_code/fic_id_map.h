@@ -0,0 +1,54 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include <QHash>
+#include <vector>
+#include <cstdint>
+
+namespace core{
+
+// bidirectional ffn id <-> db id lookup over every fic in the database
+// both directions are kept as sorted parallel columns and searched with binary search
+struct FicIdMap
+{
+    // pairs need to come in ascending order of db id
+    void Add(int32_t dbId, int32_t ffnId);
+    // needs to be called once all pairs are added
+    void Finalize();
+    void Clear();
+
+    bool IsEmpty() const {return dbIds.empty();}
+    uint32_t Size() const {return static_cast<uint32_t>(dbIds.size());}
+    // -1 if the fic is unknown
+    int32_t DbIdFor(int32_t ffnId) const;
+    int32_t FfnIdFor(int32_t dbId) const;
+
+    // same contract as sql::ConvertFFNTaggedFicsToDB: unknown fics are removed from the hash
+    void ConvertFFNToDB(QHash<int, int>& hash) const;
+    // same contract as sql::ConvertDBFicsToFFN: unknown fics get -1
+    void ConvertDBToFFN(QHash<int, int>& hash) const;
+
+    // sorted by db id
+    std::vector<int32_t> dbIds;
+    std::vector<int32_t> ffnIdsByDbId;
+    // sorted by ffn id
+    std::vector<int32_t> ffnIds;
+    std::vector<int32_t> dbIdsByFfnId;
+};
+
+}
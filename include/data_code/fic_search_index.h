@@ -0,0 +1,87 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "include/core/fanfic.h"
+#include "third_party/roaring/roaring.hh"
+
+#include <QHash>
+#include <QDate>
+#include <array>
+#include <vector>
+#include <cstdint>
+
+namespace core{
+
+// bitmaps of fics split by value ranges of a single column
+// ranges that are only partially covered by a query are refined with the column values
+struct FicRangeIndex{
+    void Init(std::vector<int32_t>&& bounds);
+    void Add(uint32_t ficId, int32_t value);
+    void Optimize();
+    // fics with minValue <= value <= maxValue
+    Roaring Select(int32_t minValue, int32_t maxValue,
+                   const std::vector<uint32_t>& ids,
+                   const std::vector<int32_t>& column) const;
+
+    // bucket i holds values in [bounds[i], bounds[i+1])
+    std::vector<int32_t> bounds;
+    std::vector<Roaring> buckets;
+};
+
+// read only in-memory index over the whole fic corpus of the server
+// columns are addressed by ordinal, the position of the fic id in the ascending id list
+struct FicSearchIndex{
+    void Add(const FicSearchRecord& record);
+    // needs to be called once all records are added
+    void Finalize();
+
+    uint32_t Size() const {return static_cast<uint32_t>(ids.size());}
+    // ids are iterated in ascending order so ordinal lookups move forward from the previous position
+    uint32_t OrdinalFor(uint32_t ficId, uint32_t searchFrom = 0) const;
+
+    Roaring FandomFics(int fandom) const;
+
+    std::vector<uint32_t> ids;
+    std::vector<int32_t> wordCount;
+    std::vector<int32_t> favourites;
+    std::vector<int32_t> reviews;
+    // julian day numbers, 0 for unknown dates
+    std::vector<int32_t> published;
+    std::vector<int32_t> updated;
+
+    Roaring all;
+    Roaring complete;
+    Roaring ratedM;
+    Roaring noGenre;
+    Roaring crossovers;
+    Roaring slashKeywords;
+    Roaring slashPass1;
+    Roaring slashPass2;
+    // fics with a single fandom, keyed by fandom
+    QHash<int, Roaring> pureFandomFics;
+    // crossovers that have the fandom as either of their fandoms
+    QHash<int, Roaring> crossoverFandomFics;
+    std::array<Roaring, 22> genres;
+
+    FicRangeIndex wordCountRanges;
+    FicRangeIndex favouritesRanges;
+    FicRangeIndex publishedRanges;
+    FicRangeIndex updatedRanges;
+};
+
+}
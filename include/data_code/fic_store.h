@@ -0,0 +1,89 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "include/core/fanfic.h"
+
+#include <QHash>
+#include <QDate>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
+namespace core{
+
+// Fic data used by the recommendation server laid out as a set of fixed width columns
+// Fics are addressed by their ordinal which is the position of the fic
+// in the list of all fic ids sorted in ascending order
+struct FicStore
+{
+    enum EFicFlags : uint8_t{
+        ff_complete =       1 << 0,
+        ff_slash =          1 << 1,
+        ff_dead =           1 << 2,
+        ff_same_language =  1 << 3,
+        ff_adult =          1 << 4,
+    };
+    static constexpr uint32_t invalidOrdinal = std::numeric_limits<uint32_t>::max();
+
+    void Build(const QHash<int, FicWeightPtr>& fics);
+    void Clear();
+
+    uint32_t Size() const {return static_cast<uint32_t>(ids.size());}
+    uint32_t OrdinalFor(uint32_t ficId) const{
+        if(!ordinals.empty())
+            return ficId < ordinals.size() ? ordinals[ficId] : invalidOrdinal;
+        auto it = std::lower_bound(ids.cbegin(), ids.cend(), ficId);
+        if(it == ids.cend() || *it != ficId)
+            return invalidOrdinal;
+        return static_cast<uint32_t>(it - ids.cbegin());
+    }
+    bool Contains(uint32_t ficId) const {return OrdinalFor(ficId) != invalidOrdinal;}
+    bool HasFlag(uint32_t ordinal, EFicFlags flag) const {return (flags[ordinal] & flag) != 0;}
+    bool IsCrossover(uint32_t ordinal) const {return fandom1[ordinal] != -1 && fandom2[ordinal] != -1;}
+    QDate Published(uint32_t ordinal) const {return published[ordinal] != 0 ? QDate::fromJulianDay(published[ordinal]) : QDate();}
+    QDate Updated(uint32_t ordinal) const {return updated[ordinal] != 0 ? QDate::fromJulianDay(updated[ordinal]) : QDate();}
+
+    // recreates the record the store was built from, genre string is restored from the genre mask
+    FicWeightPtr Materialize(uint32_t ordinal) const;
+
+    static uint32_t GenreMaskFromString(const QString& genreString);
+    static QString GenreStringFromMask(uint32_t mask);
+    static int32_t DayNumber(const QDate& date){return date.isValid() ? static_cast<int32_t>(date.toJulianDay()) : 0;}
+
+    std::vector<uint32_t> ids;
+    std::vector<int32_t> fandom1;
+    std::vector<int32_t> fandom2;
+    // bit N is set if the fic has the genre with GenreIndex index N
+    std::vector<uint32_t> genres;
+    std::vector<int32_t> favCount;
+    std::vector<int32_t> wordCount;
+    std::vector<int32_t> reviewCount;
+    std::vector<int32_t> authorId;
+    std::vector<uint16_t> chapterCount;
+    std::vector<uint8_t> flags;
+    // julian day numbers, 0 for unknown dates
+    std::vector<int32_t> published;
+    std::vector<int32_t> updated;
+
+    // indexed by fic id, only built when ids are dense enough (the full server store)
+    // sparse stores like the ones built for a single list search ids instead
+    std::vector<uint32_t> ordinals;
+};
+
+}
@@ -1,5 +1,13 @@
 #pragma once
 #include "include/data_code/data_holders.h"
+#include "include/data_code/fic_store.h"
+#include "include/data_code/fic_genre_vectors.h"
+#include "include/data_code/author_mood_matrix.h"
+#include "include/data_code/author_table.h"
+#include "include/data_code/fic_id_map.h"
+#include "include/data_code/recommender_sketches.h"
+
+#include <atomic>
 namespace core{
     
     
@@ -9,6 +17,7 @@ struct DataHolder
     typedef DataHolderInfo<rdt_favourites>::type FavType;
     typedef DataHolderInfo<rdt_fics>::type FicType;
     typedef DataHolderInfo<rdt_author_genre_distribution>::type GenreType;
+    typedef QHash<uint32_t, Roaring> FicRecommendersType;
     DataHolder(QString settingsFile,
                QSharedPointer<interfaces::Authors> authorsInterface,
                QSharedPointer<interfaces::Fanfics> fanficsInterface)
@@ -39,8 +48,29 @@ struct DataHolder
         CreateTempDataDir(storageFolder);
         auto[data, interface] = get<T>();
         QString fileBase = QString::fromStdString(DataHolderInfo<T>::fileBase());
-        thread_boost::SaveData(storageFolder, fileBase, data);
+        thread_boost::SaveSnapshot(storageFolder, fileBase, data);
     }
+    // inverted favourites: fic -> every recommender that has it in favourites
+    // is rebuilt whenever rdt_favourites is loaded
+    void BuildFicRecommendersIndex();
+    // dense author numbering for the calculators, also rebuilt whenever rdt_favourites is loaded
+    void BuildAuthorOrdinals();
+    // sampled favourites for approximate candidate retrieval, rebuilt after the ordinals
+    void BuildRecommenderSketches();
+    // mood distributions by author ordinal, rebuilt whenever either the moods or the ordinals change
+    void BuildAuthorMoodMatrix();
+    // rdt_fics is only kept as a columnar store once it's loaded, the hash itself is released
+    void BuildFicStore();
+    // original genres of every fic in the form mood statistics use, rebuilt whenever rdt_fic_genres_composite is loaded
+    void BuildGenreVectors();
+    // ffn id <-> db id lookup for every fic, always read from the database
+    void LoadFicIdMap();
+    // source fics of a recommendation request, read from ficStore
+    // database ids of fics that exist in the database but aren't in the store are returned in missingDbIds
+    QHash<uint32_t, FicWeightPtr> FicsForFFNIds(const QSet<int>& ffnIds, QList<int>& missingDbIds) const;
+    // checksum of the favourites and the fic store, unlike dataVersion it's the same between runs over the same data
+    // files precomputed from the data keep it to detect that they were built from an older one
+    uint64_t FavouritesFingerprint() const;
     void CreateTempDataDir(QString storageFolder)
     {
         QDir dir(QDir::currentPath());
@@ -55,8 +85,18 @@ struct DataHolder
     FavType faves;
     GenreType genres;
     FicGenreCompositeType genreComposites;
+    FicGenreVectors genreVectors;
     AuthorMoodDistributions authorMoodDistributions;
+    AuthorMoodMatrix authorMoods;
     FicType fics;
+    FicStore ficStore;
+    FicIdMap ficIds;
+    FicRecommendersType recommendersForFics;
+    AuthorOrdinals authorOrdinals;
+    RecommenderSketches recommenderSketches;
+    AuthorResultTablePool authorTables;
+    // changes whenever any of the data above is reloaded, results computed over older data can't be reused
+    std::atomic<uint32_t> dataVersion{0};
 };
     
 }
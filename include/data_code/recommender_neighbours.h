@@ -0,0 +1,59 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "include/data_code/author_table.h"
+#include "include/data_code/recommender_sketches.h"
+
+#include <QList>
+#include <QString>
+#include <vector>
+#include <cstdint>
+
+namespace core{
+
+struct RecommenderNeighboursSettings{
+    // recommenders whose sampled share of their list is in the other list at least this much are compared exactly
+    double sketchContainment = 0.05;
+    // shorter lists don't say much about taste, they neither get neighbours nor are neighbours
+    uint32_t minimumListSize = 10;
+    uint32_t minimumMatches = 5;
+    uint32_t neighbours = 50;
+    int threads = 1;
+};
+
+// k nearest recommenders of every recommender by cosine similarity of their favourites
+// row i holds the neighbours of recommenders[i] at [rowOffsets[i], rowOffsets[i+1]), most similar first
+struct RecommenderNeighbourTable{
+    QList<int> NeighboursFor(int recommender) const;
+    uint32_t Size() const {return static_cast<uint32_t>(recommenders.size());}
+    bool Save(const QString& fileName) const;
+    bool Load(const QString& fileName);
+
+    // ascending
+    std::vector<int32_t> recommenders;
+    std::vector<uint64_t> rowOffsets;
+    std::vector<int32_t> neighbours;
+    std::vector<float> similarities;
+};
+
+// candidates of every recommender come from the sketches, only those are compared with and_cardinality
+RecommenderNeighbourTable BuildRecommenderNeighbours(const AuthorOrdinals& authorOrdinals,
+                                                     const RecommenderSketches& sketches,
+                                                     const RecommenderNeighboursSettings& settings);
+
+}
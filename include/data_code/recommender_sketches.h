@@ -0,0 +1,54 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "include/data_code/author_table.h"
+#include "third_party/roaring/roaring.hh"
+
+#include <QList>
+#include <vector>
+#include <cstdint>
+
+namespace core{
+
+// MinHash sample of every recommender list, built once the favourites are loaded
+// fics are spread over sketchSize bins by a hash and the fic with the lowest hash of every bin is sampled
+// the share of a recommender's sample that is in the user's list estimates the share of the whole list that is
+// sampled fics are bucketed like recommendersForFics, but every recommender is only in sketchSize buckets
+// no matter how long their list is
+struct RecommenderSketches
+{
+    static constexpr uint32_t binBits = 5;
+    static constexpr uint32_t sketchSize = 1u << binBits;
+
+    void Build(const AuthorOrdinals& authorOrdinals);
+    void Clear();
+    bool IsEmpty() const {return sampleSizes.empty();}
+
+    // ids of the recommenders, ascending, that have at least one sampled fic in the list
+    // and at least minimumContainment of their sample in it
+    QList<int> Candidates(const Roaring& fics, double minimumContainment, const AuthorOrdinals& authorOrdinals) const;
+
+    // by author ordinal, lists shorter than sketchSize are sampled whole
+    std::vector<uint8_t> sampleSizes;
+    // ascending sampled fics, recommender ordinals of fics[i] are at [offsets[i], offsets[i+1])
+    std::vector<uint32_t> fics;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> recommenders;
+};
+
+}
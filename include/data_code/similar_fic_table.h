@@ -0,0 +1,88 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include <QFile>
+#include <QString>
+#include <vector>
+#include <cstdint>
+
+namespace core{
+
+// a fic of a precomputed similar fic list with the values the live list would have sent for it
+struct SimilarFicEntry{
+    uint32_t ficId = 0;
+    // votes after the weighting, what the list sends as fic matches
+    uint32_t matches = 0;
+    uint32_t votes = 0;
+};
+
+struct SimilarFicRow{
+    enum ERowFlags : uint16_t{
+        rf_automatic = 1 << 0,
+    };
+    uint32_t ficId = 0;
+    uint32_t firstEntry = 0;
+    uint16_t entryCount = 0;
+    uint16_t flags = 0;
+    // params the automatic adjustment settled on when the row was calculated
+    uint16_t minimumMatch = 0;
+    uint16_t maxUnmatchedPerMatch = 0;
+};
+static_assert(sizeof(SimilarFicEntry) == 12, "similar fic entry must not be padded");
+static_assert(sizeof(SimilarFicRow) == 16, "similar fic row must not be padded");
+
+// top neighbours of every fic as they would be returned for its similar fic list
+// entries of a row are sorted the same way LimitResults picks them: by matches, then by fic id
+// so any prefix of the row is what a list with that result limit would have contained
+//
+// entries keep the fics that aren't in the fic store, the prefix is taken first and they are skipped after it like the live list does
+//
+// the file is a header followed by the rows sorted by fic id and then the entries
+// it is read straight from a memory mapping, nothing is copied on load
+// the header keeps the fingerprint of the data the table was built from, a table built from other data isn't opened
+class SimilarFicTable{
+public:
+    SimilarFicTable() = default;
+    SimilarFicTable(const SimilarFicTable&) = delete;
+    SimilarFicTable& operator=(const SimilarFicTable&) = delete;
+    ~SimilarFicTable();
+
+    bool Open(const QString& fileName, uint64_t expectedFingerprint);
+    void Close();
+    bool IsOpen() const {return rows != nullptr;}
+
+    uint32_t Size() const {return rowCount;}
+    uint32_t NeighboursPerFic() const {return neighboursPerFic;}
+    // nullptr when the fic isn't in the table
+    const SimilarFicRow* RowFor(uint32_t ficId) const;
+    const SimilarFicEntry* EntriesOf(const SimilarFicRow& row) const {return entries + row.firstEntry;}
+
+    // rows need to come in ascending order of fic id with their entries already sorted
+    static bool Save(const QString& fileName, uint32_t neighboursPerFic, uint64_t fingerprint,
+                     const std::vector<SimilarFicRow>& rows, const std::vector<SimilarFicEntry>& entries);
+
+private:
+    QFile file;
+    uchar* mapped = nullptr;
+    const SimilarFicRow* rows = nullptr;
+    const SimilarFicEntry* entries = nullptr;
+    uint32_t rowCount = 0;
+    uint32_t neighboursPerFic = 0;
+};
+
+}
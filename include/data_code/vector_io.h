@@ -0,0 +1,68 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include <QDataStream>
+#include <QDebug>
+#include <QIODevice>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace core{
+
+// vectors of plain values written as their element count followed by the raw bytes
+// QDataStream takes raw sizes as int, so a vector over INT_MAX bytes is refused instead of being cut short
+template <typename T>
+bool WriteVector(QDataStream& out, const std::vector<T>& data)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "only plain values can be written as raw data");
+    const auto bytes = static_cast<quint64>(data.size()) * sizeof(T);
+    if(bytes > static_cast<quint64>(std::numeric_limits<int>::max()))
+    {
+        qDebug() << "Vector is too large to be written: " << bytes << " bytes";
+        out.setStatus(QDataStream::WriteFailed);
+        return false;
+    }
+    out << static_cast<quint64>(data.size());
+    return out.writeRawData(reinterpret_cast<const char*>(data.data()), static_cast<int>(bytes)) == static_cast<int>(bytes);
+}
+
+// the element count comes from the file, it's checked against the bytes left in it before anything is allocated
+template <typename T>
+bool ReadVector(QDataStream& in, std::vector<T>& data)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "only plain values can be read as raw data");
+    quint64 size = 0;
+    in >> size;
+    if(in.status() != QDataStream::Ok || !in.device())
+        return false;
+    const auto remaining = static_cast<quint64>(std::max<qint64>(0, in.device()->bytesAvailable()));
+    if(size > remaining / sizeof(T) || size * sizeof(T) > static_cast<quint64>(std::numeric_limits<int>::max()))
+    {
+        qDebug() << "Vector size doesn't fit the data: " << size << " elements, bytes left: " << remaining;
+        in.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    data.resize(static_cast<size_t>(size));
+    const auto bytes = static_cast<int>(size * sizeof(T));
+    return in.readRawData(reinterpret_cast<char*>(data.data()), bytes) == bytes;
+}
+
+}
@@ -35,6 +35,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include "include/data_code/data_holders.h"
 #include "include/data_code/rec_calc_data.h"
 #include "include/rec_calc/rec_calculator_base.h"
+#include "include/rec_calc/author_relations_state.h"
 
 
 namespace core{
@@ -54,15 +55,26 @@ public:
     void LoadStoredFavouritesData();
     void SaveFavouritesData();
     FavouritesMatchResult GetMatchedFics(UserMatchesInput user1, int user2);
+    // the ignore list is built once for all of the users and users are matched in parallel
+    // once cancelled the users that weren't matched yet are left out of the result
+    QHash<int, FavouritesMatchResult> GetMatchedFics(UserMatchesInput user1, const QList<int>& users, CancellationToken cancellation = {});
+    UserMatchesContext PrepareUserMatches(UserMatchesInput user1);
+    FavouritesMatchResult GetMatchedFics(const UserMatchesContext& user1, int user2) const;
 
+    // relations counted for the same session token are updated instead of counted from scratch
+    // a cancelled calculation returns a result without success as soon as it notices
     RecommendationListResult GetMatchedFicsForFavList(QHash<uint32_t, FicWeightPtr> fetchedFics,
                                                       QSharedPointer<core::RecommendationList> params,
-                                                      genre_stats::GenreMoodData moodData = {});
+                                                      genre_stats::GenreMoodData moodData = {},
+                                                      QString sessionToken = {},
+                                                      CancellationToken cancellation = {});
 
     DiagnosticRecommendationListResult GetDiagnosticRecommendationList(QHash<uint32_t, FicWeightPtr> fetchedFics,
                                                       QSharedPointer<core::RecommendationList> params,
-                                                      genre_stats::GenreMoodData moodData);
+                                                      genre_stats::GenreMoodData moodData,
+                                                      CancellationToken cancellation = {});
     DataHolder holder;
+    AuthorRelationsSessions relationSessions;
 };
 
 
@@ -186,6 +186,7 @@ DiagnosticSQLResult<QList<int>> GetAllAuthorIds(sql::Database db);
 DiagnosticSQLResult<QSet<int>> GetAllMatchesWithRecsUID(QSharedPointer<core::RecommendationList> params, QString, sql::Database db);
 DiagnosticSQLResult<QSet<int>> ConvertFFNSourceFicsToDB(QString, sql::Database db);
 DiagnosticSQLResult<QHash<uint32_t, core::FicWeightPtr>> GetFicsForRecCreation(sql::Database db);
+DiagnosticSQLResult<QHash<uint32_t, core::FicWeightPtr>> GetFicsForRecCreationByIds(QList<int> ids, sql::Database db);
 DiagnosticSQLResult<bool> ConvertFFNTaggedFicsToDB(QHash<int, int> &, sql::Database db);
 DiagnosticSQLResult<bool> ConvertDBFicsToFFN(QHash<int, int> &, sql::Database db);
 
@@ -239,6 +240,8 @@ DiagnosticSQLResult<QSet<int>>  GetAllKnownFicIds(QString, sql::Database db);
 DiagnosticSQLResult<QSet<int>>  GetFicIDsWithUnsetAuthors(sql::Database db);
 
 DiagnosticSQLResult<QVector<core::FicWeightPtr>>  GetAllFicsWithEnoughFavesForWeights(int faves, sql::Database db);
+DiagnosticSQLResult<bool> ProcessFicsForSearchIndex(std::function<void(const core::FicSearchRecord&)> processor, sql::Database db);
+DiagnosticSQLResult<bool> ProcessFicIdPairs(std::function<void(int, int)> processor, sql::Database db);
 DiagnosticSQLResult<QHash<int, core::AuthorFavFandomStatsPtr>> GetAuthorListFandomStatistics(QList<int> authors, sql::Database db);
 
 DiagnosticSQLResult<QSet<int>>  GetSingularFicsInLargeButSlashyLists(sql::Database db);
@@ -0,0 +1,88 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "include/rec_calc/list_overlap.h"
+#include "third_party/roaring/roaring.hh"
+
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+#include <vector>
+#include <cstdint>
+
+namespace core{
+class RecommendationList;
+
+// overlap of a candidate recommender's list with the lists of the user
+// as counted, before FetchAuthorRelations discards authors with too few matches
+struct AuthorRelationCounts{
+    uint32_t authorId = 0;
+    ListOverlap overlap;
+};
+
+// everything the counts of FetchAuthorRelations depend on, together with the counts themselves
+// a request that only adds or removes a few fics recounts just the recommenders of those fics
+struct AuthorRelationsState{
+    // the request can reuse the counts if it ignores the same fandoms and dead fics for the same user
+    // and picks its candidates the same way
+    bool CanBeUpdatedFor(const RecommendationList& params, uint32_t currentDataVersion) const;
+
+    uint32_t dataVersion = 0;
+    int userFFNId = -1;
+    double sketchContainment = 0;
+    // recommenders picked by the sketches for the favourites the counts were made for
+    // only set when the candidates came from the sketches, an update has to stay within the candidates of the new favourites
+    bool usesSketches = false;
+    Roaring sketchCandidates;
+    QSet<int> ignoredFandoms;
+    QSet<int> ignoredDeadFics;
+    // ignored fandoms and dead fics before the source and negative fics are taken out of them
+    Roaring baseIgnores;
+    Roaring ignores;
+    Roaring favourites;
+    Roaring negatives;
+    // every candidate recommender sorted by id, authors without matches or negative matches aren't kept
+    std::vector<AuthorRelationCounts> authors;
+};
+
+// states of recent requests by user token
+// bounded by both the age and the amount of sessions as every state holds counts for all candidate recommenders
+class AuthorRelationsSessions{
+public:
+    void SetLimits(int maxSessions, int lifetimeSeconds);
+    // the state is handed out exclusively, a concurrent request of the same user computes from scratch
+    QSharedPointer<AuthorRelationsState> Take(const QString& token);
+    void Store(const QString& token, QSharedPointer<AuthorRelationsState> state);
+
+private:
+    void RemoveExpired(const QDateTime& now);
+
+    struct Session{
+        QSharedPointer<AuthorRelationsState> state;
+        QDateTime storedAt;
+    };
+    QMutex lock;
+    int maxSessions = 16;
+    int lifetimeSeconds = 1800;
+    QHash<QString, Session> sessions;
+};
+
+}
@@ -19,9 +19,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 
 #include <QList>
 #include <limits>
+#include <array>
+#include <vector>
 
 #include "include/data_code/data_holders.h"
 #include "include/data_code/rec_calc_data.h"
+#include "include/rec_calc/author_relations_state.h"
+#include "include/cancellation_token.h"
 
 
 
@@ -65,6 +69,12 @@ struct UserMatchesInput{
     Roaring userIgnoredFandoms;
 };
 
+// part of matching a list against other users that doesn't depend on the other user
+struct UserMatchesContext{
+    Roaring userFavourites;
+    Roaring ignores;
+};
+
 struct FicBaseScoreCalculator{
     int totalVotes = 0;
     bool over50votes = false;
@@ -78,15 +88,70 @@ struct FicBaseScoreCalculator{
 
 struct RecInputVectors{
     const DataHolder::FavType& faves;
-    const DataHolder::FicType& fics;
-    const core::AuthorMoodDistributions& moods;
+    const FicStore& ficStore;
+    const AuthorMoodMatrix& moods;
+    const DataHolder::FicRecommendersType& recommendersForFics;
+    const AuthorOrdinals& authorOrdinals;
+    AuthorResultTablePool& authorTables;
+    const RecommenderSketches& recommenderSketches;
 };
 
-struct AutoAdjustmentAndFilteringResult{
-    bool performedFiltering = false;
-    bool adjustmentStoppedAtFirstIteration = true;
-    QSet<int> authors;
-    std::vector<int> sizes = {0,0,0};
+// vote multiplier of an author by how far their touchy moods are from the user's
+// without useScaleDown authors are only ever boosted
+double GetCoeffForTouchyDiff(double diff, bool useScaleDown = true);
+
+// everything CollectVotes accumulates for a single fic
+struct FicVotes{
+    uint32_t ficId = 0;
+    int pureVotes = 0;
+    int votes = 0;
+    int negativeMatches = 0;
+    int negativeVotes = 0;
+    bool decent = false;
+    // indexed by AuthorWeightingResult::EAuthorType
+    std::array<int, 4> typeCounts = {};
+    std::array<double, 4> typeVotes = {};
+};
+
+// flat storage for CollectVotes, a fic gets its slot the first time it's voted for
+// covers the fics with firstId <= id <= lastId, ranges of different accumulators don't overlap
+// so that they can be filled from different threads
+// slots of the fics in the store are found by ordinal, the rest (fics missing from the store) through a hash
+struct FicVoteAccumulator{
+    static constexpr uint32_t noSlot = std::numeric_limits<uint32_t>::max();
+    void Init(const FicStore* ficStore, uint32_t firstOrdinal, uint32_t endOrdinal);
+    FicVotes& ForFic(uint32_t ficId){
+        const auto ordinal = store->OrdinalFor(ficId);
+        if(ordinal == FicStore::invalidOrdinal)
+            return ForFicOutsideStore(ficId);
+        uint32_t& slot = slotsByOrdinal[ordinal - firstOrdinal];
+        if(slot == noSlot)
+            slot = NewSlot(ficId);
+        return fics[slot];
+    }
+    FicVotes& ForFicOutsideStore(uint32_t ficId);
+    uint32_t NewSlot(uint32_t ficId);
+    // only resets the slots that were used
+    void Clear();
+
+    const FicStore* store = nullptr;
+    uint32_t firstOrdinal = 0;
+    uint32_t firstId = 0;
+    uint32_t lastId = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> slotsByOrdinal;
+    QHash<uint32_t, uint32_t> slotsOutsideStore;
+    std::vector<FicVotes> fics;
+};
+
+// what a single filtered author adds to every fic in their favourites
+struct AuthorVote{
+    const Roaring* fics = nullptr;
+    uint32_t negativeMatches = 0;
+    bool countsAsNegativeVote = false;
+    bool decent = false;
+    AuthorWeightingResult::EAuthorType type = AuthorWeightingResult::EAuthorType::common;
+    double vote = 0;
+    double breakdownVote = 0;
 };
 
 struct RatioInfo{
@@ -134,7 +199,7 @@ public:
     typedef QList<std::function<bool(AuthorResult&,QSharedPointer<RecommendationList>)>> FilterListType;
     typedef QList<std::function<void(RecCalculatorImplBase*,AuthorResult &)>> ActionListType;
 
-    RecCalculatorImplBase(const RecInputVectors& input):inputs(input){}
+    RecCalculatorImplBase(const RecInputVectors& input):inputs(input), authorTable(input.authorTables.Acquire()), allAuthors(*authorTable){}
 
     virtual ~RecCalculatorImplBase(){}
 
@@ -142,17 +207,45 @@ public:
     bool Calc();
     void RunMatchingAndWeighting(QSharedPointer<RecommendationList> params, const FilterListType &filters, const ActionListType &actions);
     Roaring BuildIgnoreList();
+    // ignored fandoms and dead fics, ExcludeFromIgnores then takes the source and negative fics out of them
+    Roaring BuildBaseIgnoreList();
+    Roaring ExcludeFromIgnores(Roaring fullIgnores) const;
+    QList<int> CollectCandidateRecommenders() const;
     void FetchAuthorRelations();
+    AuthorRelationCounts CountAuthorRelation(uint32_t authorId, const Roaring& ignores) const;
+    // counts every candidate recommender into a new relationsState
+    void CountAuthorRelations();
+    // recounts the recommenders of the fics that changed since relationsState was counted
+    // with sketches it also follows the candidates they pick for the new favourites, so the result matches a full count
+    // returns false when too many of them changed for it to be worth it, a cancelled update drops relationsState
+    bool UpdateAuthorRelations();
+    // fills allAuthors and the match statistics from relationsState
+    void SummarizeAuthorRelations();
     void CollectFicMatchQuality();
     void Filter(QSharedPointer<RecommendationList> params,
                 const QList<std::function<bool(AuthorResult&,QSharedPointer<RecommendationList>)>>& filters,
                 const QList<std::function<void(RecCalculatorImplBase*,AuthorResult &)>>& actions);
+    // calls Filter with the lists by default, PolicyCalculator applies its compile time filters instead
+    virtual void FilterAuthors(QSharedPointer<RecommendationList> params, const FilterListType &filters, const ActionListType &actions);
+    // prepares every author for filtering, passes is called as passes(author) and act as act(author)
+    template <typename Passes, typename Act>
+    void FilterWith(Passes passes, Act act);
 
     void CalculateNegativeToPositiveRatio();
     void ReportNegativeResults();
     void FillFilteredAuthorsForFics();
 
     virtual bool CollectVotes();
+    // fills the vote of every filtered author, the weighting comes from GetWeightingFunc by default
+    // PolicyCalculator weighs with its compile time policy instead
+    virtual void WeighAuthorVotes(std::vector<AuthorVote>& authorVotes, int maxValue, uint32_t negativeMatchCutoff);
+    // weighting is called as weighting(author, authorCount, maxValue) and returns AuthorWeightingResult
+    template <typename Weighting>
+    void WeighAuthors(std::vector<AuthorVote>& authorVotes, int maxValue, uint32_t negativeMatchCutoff, Weighting weighting);
+    void FillAuthorVote(AuthorVote& authorVote, int author, const AuthorResult& authorData,
+                        AuthorWeightingResult weighting, uint32_t negativeMatchCutoff);
+    void PrepareVoteRanges();
+    void WriteVotesIntoResult();
     virtual bool WeightingIsValid() const = 0;
 
     virtual void CalcWeightingParams() = 0;
@@ -163,9 +256,7 @@ public:
     virtual std::optional<double> GetNeutralDiffForLists(uint32_t){return {};}
     virtual std::optional<double> GetTouchyDiffForLists(uint32_t){return {};}
 
-    virtual AutoAdjustmentAndFilteringResult AutoAdjustRecommendationParamsAndFilter(QSharedPointer<RecommendationList>);
     virtual void AdjustRatioForAutomaticParams();
-    virtual bool AdjustParamsToHaveExceptionalLists(QSharedPointer<RecommendationList>, const AutoAdjustmentAndFilteringResult &adjustmentResult);
 
     int ownProfileId = -1;
     uint16_t ratioCutoff = std::numeric_limits<uint16_t>::max();
@@ -176,7 +267,9 @@ public:
     QSharedPointer<RecommendationList> params;
     //QList<int> matchedAuthors;
     QHash<uint32_t, core::FicWeightPtr> fetchedFics;
-    std::unordered_map<int, AuthorResult> allAuthors;
+    // taken from the pool for the lifetime of the calculator
+    QSharedPointer<AuthorResultTable> authorTable;
+    AuthorResultTable& allAuthors;
     uint32_t maximumMatches = 0;
     uint32_t prevMaximumMatches = 0;
     double averageNegativeToPositiveMatches = 0;
@@ -185,33 +278,129 @@ public:
     QSet<int> filteredAuthors;
     Roaring ownFavourites;
     Roaring ownMajorNegatives;
+    // counts of a previous request of the same user if the caller has them
+    // holds the counts of this request once FetchAuthorRelations is done
+    QSharedPointer<AuthorRelationsState> relationsState;
     RecommendationListResult result;
     QHash<uint32_t, QVector<uint32_t>> authorsForFics;
     QHash<uint16_t, RatioInfo> ratioInfo;
+    // consecutive fic id ranges, more than one only when votes are collected in parallel
+    std::vector<FicVoteAccumulator> ficVotes;
+    // below this amount of filtered authors votes are collected on the calling thread
+    int parallelVotingThreshold = 1000;
     bool needsDiagnosticData = false;
+    // vote multipliers of common authors by author ordinal, filled by calculators that adjust votes by mood
+    // when empty CollectVotes goes through GetTouchyDiffForLists instead
+    std::vector<double> moodWeights;
+    // checked between the phases of Calc and inside the long ones, Calc returns false once it's cancelled
+    CancellationToken cancellation;
 
     int votesBase = 1;
 };
+template <typename Passes, typename Act>
+void RecCalculatorImplBase::FilterWith(Passes passes, Act act)
+{
+    allAuthors.ForEach([&](AuthorResult& author){
+        auto setInvalid = [](auto& author){
+            author.ratio = 99999;
+            author.similarityPercentage = 0;
+        };
+        if(author.matches == 0 || author.sizeAfterIgnore < 10 || author.matches < minimumRatio){
+            setInvalid(author);
+            return;
+        }
+        author.similarityPercentage = author.matches/(static_cast<double>(author.sizeAfterIgnore)/100.);
+        author.ratio = static_cast<double>(author.sizeAfterIgnore)/static_cast<double>(author.matches);
+        author.negativeRatio = author.negativeMatches != 0  ? static_cast<double>(author.negativeMatches)/static_cast<double>(author.fullListSize) : std::numeric_limits<double>::max();
+        author.listDiff.touchyDifference = GetTouchyDiffForLists(author.id);
+        author.listDiff.neutralDifference = GetNeutralDiffForLists(author.id);
+        if(!passes(author) || author.ratio == 1){
+            setInvalid(author);
+            return;
+        }
+        act(author);
+    });
+}
+
+template <typename Weighting>
+void RecCalculatorImplBase::WeighAuthors(std::vector<AuthorVote>& authorVotes, int maxValue, uint32_t negativeMatchCutoff, Weighting weighting)
+{
+    const int authorCount = filteredAuthors.size();
+    auto authorVote = authorVotes.begin();
+    for(auto author: std::as_const(filteredAuthors))
+    {
+        auto& authorData = allAuthors[author];
+        FillAuthorVote(*authorVote, author, authorData, weighting(authorData, authorCount, maxValue), negativeMatchCutoff);
+        ++authorVote;
+    }
+}
+
+struct MatchesFilter{
+    static bool Pass(const AuthorResult& author, const RecommendationList& params){
+        return static_cast<int>(author.matches) >= params.minimumMatch || static_cast<int>(author.matches) >= params.alwaysPickAt;
+    }
+};
+struct RatioFilter{
+    static bool Pass(const AuthorResult& author, const RecommendationList& params){
+        return author.ratio <= params.maxUnmatchedPerMatch && author.matches > 0;
+    }
+};
+struct NegativeFilter{
+    static bool Pass(const AuthorResult& author, const RecommendationList& list){
+        if(!list.useDislikes)
+            return true;
+        bool filterResult = (static_cast<double>(author.negativeMatches)/author.matches >= 2 || static_cast<double>(author.sizeAfterIgnore)/author.negativeMatches < 15)
+                && static_cast<double>(author.negativeMatches)/author.matches >= 1.5 ;
+        return !filterResult;
+    }
+};
+struct AccumulateAuthor{
+    static void Apply(RecCalculatorImplBase* ptr, AuthorResult & author){
+        ptr->filteredAuthors.insert(author.id);
+    }
+};
+
+// filters and actions of a calculator known at compile time
+// see PolicyCalculator in rec_calculator_policies.h
+template <typename... Filters>
+struct AuthorFilters{
+    static bool Pass(const AuthorResult& author, const RecommendationList& params){
+        return (Filters::Pass(author, params) && ...);
+    }
+};
+template <typename... Actions>
+struct AuthorActions{
+    template <typename Calculator>
+    static void Apply(Calculator* calculator, AuthorResult& author){
+        (Actions::Apply(calculator, author), ...);
+    }
+};
+
+// std::function versions of the above for GetFilterList/GetActionList
 static auto matchesFilter = [](AuthorResult& author, QSharedPointer<RecommendationList> params){
-    return static_cast<int>(author.matches) >= params->minimumMatch || static_cast<int>(author.matches) >= params->alwaysPickAt;
+    return MatchesFilter::Pass(author, *params);
 };
 static auto ratioFilter = [](AuthorResult& author, QSharedPointer<RecommendationList> params)
 {
-    return author.ratio <= params->maxUnmatchedPerMatch && author.matches > 0;
+    return RatioFilter::Pass(author, *params);
 };
 
 static auto negativeFilter = [](AuthorResult& author, QSharedPointer<RecommendationList> list )
 {
-    if(!list->useDislikes)
-        return true;
-    bool filterResult = (static_cast<double>(author.negativeMatches)/author.matches >= 2 || static_cast<double>(author.sizeAfterIgnore)/author.negativeMatches < 15)
-            && static_cast<double>(author.negativeMatches)/author.matches >= 1.5 ;
-    return !filterResult;
+    return NegativeFilter::Pass(author, *list);
 };
 
 static auto authorAccumulator = [](RecCalculatorImplBase* ptr,AuthorResult & author)
 {
-    ptr->filteredAuthors.insert(author.id);
+    AccumulateAuthor::Apply(ptr, author);
+};
+
+// weighting of a calculator known at compile time, see PolicyCalculator
+struct NoWeighting{
+    template <typename Calculator>
+    static AuthorWeightingResult Weigh(Calculator*, AuthorResult&, int, int){
+        return AuthorWeightingResult();
+    }
 };
 
 
@@ -20,9 +20,34 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include "data_code/data_holders.h"
 #include "data_code/rec_calc_data.h"
 #include <array>
+#include <vector>
+#include <limits>
 
 namespace core {
 
+// ratio filter that also drops authors whose full list is too large unless their moods are close
+struct MoodAdjustedRatioFilter{
+    static bool Pass(const AuthorResult& author, const RecommendationList& params){
+        if(author.ratio > params.ratioCutoff)
+            return false;
+
+        bool firstPass =  author.ratio <= params.maxUnmatchedPerMatch && author.matches > 0;
+        if(!firstPass)
+            return false;
+
+        auto cleanRatio = author.matches != 0 ? static_cast<double>(author.fullListSize)/static_cast<double>(author.matches) : std::numeric_limits<double>::max();
+        if(author.listDiff.touchyDifference.has_value())
+        {
+            auto authorcoef = author.listDiff.touchyDifference.value();
+            if((cleanRatio > params.maxUnmatchedPerMatch) && authorcoef  >= 0.4)
+                return false;
+        }
+
+        bool secondPass = author.ratio <= params.maxUnmatchedPerMatch && author.matches > 0;
+        return secondPass;
+    }
+};
+
 class RecCalculatorImplMoodAdjusted: public RecCalculatorImplWeighted{
 public:
     RecCalculatorImplMoodAdjusted(const RecInputVectors& input, const genre_stats::GenreMoodData& moodData);
@@ -30,7 +55,9 @@ public:
     std::optional<double> GetTouchyDiffForLists(uint32_t) override;
     virtual FilterListType GetFilterList();
 
-    QHash<uint32_t, ListMoodDifference> moodDiffs;
+    // by author ordinal, only meaningful for authors that have moods in inputs.moods
+    std::vector<double> neutralDiffs;
+    std::vector<double> touchyDiffs;
     genre_stats::GenreMoodData moodData;
 
 
@@ -0,0 +1,63 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "rec_calc/rec_calculator_base.h"
+#include "rec_calc/rec_calculator_weighted.h"
+#include "rec_calc/rec_calculator_mood_adjusted.h"
+
+namespace core {
+
+// Calculator with its filters, actions and weighting fixed at compile time.
+// Filtering and vote collection run them directly on every author instead of going through
+// the std::function lists of GetFilterList/GetActionList and GetWeightingFunc, those are still there
+// for code that wants to use them.
+template <typename Calculator, typename Filters, typename Actions, typename Weighting>
+class PolicyCalculator : public Calculator{
+public:
+    using Calculator::Calculator;
+    void FilterAuthors(QSharedPointer<RecommendationList> params,
+                       const RecCalculatorImplBase::FilterListType&,
+                       const RecCalculatorImplBase::ActionListType&) override{
+        const RecommendationList& list = *params;
+        this->FilterWith([&list](AuthorResult& author){
+            return Filters::Pass(author, list);
+        }, [this](AuthorResult& author){
+            Actions::Apply(static_cast<Calculator*>(this), author);
+        });
+    }
+    void WeighAuthorVotes(std::vector<AuthorVote>& authorVotes, int maxValue, uint32_t negativeMatchCutoff) override{
+        this->WeighAuthors(authorVotes, maxValue, negativeMatchCutoff, [this](AuthorResult& author, int authorCount, int maximumMatches){
+            return Weighting::Weigh(static_cast<Calculator*>(this), author, authorCount, maximumMatches);
+        });
+    }
+};
+
+using RecCalculatorDefault = PolicyCalculator<RecCalculatorImplDefault,
+                                              AuthorFilters<MatchesFilter, RatioFilter, NegativeFilter>,
+                                              AuthorActions<AccumulateAuthor>,
+                                              NoWeighting>;
+using RecCalculatorWeighted = PolicyCalculator<RecCalculatorImplWeighted,
+                                               AuthorFilters<MatchesFilter, RatioFilter, NegativeFilter>,
+                                               AuthorActions<AccumulateAuthor, AccumulateRatio>,
+                                               RatioWeighting>;
+using RecCalculatorMoodAdjusted = PolicyCalculator<RecCalculatorImplMoodAdjusted,
+                                                   AuthorFilters<MatchesFilter, MoodAdjustedRatioFilter, NegativeFilter>,
+                                                   AuthorActions<AccumulateAuthor, AccumulateRatio>,
+                                                   RatioWeighting>;
+
+}
@@ -39,6 +39,11 @@ double sqrt_coef(double ratio, double median, double sigma, int base, int scaler
 
 
 
+class RecCalculatorImplWeighted;
+struct AccumulateRatio{
+    static void Apply(RecCalculatorImplWeighted* calc, AuthorResult & author);
+};
+
 class RecCalculatorImplWeighted : public RecCalculatorImplBase{
 public:
     RecCalculatorImplWeighted(const RecInputVectors& input): RecCalculatorImplBase(input){}
@@ -71,6 +76,17 @@ public:
     bool WeightingIsValid() const override;
 };
 
+struct RatioWeighting{
+    static AuthorWeightingResult Weigh(RecCalculatorImplWeighted* calc, AuthorResult& author, int authorSize, int maximumMatches){
+        return calc->CalcWeightingForAuthor(author, authorSize, maximumMatches);
+    }
+};
+
+inline void AccumulateRatio::Apply(RecCalculatorImplWeighted* calc, AuthorResult & author){
+    if(calc->ownProfileId != static_cast<int>(author.id))
+        calc->ratioSum+=author.ratio;
+}
+
 
 
 }
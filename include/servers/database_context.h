@@ -27,6 +27,10 @@ class Fandoms;
 class Authors;
 }
 
+// every worker thread keeps its connection, with the custom functions and prepared statements on it,
+// between requests instead of reopening the database for each of them
+QSharedPointer<database::IDBWrapper> ThreadConnection();
+
 class DatabaseContext{
 public:
     DatabaseContext();
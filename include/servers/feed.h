@@ -47,6 +47,8 @@ using grpc::ServerReader;
 using grpc::ServerWriter;
 using grpc::Status;
 class FicSource;
+class RecListCache;
+namespace core{struct FicSearchIndex; class SimilarFicTable; struct RecommenderNeighbourTable;}
 
 
 struct UsedInSearch{
@@ -143,6 +145,19 @@ public:
     QReadWriteLock lock;
     QSharedPointer<QTimer> logTimer;
     QSharedPointer<core::RNGData> rngData;
+    // null when bitmap search is disabled in settings
+    QSharedPointer<const core::FicSearchIndex> searchIndex;
+    // null when Settings/recListCacheMegabytes is 0
+    QSharedPointer<RecListCache> recListCache;
+    // null when SimilarFics/fileName is empty or the file couldn't be opened
+    QSharedPointer<const core::SimilarFicTable> similarFicTable;
+    std::atomic<int> similarFicTableHits{0};
+    std::atomic<int> similarFicTableMisses{0};
+    // null when RecommenderNeighbours/fileName is empty or the file couldn't be loaded
+    QSharedPointer<const core::RecommenderNeighbourTable> recommenderNeighbours;
+    // approximate candidate recommenders for lists of at least sketchFromListSize fics, 0 disables it
+    double sketchContainment = 0;
+    int sketchFromListSize = 2000;
 private:
     void AddToStatistics(QString uuid, const core::StoryFilter& filter);
     void AddToStatistics(QString uuid);
@@ -0,0 +1,69 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "servers/feed.h"
+
+#include <QString>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class QSettings;
+
+// a class of calls with its own completion queue and worker pool
+// so that a burst in one class can't occupy the threads of another
+struct AsyncCallLane{
+    AsyncCallLane(QString name, int threads, int maxPending);
+    QString name;
+    std::unique_ptr<grpc::ServerCompletionQueue> queue;
+    QThreadPool workers;
+    // calls above this amount of queued + running are rejected with RESOURCE_EXHAUSTED
+    int maxPending = 0;
+    std::atomic<int> pending{0};
+    std::atomic<bool> accepting{true};
+};
+
+// Serves FeederService through the async grpc api.
+// Handlers are the same ones the sync server uses, they are just executed on the worker pool of their lane:
+// fast   - GetStatus, SearchByFFNID, GetFicCount
+// heavy  - RecommendationListCreation, DiagnosticRecommendationListCreation, GetUserMatches
+// common - everything else
+class FeederAsyncServer{
+public:
+    FeederAsyncServer(FeederService* service, QSettings& settings);
+    // blocks until the server is shut down and all accepted calls have been answered
+    void Run(const std::string& address);
+    // safe to call from any thread, also before Run has started the server
+    void Shutdown();
+
+private:
+    void RegisterCalls();
+    void PollLane(AsyncCallLane* lane);
+
+    FeederService* service = nullptr;
+    ProtoSpace::Feeder::AsyncService asyncService;
+    AsyncCallLane fastLane;
+    AsyncCallLane commonLane;
+    AsyncCallLane heavyLane;
+    // declared after the lanes so that it's destroyed before their completion queues
+    std::unique_ptr<grpc::Server> server;
+    std::mutex serverLock;
+    bool shutdownRequested = false;
+};
@@ -0,0 +1,72 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QWaitCondition>
+#include <cstdint>
+#include <functional>
+#include <list>
+
+// serialized RecommendationListCreation responses keyed by a hash of everything that influences them
+// identical requests arriving while the first one is still computed wait for its result
+// instead of running the calculator again
+// least recently used entries are evicted once the responses take more than maxBytes
+class RecListCache{
+public:
+    struct Statistics{
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        // requests that waited for an identical one in flight
+        uint64_t coalesced = 0;
+        uint64_t evictions = 0;
+        uint64_t entries = 0;
+        uint64_t bytes = 0;
+    };
+
+    explicit RecListCache(uint64_t maxBytes);
+    // compute is only called when there is neither a cached nor an in-flight result for the key
+    // an empty result of compute isn't cached, requests that waited for it compute their own
+    // computedHere tells if the returned value was produced by this call
+    QByteArray GetOrCompute(const QByteArray& key, const std::function<QByteArray()>& compute, bool* computedHere);
+    Statistics GetStatistics() const;
+
+private:
+    struct InFlight{
+        bool done = false;
+        QByteArray result;
+        QWaitCondition finished;
+    };
+    struct Entry{
+        QByteArray value;
+        std::list<QByteArray>::iterator recencyPosition;
+    };
+    void Finish(const QByteArray& key, QSharedPointer<InFlight> flight, const QByteArray& result);
+    void Insert(const QByteArray& key, const QByteArray& value);
+    static uint64_t EntrySize(const QByteArray& key, const QByteArray& value);
+
+    mutable QMutex lock;
+    uint64_t maxBytes = 0;
+    // most recently used keys first
+    std::list<QByteArray> recency;
+    QHash<QByteArray, Entry> entries;
+    QHash<QByteArray, QSharedPointer<InFlight>> inFlight;
+    Statistics statistics;
+};
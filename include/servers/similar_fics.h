@@ -0,0 +1,47 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include "proto/feeder_service.pb.h"
+#include "include/data_code/similar_fic_table.h"
+
+#include <QString>
+#include <cstdint>
+
+namespace core{
+struct FicStore;
+class RecCalculator;
+class RecommendationList;
+}
+
+struct SimilarFicsSettings{
+    QString fileName = "ServerData/similar_fics.bin";
+    // neighbours stored per fic, similar fic lists asking for more are calculated live
+    uint32_t neighbours = 100;
+    // fics with fewer favourites aren't precomputed and are calculated live
+    int minimumFavourites = 100;
+};
+
+// runs the similar fic list of every fic with enough favourites through the calculator
+// the same way RecommendationListCreation would and stores the top neighbours of each
+bool BuildSimilarFicTable(core::RecCalculator& calculator, const SimilarFicsSettings& settings);
+
+// fills the response the same way a live similar fic list would have been sent
+// false if the table can't answer the request and it needs to be calculated
+bool FillSimilarFicListFromTable(const core::SimilarFicTable& table, const core::FicStore& ficStore, uint32_t sourceFic,
+                                 const core::RecommendationList& params,
+                                 ProtoSpace::RecommendationListCreationResponse* response);
@@ -0,0 +1,36 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include <QList>
+
+namespace core{
+class RecCalculator;
+}
+
+struct SketchEvaluationSettings{
+    // recommenders with at least this many favourites are used as source lists
+    int minimumListSize = 2000;
+    int lists = 20;
+    // top fics of both paths that are compared
+    int resultLimit = 100;
+    QList<double> containments = {0.01, 0.02, 0.05, 0.1};
+};
+
+// runs favourite lists of big recommenders through both the exact and the sketched candidate retrieval
+// and logs, for every containment, how many of the exact top fics the approximate list found and how long both took
+void EvaluateRecommenderSketches(core::RecCalculator& calculator, const SketchEvaluationSettings& settings);
@@ -30,6 +30,12 @@ sql::Database InitNamedSqliteDatabase(QString dbName, QString filename, bool set
 
 sql::Database InitAndUpdateSqliteDatabaseForFile(QString folder, QString file, QString sqlFile, QString connectionName, bool setDefault);
 
+// prepared statements are kept per connection and keyed by their sql text
+// only connections registered with EnableStatementCache use the cache, they need to stay open for the lifetime of their thread
+// a cached statement is only handed out when bindings cover all of its placeholders, otherwise a fresh one is prepared
+void EnableStatementCache(sql::Database db);
+sql::Query PrepareCached(const std::string& text, const QList<sql::QueryBinding>& bindings, sql::Database db);
+
 int CreateNewTask(sql::Database db);
 int CreateNewSubTask(int taskId, int subTaskId, sql::Database db);
 }
@@ -0,0 +1,97 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+// [begin, end) of the items of a parallel loop
+typedef std::pair<size_t, size_t> TaskRange;
+
+// Persistent pool of worker threads with a task queue per worker.
+// Workers take tasks from the back of their own queue and steal from the front of the others
+// so that threads that are done early pick up what's left of the slow ones.
+// The thread that starts a loop runs tasks too while it waits, which keeps loops started
+// from inside a task from deadlocking on the pool they run in.
+class TaskScheduler
+{
+public:
+    explicit TaskScheduler(int threads);
+    ~TaskScheduler();
+    // process wide pool with a worker per core but one, created on first use
+    static TaskScheduler& Instance();
+
+    int ThreadCount() const {return static_cast<int>(workers.size());}
+
+    // runs every task and returns once all of them are finished
+    void Run(std::vector<std::function<void()>>&& tasks);
+
+    // splits [0, count) into chunks of about the same total cost, a few per thread
+    std::vector<TaskRange> SplitByCost(size_t count, const std::function<uint64_t(size_t)>& cost) const;
+    // the same for items that all cost about the same
+    std::vector<TaskRange> SplitEvenly(size_t count, size_t minimumChunk = 1) const;
+
+    // body(begin, end) is called for every range
+    void ParallelFor(const std::vector<TaskRange>& ranges, const std::function<void(size_t, size_t)>& body);
+    // body(begin, end) is called for every range, partial results are combined on the calling thread in range order
+    template <typename T, typename Body, typename Combine>
+    T ParallelReduce(const std::vector<TaskRange>& ranges, T identity, Body body, Combine combine)
+    {
+        std::vector<T> partials(ranges.size(), identity);
+        std::vector<std::function<void()>> tasks;
+        tasks.reserve(ranges.size());
+        for(size_t i = 0; i < ranges.size(); i++)
+            tasks.push_back([&, i](){partials[i] = body(ranges[i].first, ranges[i].second);});
+        Run(std::move(tasks));
+        T result = std::move(identity);
+        for(auto& partial : partials)
+            combine(result, std::move(partial));
+        return result;
+    }
+
+private:
+    struct TaskGroup;
+    struct Task{
+        std::function<void()> function;
+        TaskGroup* group = nullptr;
+    };
+    struct WorkerQueue{
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerLoop(size_t index);
+    // takes a task from the back of the queue at index or steals one from the front of any other
+    bool TryTake(size_t index, Task& task);
+    void Execute(Task& task);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepLock;
+    std::condition_variable wakeUp;
+    std::atomic<size_t> queuedTasks{0};
+    std::atomic<size_t> nextQueue{0};
+    bool stopping = false;
+};
@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>*/
 #include "include/pageconsumer.h"
 #include "include/environment.h"
 #include "include/core/section.h"
+#include "include/data_code/fic_genre_vectors.h"
 #include "third_party/roaring/roaring.hh"
 
 class AuthorGenreIterationProcessor{
@@ -29,6 +30,14 @@ public:
 
     void ReprocessGenreStats(QHash<int, QList<genre_stats::GenreBit>> inputFicData,
                              QHash<int, Roaring> inputAuthorData);
+    // batched path over precomputed genre vectors, authors are split into chunks of similar total list size
+    void ReprocessGenreStats(const core::FicGenreVectors& ficVectors,
+                             const QHash<int, Roaring>& inputAuthorData);
+    // single list, computed on the calling thread
+    static void CalcListGenreStats(const core::FicGenreVectors& ficVectors,
+                                   const Roaring& fics,
+                                   std::array<double, 22>& genreData,
+                                   genre_stats::ListMoodData& moodData);
 
 
     QHash<uint32_t, genre_stats::ListMoodData> CreateMoodDataFromGenres(QHash<int, std::array<double, 22>>&);
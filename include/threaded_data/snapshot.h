@@ -0,0 +1,72 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#pragma once
+#include <QHash>
+#include <QString>
+#include <array>
+#include <cstdint>
+
+#include "include/core/section.h"
+#include "third_party/roaring/roaring.hh"
+
+// Single file snapshots of server data
+// Unlike the thread_boost::SaveData files the layout doesn't depend on the amount of cores:
+// entries are always split into a fixed amount of shards by key
+// and every shard carries its own checksum so it can be verified while it's being read.
+// The file is mapped into memory while it's loaded, shards are verified and deserialized from the mapping
+// into the destination hash (roaring bitmaps from their portable serialized form) and the file is unmapped after that.
+// A shard can't be larger than INT_MAX bytes.
+namespace thread_boost{
+namespace snapshot{
+static constexpr uint32_t currentVersion = 1;
+static constexpr uint32_t shardCount = 32;
+
+struct Header{
+    char magic[8];
+    uint32_t version = 0;
+    uint32_t shardCount = 0;
+    uint64_t entryCount = 0;
+};
+
+struct ShardInfo{
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint64_t entryCount = 0;
+    uint64_t checksum = 0;
+};
+static_assert(sizeof(Header) == 24, "snapshot header must not be padded");
+static_assert(sizeof(ShardInfo) == 32, "snapshot shard info must not be padded");
+
+QString SnapshotFileName(QString storageFolder, QString fileBase);
+bool SnapshotExists(QString storageFolder, QString fileBase);
+uint64_t Checksum(const uchar* data, uint64_t size);
+}
+
+bool SaveSnapshot(QString storageFolder, QString fileBase, const QHash<int, Roaring>& data);
+bool SaveSnapshot(QString storageFolder, QString fileBase, const QHash<int, core::FicWeightPtr>& data);
+bool SaveSnapshot(QString storageFolder, QString fileBase, const QHash<int, std::array<double, 22>>& data);
+bool SaveSnapshot(QString storageFolder, QString fileBase, const QHash<int, QList<genre_stats::GenreBit>>& data);
+bool SaveSnapshot(QString storageFolder, QString fileBase, const QHash<uint32_t, genre_stats::ListMoodData>& data);
+
+// return false and leave the destination empty if the snapshot is missing, outdated or damaged
+bool LoadSnapshot(QString storageFolder, QString fileBase, QHash<int, Roaring>& data);
+bool LoadSnapshot(QString storageFolder, QString fileBase, QHash<int, core::FicWeightPtr>& data);
+bool LoadSnapshot(QString storageFolder, QString fileBase, QHash<int, std::array<double, 22>>& data);
+bool LoadSnapshot(QString storageFolder, QString fileBase, QHash<int, QList<genre_stats::GenreBit>>& data);
+bool LoadSnapshot(QString storageFolder, QString fileBase, QHash<uint32_t, genre_stats::ListMoodData>& data);
+}
@@ -18,6 +18,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include "Interfaces/data_source.h"
 #include "pure_sql.h"
 #include "Interfaces/db_interface.h"
+#include "sqlitefunctions.h"
+#include "cancellation_token.h"
 #include <QDebug>
 #include <QSqlError>
 
@@ -50,22 +52,7 @@ sql::Query FicSourceDirect::BuildQuery(const core::StoryFilter& filter, bool cou
         currentQuery = countQueryBuilder.Build(filter);
     else
         currentQuery = queryBuilder.Build(filter);
-    sql::Query q(db->GetDatabase());
-    q.prepare(currentQuery->str);
-    auto it = currentQuery->bindings.cbegin();
-    auto end = currentQuery->bindings.cend();
-    while(it != end)
-    {
-        if(currentQuery->str.find(it->key) != std::string::npos)
-        {
-            q.bindValue(it->key, it->value);
-        }
-        else{
-            qDebug() << "Key not found: " << it->key;
-        }
-        ++it;
-    }
-
+    auto q = database::sqlite::PrepareCached(currentQuery->str, currentQuery->bindings, db->GetDatabase());
     return q;
 }
 
@@ -163,8 +150,14 @@ void FicSourceDirect::FetchData(const core::StoryFilter& searchfilter, QVector<c
     int counter = 0;
     data->clear();
     lastFicId = -1;
+    const auto& cancellation = CancellationScope::Current();
     while(q.next())
     {
+        if(counter%256 == 0 && cancellation.IsCancelled())
+        {
+            QLOG_INFO_PURE() << "Fetching cancelled after rows: " << counter;
+            break;
+        }
         counter++;
         auto fic = LoadFanfic(q);
         bool filterOk = true;
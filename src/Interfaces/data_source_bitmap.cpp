@@ -0,0 +1,411 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "Interfaces/data_source_bitmap.h"
+#include "Interfaces/genres.h"
+#include "include/data_code/fic_store.h"
+#include "in_tag_accessor.h"
+#include "logger/QsLog.h"
+
+#include <algorithm>
+#include <limits>
+
+using core::StoryFilter;
+
+static constexpr int32_t minColumnValue = std::numeric_limits<int32_t>::min();
+static constexpr int32_t maxColumnValue = std::numeric_limits<int32_t>::max();
+
+// date filter bounds come as yyyy-MM-dd strings that are compared to the date columns as text
+// so 2019-00-00 is the same as the start of 2019
+static std::optional<int32_t> ParseFilterDay(const std::string& value){
+    const auto parts = QString::fromStdString(value).left(10).split(QStringLiteral("-"));
+    if(parts.size() != 3)
+        return {};
+    bool yearOk = false, monthOk = false, dayOk = false;
+    const int year = parts[0].toInt(&yearOk);
+    const int month = parts[1].toInt(&monthOk);
+    const int day = parts[2].toInt(&dayOk);
+    if(!yearOk || !monthOk || !dayOk)
+        return {};
+    QDate date(year, std::clamp(month, 1, 12), 1);
+    if(!date.isValid())
+        return {};
+    date = date.addDays(std::clamp(day, 1, date.daysInMonth()) - 1);
+    return static_cast<int32_t>(date.toJulianDay());
+}
+
+static bool UsesRecommendationFiltering(const StoryFilter& filter){
+    bool scoreSorting = filter.sortMode == StoryFilter::sm_metascore
+            || filter.sortMode == StoryFilter::sm_minimize_dislikes
+            || filter.sortMode == StoryFilter::sm_gems;
+    return (scoreSorting || filter.listOpenMode) && filter.recommendationsCount > 0;
+}
+
+static bool HasWords(const QStringList& words){
+    return std::any_of(words.cbegin(), words.cend(), [](const QString& word){return !word.trimmed().isEmpty();});
+}
+
+template <typename Container>
+static Roaring BitmapFromIds(const Container& ids){
+    Roaring result;
+    for(auto id : ids)
+        if(id >= 0)
+            result.add(static_cast<uint32_t>(id));
+    return result;
+}
+
+FicSourceBitmap::FicSourceBitmap(QSharedPointer<const core::FicSearchIndex> index, QSharedPointer<FicSourceDirect> directSource)
+    :index(index), directSource(directSource)
+{
+}
+
+bool FicSourceBitmap::CanEvaluate(const StoryFilter &filter) const
+{
+    if(!index || index->Size() == 0)
+        return false;
+    if(filter.randomizeResults || filter.tagsAreUsedForAuthors || filter.listOpenMode)
+        return false;
+    if(filter.mode == StoryFilter::filtering_in_recommendations)
+        return false;
+    if(filter.useThisAuthor != -1 || !filter.exactFicIds.isEmpty())
+        return false;
+    if(filter.reviewBias != StoryFilter::bias_none)
+        return false;
+    if(HasWords(filter.wordInclusion) || HasWords(filter.wordExclusion))
+        return false;
+    if(filter.useRealGenres && (!filter.genreInclusion.isEmpty() || !filter.genreExclusion.isEmpty()))
+        return false;
+    if(!GenreIndices(filter.genreInclusion) || !GenreIndices(filter.genreExclusion))
+        return false;
+    const auto& slash = filter.slashFilter;
+    if(slash.slashFilterEnabled && slash.excludeSlash && slash.enableFandomExceptions)
+        return false;
+    if(filter.ficDateFilter.mode != filters::dft_none
+            && (!ParseFilterDay(filter.ficDateFilter.dateStart) || !ParseFilterDay(filter.ficDateFilter.dateEnd)))
+        return false;
+
+    switch(filter.sortMode){
+    case StoryFilter::sm_wordcount:
+    case StoryFilter::sm_favourites:
+    case StoryFilter::sm_updatedate:
+    case StoryFilter::sm_publisdate:
+    case StoryFilter::sm_metascore:
+    case StoryFilter::sm_minimize_dislikes:
+    case StoryFilter::sm_revtofav:
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::optional<std::vector<size_t>> FicSourceBitmap::GenreIndices(const QStringList &genres) const
+{
+    std::vector<size_t> result;
+    An<interfaces::GenreIndex> genreIndex;
+    for(const auto& genre : genres)
+    {
+        auto it = std::as_const(genreIndex->genresByName).find(genre);
+        if(it == genreIndex->genresByName.cend() || it.value().indexInDatabase >= index->genres.size())
+            return {};
+        result.push_back(it.value().indexInDatabase);
+    }
+    return result;
+}
+
+Roaring FicSourceBitmap::IgnoredFandomFics() const
+{
+    // mirrors cfInIgnoredFandoms
+    using namespace core::fandom_lists;
+    auto* userData = ThreadData::GetUserData();
+    auto selectsPure = [](const FandomSearchStateToken& state){
+        return state.crossoverInclusionMode == cim_select_all || state.crossoverInclusionMode == cim_select_pure;
+    };
+    auto selectsCrossovers = [](const FandomSearchStateToken& state){
+        return state.crossoverInclusionMode == cim_select_all || state.crossoverInclusionMode == cim_select_crossovers;
+    };
+    std::vector<const Roaring*> ignoredParts;
+    std::vector<const Roaring*> whitelistedParts;
+    for(const auto& state : userData->fandomStates)
+    {
+        const int fandom = static_cast<int>(state.first);
+        auto& parts = state.second.inclusionMode == im_include ? whitelistedParts : ignoredParts;
+        auto itPure = index->pureFandomFics.find(fandom);
+        if(selectsPure(state.second) && itPure != index->pureFandomFics.cend())
+            parts.push_back(&itPure.value());
+        auto itCrossover = index->crossoverFandomFics.find(fandom);
+        if(selectsCrossovers(state.second) && itCrossover != index->crossoverFandomFics.cend())
+            parts.push_back(&itCrossover.value());
+    }
+    Roaring result = ignoredParts.empty() ? Roaring() : Roaring::fastunion(ignoredParts.size(), ignoredParts.data());
+    if(userData->hasWhitelistedFandoms)
+    {
+        Roaring whitelisted = whitelistedParts.empty() ? Roaring() : Roaring::fastunion(whitelistedParts.size(), whitelistedParts.data());
+        result |= index->all - whitelisted;
+    }
+    return result;
+}
+
+Roaring FicSourceBitmap::SlashFics(const StoryFilter &filter) const
+{
+    const auto& slash = filter.slashFilter;
+    const Roaring* levelFics = &index->slashKeywords;
+    if(slash.slashFilterLevel == 1)
+        levelFics = &index->slashPass1;
+    else if(slash.slashFilterLevel > 1)
+        levelFics = &index->slashPass2;
+
+    if(slash.slashFilterLevel > 1 && slash.onlyMatureForSlash && !(slash.includeSlash && slash.onlyExactLevel))
+        return index->slashPass1 | (index->slashPass2 & index->ratedM);
+    if(slash.includeSlash && slash.onlyExactLevel)
+    {
+        Roaring result = *levelFics;
+        for(const auto* other : {&index->slashKeywords, &index->slashPass1, &index->slashPass2})
+            if(other != levelFics)
+                result -= *other;
+        return result;
+    }
+    return *levelFics;
+}
+
+Roaring FicSourceBitmap::ActiveFics(const StoryFilter &filter) const
+{
+    const auto today = static_cast<int32_t>(QDate::currentDate().toJulianDay());
+    return index->complete | index->updatedRanges.Select(today - filter.deadFicDaysRange, maxColumnValue, index->ids, index->updated);
+}
+
+Roaring FicSourceBitmap::Evaluate(const StoryFilter &filter) const
+{
+    // follows DefaultQueryBuilder::CreateWhere with the client side tag and fandom ignore builders
+    Roaring result = index->all;
+    if(filter.minWords > 0 || filter.maxWords > 0)
+        result &= index->wordCountRanges.Select(filter.minWords > 0 ? filter.minWords : minColumnValue,
+                                                filter.maxWords > 0 ? filter.maxWords : maxColumnValue,
+                                                index->ids, index->wordCount);
+    if(filter.rating == StoryFilter::rt_t)
+        result -= index->ratedM;
+    else if(filter.rating == StoryFilter::rt_m)
+        result &= index->ratedM;
+
+    if(filter.otherFandomsMode)
+        result &= IgnoredFandomFics();
+
+    const auto& slash = filter.slashFilter;
+    if(slash.slashFilterEnabled && (slash.excludeSlash || slash.includeSlash))
+    {
+        if(slash.excludeSlash)
+            result -= SlashFics(filter);
+        else
+            result &= SlashFics(filter);
+    }
+
+    for(auto genre : *GenreIndices(filter.genreInclusion))
+        result &= index->genres[genre];
+    for(auto genre : *GenreIndices(filter.genreExclusion))
+        result -= index->genres[genre];
+
+    if(filter.ficDateFilter.mode != filters::dft_none)
+    {
+        const auto start = *ParseFilterDay(filter.ficDateFilter.dateStart);
+        const auto end = *ParseFilterDay(filter.ficDateFilter.dateEnd);
+        if(filter.ficDateFilter.mode == filters::dft_published)
+            result &= index->publishedRanges.Select(start, end - 1, index->ids, index->published);
+        else
+            result &= index->updatedRanges.Select(start, end - 1, index->ids, index->updated) & index->complete;
+    }
+
+    if(UsesRecommendationFiltering(filter))
+    {
+        auto* recs = ThreadData::GetRecommendationData();
+        Roaring recommended;
+        for(const auto& fic : recs->ficMetascores)
+            recommended.add(static_cast<uint32_t>(fic.first));
+        result &= recommended;
+    }
+
+    if(filter.minFavourites > 0)
+        result &= index->favouritesRanges.Select(filter.minFavourites + 1, maxColumnValue, index->ids, index->favourites);
+
+    if(filter.ensureCompleted)
+        result &= index->complete;
+    if(!filter.allowUnfinished || filter.ensureActive)
+        result &= ActiveFics(filter);
+    if(!filter.allowNoGenre)
+        result -= index->noGenre;
+
+    if(filter.fandom != -1)
+    {
+        result &= index->FandomFics(filter.fandom);
+        if(filter.secondFandom != -1)
+            result &= index->FandomFics(filter.secondFandom);
+    }
+
+    auto* userData = ThreadData::GetUserData();
+    if(!filter.usedRecommenders.isEmpty())
+        result &= BitmapFromIds(userData->ficsForAuthorSearch);
+    if(!filter.displaySnoozedFics)
+        result -= BitmapFromIds(userData->allSnoozedFics);
+
+    if(filter.mode == StoryFilter::filtering_in_fics && filter.activeTagsCount > 0)
+        result &= BitmapFromIds(userData->ficIDsForActivetags);
+    else if(!filter.ignoreAlreadyTagged && filter.allTagsCount != 0)
+        result -= BitmapFromIds(userData->allTaggedFics);
+
+    if(filter.ignoreFandoms && filter.ignoredFandomCount > 0)
+        result -= IgnoredFandomFics();
+
+    if(filter.crossoversOnly)
+        result &= index->crossovers;
+    else if(!filter.includeCrossovers)
+        result -= index->crossovers;
+    return result;
+}
+
+std::vector<uint32_t> FicSourceBitmap::SortAndPage(const Roaring &fics, const StoryFilter &filter) const
+{
+    std::vector<std::pair<int64_t, uint32_t>> keyed;
+    keyed.reserve(fics.cardinality());
+    auto* recs = ThreadData::GetRecommendationData();
+    uint32_t ordinal = 0;
+    for(auto fic : fics)
+    {
+        ordinal = index->OrdinalFor(fic, ordinal);
+        if(ordinal == core::FicStore::invalidOrdinal)
+        {
+            ordinal = 0;
+            continue;
+        }
+        int64_t key = 0;
+        switch(filter.sortMode){
+        case StoryFilter::sm_wordcount:
+            key = index->wordCount[ordinal];
+            break;
+        case StoryFilter::sm_favourites:
+            key = index->favourites[ordinal];
+            break;
+        case StoryFilter::sm_updatedate:
+            key = index->updated[ordinal];
+            break;
+        case StoryFilter::sm_publisdate:
+            key = index->published[ordinal];
+            break;
+        case StoryFilter::sm_revtofav:
+            key = index->favourites[ordinal]/(index->reviews[ordinal] + 1);
+            break;
+        default:
+        {
+            auto it = recs->ficMetascores.find(static_cast<int>(fic));
+            key = it != recs->ficMetascores.end() ? it->second : 0;
+        }
+        }
+        keyed.push_back({key, fic});
+    }
+
+    size_t offset = 0;
+    size_t pageEnd = keyed.size();
+    if(filter.recordLimit > 0)
+    {
+        offset = filter.recordPage > -1 ? static_cast<size_t>(filter.recordPage) * static_cast<size_t>(filter.recordLimit) : 0;
+        pageEnd = std::min(keyed.size(), offset + static_cast<size_t>(filter.recordLimit));
+    }
+    std::vector<uint32_t> result;
+    if(offset >= keyed.size())
+        return result;
+
+    auto comparator = [descending = filter.descendingDirection](const auto& left, const auto& right){
+        if(left.first != right.first)
+            return descending ? left.first > right.first : left.first < right.first;
+        return left.second < right.second;
+    };
+    std::partial_sort(keyed.begin(), keyed.begin() + static_cast<std::ptrdiff_t>(pageEnd), keyed.end(), comparator);
+    result.reserve(pageEnd - offset);
+    for(size_t i = offset; i < pageEnd; i++)
+        result.push_back(keyed[i].second);
+    return result;
+}
+
+int FicSourceBitmap::GetFicCount(const StoryFilter &filter)
+{
+    if(!CanEvaluate(filter))
+        return directSource->GetFicCount(filter);
+    return static_cast<int>(Evaluate(filter).cardinality());
+}
+
+void FicSourceBitmap::FetchData(const StoryFilter &filter, QVector<core::Fanfic> *data)
+{
+    if(!data)
+        return;
+    if(!CanEvaluate(filter))
+    {
+        QLOG_INFO() << "filter can't be evaluated over the search index, using sql";
+        directSource->filters = filters;
+        directSource->FetchData(filter, data);
+        lastFicId = directSource->lastFicId;
+        return;
+    }
+    const auto survivors = Evaluate(filter);
+    const auto page = SortAndPage(survivors, filter);
+    QLOG_INFO() << "bitmap search survivors: " << survivors.cardinality() << " page: " << page.size();
+
+    data->clear();
+    lastFicId = -1;
+    if(page.empty())
+        return;
+
+    // everything the original filter asked for is already applied, the page is loaded by id
+    StoryFilter pageFilter;
+    pageFilter.mode = StoryFilter::filtering_in_fics;
+    pageFilter.sortMode = StoryFilter::sm_wordcount;
+    pageFilter.rating = StoryFilter::rt_t_m;
+    pageFilter.reviewBias = StoryFilter::bias_none;
+    pageFilter.slashFilter.slashFilterEnabled = false;
+    pageFilter.displaySnoozedFics = true;
+    pageFilter.userToken = filter.userToken;
+    pageFilter.protocolMajorVersion = filter.protocolMajorVersion;
+    pageFilter.protocolMinorVersion = filter.protocolMinorVersion;
+    QHash<int, int> positions;
+    positions.reserve(static_cast<int>(page.size()));
+    for(size_t i = 0; i < page.size(); i++)
+    {
+        pageFilter.exactFicIds.push_back({static_cast<int>(page[i]), StoryFilter::utf_db_id});
+        positions.insert(static_cast<int>(page[i]), static_cast<int>(i));
+    }
+
+    QVector<core::Fanfic> loaded;
+    directSource->filters.clear();
+    directSource->FetchData(pageFilter, &loaded);
+
+    QVector<std::optional<core::Fanfic>> ordered(static_cast<int>(page.size()));
+    for(auto& fic : loaded)
+    {
+        auto it = positions.find(fic.identity.id);
+        if(it != positions.end())
+            ordered[it.value()] = std::move(fic);
+    }
+    data->reserve(ordered.size());
+    for(auto& fic : ordered)
+    {
+        if(!fic)
+            continue;
+        bool filterOk = true;
+        for(const auto& ficFilter: std::as_const(filters))
+            filterOk = filterOk && ficFilter->Passed(&*fic, filter.slashFilter);
+        if(filterOk)
+            data->push_back(std::move(*fic));
+    }
+    if(data->size() > 0)
+        lastFicId = (*data)[data->size() - 1].identity.id;
+}
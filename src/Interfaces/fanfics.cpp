@@ -339,6 +339,16 @@ QHash<int, core::FicWeightPtr> Fanfics::GetHashOfAllFicsWithEnoughFavesForWeight
     return result;
 }
 
+bool Fanfics::ProcessFicsForSearchIndex(std::function<void (const core::FicSearchRecord &)> processor)
+{
+    return sql::ProcessFicsForSearchIndex(processor, db).success;
+}
+
+bool Fanfics::ProcessFicIdPairs(std::function<void (int, int)> processor)
+{
+    return sql::ProcessFicIdPairs(processor, db).success;
+}
+
 bool Fanfics::ProcessSlashFicsBasedOnWords( std::function<SlashPresence (QString, QString, QString)> func)
 {
      auto result = sql::ProcessSlashFicsBasedOnWords(func, db);
@@ -410,6 +420,11 @@ QHash<uint32_t, core::FicWeightPtr> Fanfics::GetFicsForRecCreation()
     return sql::GetFicsForRecCreation(db).data;
 }
 
+QHash<uint32_t, core::FicWeightPtr> Fanfics::GetFicsForRecCreation(QList<int> ids)
+{
+    return sql::GetFicsForRecCreationByIds(ids, db).data;
+}
+
 bool Fanfics::ConvertFFNTaggedFicsToDB(QHash<int, int>& hash)
 {
     return sql::ConvertFFNTaggedFicsToDB(hash, db).success;
@@ -157,69 +157,20 @@ void Genres::LogGenreDistribution(std::array<double, 22> &data, QString target)
 
 QString Genres::MoodForGenre(QString genre)
 {
-    //QLOG_INFO() << "Reading mood for genre: " << genre;
-    QString result;
-    thread_local QStringList neutral = {"Adventure" , "Mystery" , "Supernatural" ,  "Suspense" , "Sci-Fi"
-                                        , "Fantasy" , "Spiritual" , "Western" , "Crime"};
-    thread_local QStringList flirty = {"Romance"};
-    thread_local QStringList funny = {"Humor" , "Parody"};
-    thread_local QStringList hurty = {"Hurt/Comfort"};
-    thread_local QStringList bondy = {"Family" , "Friendship"};
-    thread_local QStringList dramatic = { "Drama" , "Tragedy" , "Angst"};
-    thread_local QStringList shocky = {"Horror"};
-    if(neutral.contains(genre))
-        result = QStringLiteral("Neutral");
-    if(flirty.contains(genre))
-        result = QStringLiteral("Flirty");
-    if(funny.contains(genre))
-        result = QStringLiteral("Funny");
-    if(hurty.contains(genre))
-        result = QStringLiteral("Hurty");
-    if(bondy.contains(genre))
-        result = QStringLiteral("Bondy");
-    if(dramatic.contains(genre))
-        result = QStringLiteral("Dramatic");
-    if(shocky.contains(genre))
-        result = QStringLiteral("Shocky");
-    //QLOG_INFO() << "returning:" << result;
-    return result;
+    auto index = genre_stats::GenreForName(genre);
+    if(index < 0)
+        return QString();
+    return QString::fromLatin1(genre_stats::moodNames[genre_stats::genreMoods[index]]);
 }
 
 void Genres::WriteMoodValue(QString mood, float value, genre_stats::ListMoodData & data)
 {
-    if(mood == QStringLiteral("Neutral"))
-        data.strengthNeutral+=value;
-    if(mood == QStringLiteral("Funny"))
-        data.strengthFunny+=value;
-    if(mood == QStringLiteral("Hurty"))
-        data.strengthHurty+=value;
-    if(mood == QStringLiteral("Bondy"))
-        data.strengthBondy+=value;
-    if(mood == QStringLiteral("Dramatic"))
-        data.strengthDramatic+=value;
-    if(mood == QStringLiteral("Shocky"))
-        data.strengthShocky+=value;
-    if(mood == QStringLiteral("Flirty"))
-        data.strengthFlirty+=value;
+    data.AddMoodValue(genre_stats::MoodForName(mood), value);
 }
 
 float Genres::ReadMoodValue(QString mood, const genre_stats::ListMoodData & data)
 {
-    if(mood ==QStringLiteral("Neutral"))
-        return data.strengthNeutral;
-    if(mood ==QStringLiteral("Funny"))
-        return data.strengthFunny;
-    if(mood ==QStringLiteral("Hurty"))
-        return data.strengthHurty;
-    if(mood ==QStringLiteral("Bondy"))
-        return data.strengthBondy;
-    if(mood ==QStringLiteral("Dramatic"))
-        return data.strengthDramatic;
-    if(mood ==QStringLiteral("Shocky"))
-        return data.strengthShocky;
-    if(mood ==QStringLiteral("Flirty"))
-        return data.strengthFlirty;
-    return 0.f;
+    return data.MoodValue(genre_stats::MoodForName(mood));
 }
 
 
@@ -625,6 +576,8 @@ void GenreIndex::Init()
     InitGenre({true,counter++,QStringLiteral("Hurt/Comfort"), QStringLiteral("HurtComfort"), mt_neutral, gc_hurty});
     InitGenre({true,counter++,QStringLiteral("Friendship"), QStringLiteral(""), mt_neutral, gc_bondy});
     InitGenre({true,counter++,QStringLiteral("Drama"), QStringLiteral(""), mt_sad, gc_dramatic});
+    // genre masks rely on the indices being the same as genre_stats::EGenre
+    Q_ASSERT(counter == genre_stats::g_count);
 }
 
 void GenreIndex::InitGenre(const Genre &genre)
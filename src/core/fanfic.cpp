@@ -160,6 +160,7 @@ void FanficDataForRecommendationCreation::Deserialize(QDataStream &in)
     in >> favCount;
     //qDebug() << "favCount: " << favCount;
     in >> genreString;
+    genreMask = genre_stats::GenreMaskFromString(genreString);
     //qDebug() << "genreString: " << genreString;
     in >> published;
     //qDebug() << "published: " << published;
@@ -84,6 +84,14 @@ void FicListDataAccumulator::AddFandoms(const QList<int>& fandoms){
             fandomCounters[ficFandom]++;
     }
 }
+void FicListDataAccumulator::AddFandoms(int fandom1, int fandom2){
+    if(fandom1 != -1 && fandom2 != -1)
+        crossoverCounter++;
+    if(fandom1 != -1)
+        fandomCounters[fandom1]++;
+    if(fandom2 != -1)
+        fandomCounters[fandom2]++;
+}
 // wordcount average fic wordcount, size factors
 void FicListDataAccumulator::AddWordcount(int wordcount, int chapters){
     this->wordcount+=wordcount;
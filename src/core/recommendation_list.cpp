@@ -22,10 +22,52 @@ void core::RecommendationList:: Log()
     qDebug() << "minimumMatch: " << minimumMatch ;
     qDebug() << "alwaysPickAt: " << alwaysPickAt ;
     qDebug() << "pickRatio: " << maxUnmatchedPerMatch ;
+    qDebug() << "sketchContainment: " << sketchContainment ;
     qDebug() << "created: " << created.toString();
     //qDebug() << "source fics: " << ficData.sourceFics;
 }
 
+core::RecPtr core::RecommendationList::NewSimilarFicList()
+{
+    auto list = NewRecList();
+    list->minimumMatch = 1;
+    list->isAutomatic = true;
+    list->useWeighting = false;
+    list->alwaysPickAt = 9999;
+    list->useMoodAdjustment = false;
+    list->ignoreBreakdowns = true;
+    list->listSizeMultiplier = 20000;
+    list->resultLimit = similarFicListSize;
+    list->userFFNId = -1;
+    return list;
+}
+
+bool core::RecommendationList::IsSimilarFicList() const
+{
+    static const auto reference = NewSimilarFicList();
+    return isAutomatic == reference->isAutomatic
+            && useWeighting == reference->useWeighting
+            && useMoodAdjustment == reference->useMoodAdjustment
+            && useDislikes == reference->useDislikes
+            && useDeadFicIgnore == reference->useDeadFicIgnore
+            && minimumMatch == reference->minimumMatch
+            && alwaysPickAt == reference->alwaysPickAt
+            && maxUnmatchedPerMatch == reference->maxUnmatchedPerMatch
+            && listSizeMultiplier == reference->listSizeMultiplier
+            && ficFavouritesCutoff == reference->ficFavouritesCutoff
+            && ignoreBreakdowns == reference->ignoreBreakdowns
+            // the table holds the first reference->resultLimit neighbours, shorter lists are a prefix of them
+            && resultLimit > 0 && resultLimit <= reference->resultLimit
+            && userFFNId < 0
+            && tagToUse.isEmpty()
+            && likedAuthors.isEmpty()
+            && (!ficData || ficData->taggedFics.isEmpty())
+            && ignoredFandoms.isEmpty()
+            && ignoredDeadFics.isEmpty()
+            && minorNegativeVotes.isEmpty()
+            && majorNegativeVotes.isEmpty();
+}
+
 void core::RecommendationList::PassSetupParamsInto(RecommendationList &other)
 {
     other.isAutomatic = isAutomatic;
@@ -36,6 +78,7 @@ void core::RecommendationList::PassSetupParamsInto(RecommendationList &other)
     other.minimumMatch = minimumMatch;
     other.alwaysPickAt = alwaysPickAt;
     other.maxUnmatchedPerMatch = maxUnmatchedPerMatch;
+    other.sketchContainment = sketchContainment;
     other.name = name;
 }
 
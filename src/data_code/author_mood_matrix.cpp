@@ -0,0 +1,137 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/data_code/author_mood_matrix.h"
+
+#include <QDebug>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AUTHOR_MOODS_HAS_AVX_PATH
+#endif
+
+namespace core{
+
+namespace {
+// lanes past this one make up the touchy difference
+constexpr int firstTouchyLane = genre_stats::gm_shocky - 1;
+
+void CalcDifferencesScalar(const AuthorMoodMatrix::Row* rows, size_t count, const AuthorMoodMatrix::Row& list, double* neutral, double* touchy)
+{
+    for(size_t row = 0; row < count; row++)
+    {
+        double neutralDifference = 0., touchyDifference = 0.;
+        for(int lane = 0; lane < AuthorMoodMatrix::moodLanes; lane++)
+        {
+            const double difference = std::fabs(rows[row].values[lane] - list.values[lane]);
+            if(lane >= firstTouchyLane)
+                touchyDifference += difference;
+            neutralDifference += difference;
+        }
+        neutral[row] = neutralDifference;
+        touchy[row] = touchyDifference;
+    }
+}
+
+#ifdef AUTHOR_MOODS_HAS_AVX_PATH
+__attribute__((target("avx")))
+inline double HorizontalSum(__m256d value)
+{
+    const __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(value), _mm256_extractf128_pd(value, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+// differences are taken in float like the scalar path and summed in double
+__attribute__((target("avx")))
+void CalcDifferencesAvx(const AuthorMoodMatrix::Row* rows, size_t count, const AuthorMoodMatrix::Row& list, double* neutral, double* touchy)
+{
+    static_assert(firstTouchyLane == 2, "touchy lanes are blended in below");
+    const __m256 listValues = _mm256_load_ps(list.values);
+    const __m256 signMask = _mm256_set1_ps(-0.f);
+    const __m256d zero = _mm256_setzero_pd();
+    for(size_t row = 0; row < count; row++)
+    {
+        const __m256 difference = _mm256_andnot_ps(signMask, _mm256_sub_ps(_mm256_load_ps(rows[row].values), listValues));
+        const __m256d low = _mm256_cvtps_pd(_mm256_castps256_ps128(difference));
+        const __m256d high = _mm256_cvtps_pd(_mm256_extractf128_ps(difference, 1));
+        // lanes 2 and 3 of the lower half and all of the upper one
+        const double touchyDifference = HorizontalSum(_mm256_add_pd(high, _mm256_blend_pd(zero, low, 0b1100)));
+        const __m128d neutralLanes = _mm256_castpd256_pd128(low);
+        neutral[row] = touchyDifference + _mm_cvtsd_f64(neutralLanes) + _mm_cvtsd_f64(_mm_unpackhi_pd(neutralLanes, neutralLanes));
+        touchy[row] = touchyDifference;
+    }
+}
+
+bool CpuHasAvx()
+{
+    static const bool hasAvx = __builtin_cpu_supports("avx");
+    return hasAvx;
+}
+#endif
+}
+
+AuthorMoodMatrix::Row AuthorMoodMatrix::RowFor(const genre_stats::ListMoodData &moodData)
+{
+    Row row;
+    for(int mood = genre_stats::gm_neutral; mood < genre_stats::gm_count; mood++)
+        row.values[mood - 1] = moodData.MoodValue(static_cast<genre_stats::EGenreMood>(mood));
+    return row;
+}
+
+void AuthorMoodMatrix::Build(const QHash<uint32_t, genre_stats::ListMoodData> &moods, const AuthorOrdinals &authorOrdinals)
+{
+    Clear();
+    if(moods.isEmpty())
+        return;
+    rows.resize(authorOrdinals.Size());
+    hasMoods.assign(authorOrdinals.Size(), 0);
+    int authorsWithoutOrdinals = 0;
+    for(auto it = moods.cbegin(); it != moods.cend(); it++)
+    {
+        const auto ordinal = authorOrdinals.OrdinalFor(static_cast<int>(it.key()));
+        if(ordinal == AuthorOrdinals::invalidOrdinal)
+        {
+            authorsWithoutOrdinals++;
+            continue;
+        }
+        rows[ordinal] = RowFor(it.value());
+        hasMoods[ordinal] = 1;
+    }
+    qDebug() << "built mood matrix for authors: " << rows.size() << " without favourites: " << authorsWithoutOrdinals;
+}
+
+void AuthorMoodMatrix::Clear()
+{
+    rows.clear();
+    rows.shrink_to_fit();
+    hasMoods.clear();
+}
+
+void AuthorMoodMatrix::CalcDifferences(const Row &list, double *neutral, double *touchy) const
+{
+#ifdef AUTHOR_MOODS_HAS_AVX_PATH
+    if(CpuHasAvx())
+    {
+        CalcDifferencesAvx(rows.data(), rows.size(), list, neutral, touchy);
+        return;
+    }
+#endif
+    CalcDifferencesScalar(rows.data(), rows.size(), list, neutral, touchy);
+}
+
+}
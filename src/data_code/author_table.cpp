@@ -0,0 +1,153 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/data_code/author_table.h"
+
+#include <QMutexLocker>
+
+namespace core{
+
+void AuthorOrdinals::Build(const QHash<int, Roaring>& faves)
+{
+    Clear();
+    ids.reserve(static_cast<size_t>(faves.size()));
+    for(auto it = faves.cbegin(); it != faves.cend(); it++)
+        ids.push_back(it.key());
+    std::sort(ids.begin(), ids.end());
+
+    const auto size = ids.size();
+    favourites.reserve(size);
+    for(auto id : ids)
+        favourites.push_back(&faves.find(id).value());
+
+    const bool denseIds = size > 0 && ids.front() >= 0 && static_cast<size_t>(ids.back()) / 4 < size;
+    if(denseIds)
+    {
+        ordinals.assign(static_cast<size_t>(ids.back()) + 1, invalidOrdinal);
+        for(uint32_t ordinal = 0; ordinal < size; ordinal++)
+            ordinals[static_cast<size_t>(ids[ordinal])] = ordinal;
+    }
+}
+
+void AuthorOrdinals::Clear()
+{
+    ids.clear();
+    favourites.clear();
+    ordinals.clear();
+}
+
+void AuthorResultTable::Init(const AuthorOrdinals* authorOrdinals)
+{
+    ordinals = authorOrdinals;
+    if(authors.size() != ordinals->Size())
+    {
+        authors.assign(ordinals->Size(), AuthorResult());
+        used.assign(ordinals->Size(), 0);
+        touched.clear();
+        authorsOutsideOrdinals.clear();
+    }
+    else
+        Reset();
+}
+
+void AuthorResultTable::Reset()
+{
+    for(auto ordinal : touched)
+    {
+        authors[ordinal] = AuthorResult();
+        used[ordinal] = 0;
+    }
+    touched.clear();
+    authorsOutsideOrdinals.clear();
+}
+
+AuthorResult& AuthorResultTable::operator[](int authorId)
+{
+    const auto ordinal = ordinals->OrdinalFor(authorId);
+    if(ordinal == AuthorOrdinals::invalidOrdinal)
+        return authorsOutsideOrdinals[authorId];
+    if(!used[ordinal])
+    {
+        used[ordinal] = 1;
+        touched.push_back(ordinal);
+    }
+    return authors[ordinal];
+}
+
+bool AuthorResultTable::Contains(int authorId) const
+{
+    const auto ordinal = ordinals->OrdinalFor(authorId);
+    if(ordinal == AuthorOrdinals::invalidOrdinal)
+        return authorsOutsideOrdinals.find(authorId) != authorsOutsideOrdinals.cend();
+    return used[ordinal] != 0;
+}
+
+AuthorResultTablePool::~AuthorResultTablePool()
+{
+    for(auto table : freeTables)
+        delete table;
+}
+
+void AuthorResultTablePool::SetOrdinals(const AuthorOrdinals* authorOrdinals)
+{
+    QMutexLocker locker(&lock);
+    ordinals = authorOrdinals;
+    generation++;
+    for(auto table : freeTables)
+        delete table;
+    freeTables.clear();
+}
+
+QSharedPointer<AuthorResultTable> AuthorResultTablePool::Acquire()
+{
+    AuthorResultTable* table = nullptr;
+    const AuthorOrdinals* tableOrdinals = nullptr;
+    uint32_t tableGeneration = 0;
+    {
+        QMutexLocker locker(&lock);
+        tableOrdinals = ordinals ? ordinals : &noOrdinals;
+        tableGeneration = generation;
+        if(!freeTables.empty())
+        {
+            table = freeTables.back();
+            freeTables.pop_back();
+        }
+    }
+    // first use of a table allocates it for every author, that happens outside of the lock
+    if(!table)
+    {
+        table = new AuthorResultTable;
+        table->Init(tableOrdinals);
+    }
+    return QSharedPointer<AuthorResultTable>(table, [this, tableGeneration](AuthorResultTable* table){
+        Release(table, tableGeneration);
+    });
+}
+
+void AuthorResultTablePool::Release(AuthorResultTable* table, uint32_t tableGeneration)
+{
+    table->Reset();
+    QMutexLocker locker(&lock);
+    if(tableGeneration != generation)
+    {
+        delete table;
+        return;
+    }
+    freeTables.push_back(table);
+}
+
+}
@@ -0,0 +1,388 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/data_code/fic_cooccurrence.h"
+#include "include/data_code/vector_io.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QDataStream>
+#include <QFuture>
+#include <QMutex>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+
+namespace core{
+
+namespace {
+constexpr char matrixMagic[4] = {'F', 'C', 'O', 'C'};
+constexpr quint32 matrixVersion = 1;
+
+// row fic in the high half so that sorting the keys groups the pairs by row
+uint64_t PairKey(uint32_t row, uint32_t neighbour){return (static_cast<uint64_t>(row) << 32) | neighbour;}
+uint32_t RowOf(uint64_t key){return static_cast<uint32_t>(key >> 32);}
+uint32_t NeighbourOf(uint64_t key){return static_cast<uint32_t>(key);}
+
+uint32_t PartitionFor(uint32_t row, uint32_t partitions){
+    const uint32_t hash = row * 2654435761u;
+    return static_cast<uint32_t>((static_cast<uint64_t>(hash) * partitions) >> 32);
+}
+
+// pair key followed by its count, as stored in the run files
+constexpr qint64 recordSize = sizeof(uint64_t) + sizeof(uint32_t);
+
+// sorts the buffered keys and writes them with the amount of times each occurred
+bool SpillRun(std::vector<uint64_t>& keys, const QString& fileName)
+{
+    std::sort(keys.begin(), keys.end());
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qDebug() << "Could not create cooccurrence run: " << fileName;
+        return false;
+    }
+    QByteArray buffer;
+    buffer.reserve(static_cast<int>(std::min<size_t>(keys.size(), 1u << 16) * recordSize));
+    for(size_t i = 0; i < keys.size();)
+    {
+        size_t next = i + 1;
+        while(next < keys.size() && keys[next] == keys[i])
+            next++;
+        const uint32_t count = static_cast<uint32_t>(next - i);
+        buffer.append(reinterpret_cast<const char*>(&keys[i]), sizeof(uint64_t));
+        buffer.append(reinterpret_cast<const char*>(&count), sizeof(uint32_t));
+        if(buffer.size() >= (1 << 16) * recordSize)
+        {
+            file.write(buffer);
+            buffer.clear();
+        }
+        i = next;
+    }
+    file.write(buffer);
+    keys.clear();
+    return file.error() == QFileDevice::NoError;
+}
+
+// sequential reader of a single run file
+struct RunReader{
+    bool Open(const QString& fileName){
+        file.setFileName(fileName);
+        return file.open(QIODevice::ReadOnly) && Next();
+    }
+    bool Next(){
+        if(position + recordSize > buffer.size())
+        {
+            buffer = buffer.mid(position) + file.read((1 << 16) * recordSize);
+            position = 0;
+            if(buffer.size() < recordSize)
+                return false;
+        }
+        std::memcpy(&key, buffer.constData() + position, sizeof(uint64_t));
+        std::memcpy(&count, buffer.constData() + position + sizeof(uint64_t), sizeof(uint32_t));
+        position += static_cast<int>(recordSize);
+        return true;
+    }
+    QFile file;
+    QByteArray buffer;
+    int position = 0;
+    uint64_t key = 0;
+    uint32_t count = 0;
+};
+
+// rows of a single partition, in ascending order of their fics
+struct PartitionRows{
+    std::vector<uint32_t> fics;
+    std::vector<uint64_t> rowOffsets = {0};
+    std::vector<uint32_t> neighbours;
+    std::vector<uint32_t> counts;
+};
+
+void AppendRow(PartitionRows& rows, uint32_t fic, std::vector<std::pair<uint32_t, uint32_t>>& row, uint32_t topNeighbours)
+{
+    if(row.empty())
+        return;
+    // most lists first, then the lower fic id so that the result doesn't depend on the merge order
+    auto byCount = [](const std::pair<uint32_t, uint32_t>& left, const std::pair<uint32_t, uint32_t>& right){
+        return left.first != right.first ? left.first > right.first : left.second < right.second;
+    };
+    if(topNeighbours > 0 && row.size() > topNeighbours)
+    {
+        std::partial_sort(row.begin(), row.begin() + topNeighbours, row.end(), byCount);
+        row.resize(topNeighbours);
+    }
+    else
+        std::sort(row.begin(), row.end(), byCount);
+    rows.fics.push_back(fic);
+    for(const auto& [count, neighbour] : row)
+    {
+        rows.neighbours.push_back(neighbour);
+        rows.counts.push_back(count);
+    }
+    rows.rowOffsets.push_back(rows.neighbours.size());
+    row.clear();
+}
+
+PartitionRows MergePartition(const QStringList& runFiles, const FicCooccurrenceSettings& settings, std::atomic<bool>& failed)
+{
+    PartitionRows result;
+    std::vector<std::unique_ptr<RunReader>> readers;
+    auto laterKey = [&](size_t left, size_t right){return readers[left]->key > readers[right]->key;};
+    std::priority_queue<size_t, std::vector<size_t>, decltype(laterKey)> queue(laterKey);
+    for(const auto& fileName : runFiles)
+    {
+        readers.push_back(std::make_unique<RunReader>());
+        if(readers.back()->Open(fileName))
+            queue.push(readers.size() - 1);
+        else if(readers.back()->file.error() != QFileDevice::NoError)
+        {
+            qDebug() << "Could not read cooccurrence run: " << fileName;
+            failed = true;
+        }
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> row;
+    uint32_t currentRow = 0;
+    while(!queue.empty())
+    {
+        const uint64_t key = readers[queue.top()]->key;
+        uint32_t count = 0;
+        while(!queue.empty() && readers[queue.top()]->key == key)
+        {
+            const auto reader = queue.top();
+            queue.pop();
+            count += readers[reader]->count;
+            if(readers[reader]->Next())
+                queue.push(reader);
+        }
+        if(RowOf(key) != currentRow)
+        {
+            AppendRow(result, currentRow, row, settings.topNeighbours);
+            currentRow = RowOf(key);
+        }
+        if(count >= settings.minimumSupport)
+            row.push_back({count, NeighbourOf(key)});
+    }
+    AppendRow(result, currentRow, row, settings.topNeighbours);
+
+    readers.clear();
+    for(const auto& fileName : runFiles)
+        QFile::remove(fileName);
+    return result;
+}
+}
+
+uint32_t FicCooccurrenceMatrix::RowFor(uint32_t ficId) const
+{
+    auto it = std::lower_bound(fics.cbegin(), fics.cend(), ficId);
+    if(it == fics.cend() || *it != ficId)
+        return invalidRow;
+    return static_cast<uint32_t>(it - fics.cbegin());
+}
+
+bool FicCooccurrenceMatrix::Save(const QString& fileName) const
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qDebug() << "Could not save cooccurrence matrix: " << fileName;
+        return false;
+    }
+    QDataStream out(&file);
+    out.writeRawData(matrixMagic, sizeof(matrixMagic));
+    out << matrixVersion;
+    const bool written = WriteVector(out, fics) && WriteVector(out, listCounts) && WriteVector(out, rowOffsets)
+            && WriteVector(out, neighbours) && WriteVector(out, counts);
+    return written && out.status() == QDataStream::Ok;
+}
+
+bool FicCooccurrenceMatrix::Load(const QString& fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&file);
+    char magic[sizeof(matrixMagic)];
+    quint32 version = 0;
+    if(in.readRawData(magic, sizeof(magic)) != sizeof(magic) || std::memcmp(magic, matrixMagic, sizeof(magic)) != 0)
+        return false;
+    in >> version;
+    if(version != matrixVersion)
+        return false;
+    const bool loaded = ReadVector(in, fics) && ReadVector(in, listCounts) && ReadVector(in, rowOffsets)
+            && ReadVector(in, neighbours) && ReadVector(in, counts);
+    return loaded && rowOffsets.size() == fics.size() + 1 && neighbours.size() == counts.size();
+}
+
+FicCooccurrenceMatrix BuildFicCooccurrence(const QVector<ListWithIdentifier>& lists, const FicCooccurrenceSettings& settings)
+{
+    FicCooccurrenceMatrix result;
+    const uint32_t partitions = std::max(1u, settings.partitions);
+    const int threads = std::max(1, settings.threads);
+    QDir().mkpath(settings.workFolder);
+
+    std::unordered_map<uint32_t, uint32_t> listCounts;
+    for(const auto& list : lists)
+        for(auto fic : list.favourites)
+            listCounts[static_cast<uint32_t>(fic)]++;
+
+    // every thread spills its own runs, lists are dealt out round robin as they come sorted by size
+    std::atomic<bool> failed{false};
+    std::vector<std::vector<QStringList>> threadRuns(static_cast<size_t>(threads), std::vector<QStringList>(partitions));
+    auto countPairs = [&](int thread){
+        const size_t partitionCapacity = std::max<size_t>(1024, settings.bufferedPairs / partitions);
+        std::vector<std::vector<uint64_t>> buffers(partitions);
+        auto& runs = threadRuns[static_cast<size_t>(thread)];
+        auto spill = [&](uint32_t partition){
+            const auto fileName = QString("%1/p%2_t%3_r%4.run").arg(settings.workFolder).arg(partition).arg(thread).arg(runs[partition].size());
+            if(!SpillRun(buffers[partition], fileName))
+                failed = true;
+            runs[partition].push_back(fileName);
+        };
+        std::vector<uint32_t> fics;
+        for(int i = thread; i < lists.size() && !failed; i += threads)
+        {
+            fics.clear();
+            for(auto fic : lists[i].favourites)
+                fics.push_back(static_cast<uint32_t>(fic));
+            std::sort(fics.begin(), fics.end());
+            for(size_t first = 0; first < fics.size(); first++)
+            {
+                // every pair goes into the rows of both of its fics
+                const auto firstPartition = PartitionFor(fics[first], partitions);
+                for(size_t second = first + 1; second < fics.size(); second++)
+                {
+                    const auto secondPartition = PartitionFor(fics[second], partitions);
+                    buffers[firstPartition].push_back(PairKey(fics[first], fics[second]));
+                    buffers[secondPartition].push_back(PairKey(fics[second], fics[first]));
+                    if(buffers[firstPartition].size() >= partitionCapacity)
+                        spill(firstPartition);
+                    if(buffers[secondPartition].size() >= partitionCapacity)
+                        spill(secondPartition);
+                }
+            }
+        }
+        for(uint32_t partition = 0; partition < partitions; partition++)
+            if(!buffers[partition].empty())
+                spill(partition);
+    };
+    {
+        QVector<QFuture<void>> futures;
+        for(int thread = 0; thread < threads; thread++)
+            futures.push_back(QtConcurrent::run(countPairs, thread));
+        for(auto future: futures)
+            future.waitForFinished();
+    }
+    if(failed)
+        return result;
+
+    QVector<QFuture<PartitionRows>> futures;
+    for(uint32_t partition = 0; partition < partitions; partition++)
+    {
+        QStringList runFiles;
+        for(const auto& runs : threadRuns)
+            runFiles += runs[partition];
+        futures.push_back(QtConcurrent::run([runFiles, &settings, &failed](){
+            return MergePartition(runFiles, settings, failed);
+        }));
+    }
+    std::vector<PartitionRows> partitionRows;
+    partitionRows.reserve(partitions);
+    for(auto future: futures)
+    {
+        future.waitForFinished();
+        partitionRows.push_back(future.result());
+    }
+    if(failed)
+        return result;
+
+    // partitions are hash ranges, their rows are put back into the order of fic ids
+    std::vector<std::pair<uint32_t, uint32_t>> rowOrder;
+    size_t entries = 0;
+    for(uint32_t partition = 0; partition < partitions; partition++)
+    {
+        const auto& rows = partitionRows[partition];
+        for(uint32_t row = 0; row < rows.fics.size(); row++)
+            rowOrder.push_back({partition, row});
+        entries += rows.neighbours.size();
+    }
+    std::sort(rowOrder.begin(), rowOrder.end(), [&](const std::pair<uint32_t, uint32_t>& left, const std::pair<uint32_t, uint32_t>& right){
+        return partitionRows[left.first].fics[left.second] < partitionRows[right.first].fics[right.second];
+    });
+    result.fics.reserve(rowOrder.size());
+    result.listCounts.reserve(rowOrder.size());
+    result.rowOffsets.reserve(rowOrder.size() + 1);
+    result.neighbours.reserve(entries);
+    result.counts.reserve(entries);
+    result.rowOffsets.push_back(0);
+    for(const auto& [partition, row] : rowOrder)
+    {
+        const auto& rows = partitionRows[partition];
+        const auto fic = rows.fics[row];
+        result.fics.push_back(fic);
+        result.listCounts.push_back(listCounts[fic]);
+        const auto begin = static_cast<std::ptrdiff_t>(rows.rowOffsets[row]);
+        const auto end = static_cast<std::ptrdiff_t>(rows.rowOffsets[row + 1]);
+        result.neighbours.insert(result.neighbours.end(), rows.neighbours.begin() + begin, rows.neighbours.begin() + end);
+        result.counts.insert(result.counts.end(), rows.counts.begin() + begin, rows.counts.begin() + end);
+        result.rowOffsets.push_back(result.neighbours.size());
+    }
+    qDebug() << "Cooccurrence matrix rows: " << result.fics.size() << " entries: " << result.neighbours.size();
+    return result;
+}
+
+QList<FicWeightResult> FicRelationsFromMatrix(const FicCooccurrenceMatrix& matrix, const QHash<uint32_t, FicWeightPtr>& fics)
+{
+    QList<FicWeightResult> result;
+    result.reserve(static_cast<int>(matrix.neighbours.size()));
+    for(uint32_t row = 0; row < matrix.Size(); row++)
+    {
+        const auto fic1 = fics.value(matrix.fics[row]);
+        for(auto entry = matrix.rowOffsets[row]; entry < matrix.rowOffsets[row + 1]; entry++)
+        {
+            const auto neighbourRow = matrix.RowFor(matrix.neighbours[entry]);
+            FicWeightResult relation;
+            relation.ficId1 = static_cast<int>(matrix.fics[row]);
+            relation.ficId2 = static_cast<int>(matrix.neighbours[entry]);
+            relation.ficListCount1 = static_cast<int>(matrix.listCounts[row]);
+            relation.ficListCount2 = neighbourRow != FicCooccurrenceMatrix::invalidRow ? static_cast<int>(matrix.listCounts[neighbourRow]) : 0;
+            relation.meetingCount = static_cast<int>(matrix.counts[entry]);
+            const auto fic2 = fics.value(matrix.neighbours[entry]);
+            relation.sameFandom = false;
+            if(fic1 && fic2)
+                for(auto fandom : std::as_const(fic1->fandoms))
+                    relation.sameFandom = relation.sameFandom || fic2->fandoms.contains(fandom);
+            // share of the lists with the first fic that also have the second one
+            relation.attraction = static_cast<double>(relation.meetingCount)/static_cast<double>(relation.ficListCount1);
+            // nothing measures how often the fics avoid each other yet
+            relation.repulsion = 0;
+            relation.finalAttraction = relation.ficListCount2 > 0
+                    ? static_cast<double>(relation.meetingCount)/std::sqrt(static_cast<double>(relation.ficListCount1) * relation.ficListCount2)
+                    : 0;
+            result.push_back(relation);
+        }
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,93 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/data_code/fic_genre_vectors.h"
+
+#include <QDebug>
+
+namespace core{
+
+void FicGenreAccumulator::Finalize(int listSize, std::array<double, 22> &genreFactors, genre_stats::ListMoodData &moodData) const
+{
+    genreFactors = std::array<double, 22>{};
+    moodData.Clear();
+    if(listSize <= 0)
+        return;
+    for(int genre = 0; genre < genre_stats::g_count; genre++)
+        genreFactors[genre] = static_cast<double>(genreWeights[genre])/static_cast<double>(listSize);
+    for(int mood = genre_stats::gm_neutral; mood < genre_stats::gm_count; mood++)
+        moodData.AddMoodValue(static_cast<genre_stats::EGenreMood>(mood),
+                              static_cast<float>(moodCounts[mood])/static_cast<float>(listSize));
+}
+
+void FicGenreVectors::Build(const QHash<int, QList<genre_stats::GenreBit>> &composites)
+{
+    Clear();
+    ids.reserve(composites.size());
+    for(auto it = composites.cbegin(); it != composites.cend(); it++)
+        ids.push_back(static_cast<uint32_t>(it.key()));
+    std::sort(ids.begin(), ids.end());
+
+    const uint32_t size = static_cast<uint32_t>(ids.size());
+    rows.resize(size);
+    entries.reserve(size * 2);
+    const bool denseIds = size > 0 && ids.back() / 4 < size;
+    if(denseIds)
+        rowOfFic.assign(static_cast<size_t>(ids.back()) + 1, invalidRow);
+
+    std::array<float, genre_stats::g_count> weights;
+    for(uint32_t row = 0; row < size; row++)
+    {
+        if(denseIds)
+            rowOfFic[ids[row]] = row;
+        weights.fill(0.f);
+        uint32_t moodMask = 0;
+        for(const auto& genreBit : composites.value(static_cast<int>(ids[row])))
+        {
+            // statistics only ever count the genres the author of the fic has set
+            if(!genreBit.isInTheOriginal)
+                continue;
+            const float weight = genreBit.Weight();
+            for(int genre = 0; genre < genre_stats::g_count; genre++)
+                if(genreBit.genreMask & (1u << genre))
+                    weights[genre] += weight;
+            moodMask |= genre_stats::MoodMaskForGenres(genreBit.genreMask);
+        }
+        auto& ficRow = rows[row];
+        ficRow.firstEntry = static_cast<uint32_t>(entries.size());
+        ficRow.moodMask = static_cast<uint8_t>(moodMask);
+        for(int genre = 0; genre < genre_stats::g_count; genre++)
+        {
+            if(weights[genre] == 0.f)
+                continue;
+            entries.push_back({static_cast<uint8_t>(genre), weights[genre]});
+            ficRow.entryCount++;
+        }
+    }
+    entries.shrink_to_fit();
+    qDebug() << "built genre vectors for fics: " << size << " genre entries: " << entries.size();
+}
+
+void FicGenreVectors::Clear()
+{
+    ids.clear();
+    rows.clear();
+    entries.clear();
+    rowOfFic.clear();
+}
+
+}
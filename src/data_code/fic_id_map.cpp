@@ -0,0 +1,108 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/data_code/fic_id_map.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <numeric>
+
+namespace core{
+
+static int32_t Lookup(const std::vector<int32_t>& keys, const std::vector<int32_t>& values, int32_t key)
+{
+    auto it = std::lower_bound(keys.cbegin(), keys.cend(), key);
+    if(it == keys.cend() || *it != key)
+        return -1;
+    return values[static_cast<size_t>(it - keys.cbegin())];
+}
+
+void FicIdMap::Add(int32_t dbId, int32_t ffnId)
+{
+    if(!dbIds.empty() && dbId <= dbIds.back())
+    {
+        qDebug() << "skipping out of order fic in id map: " << dbId;
+        return;
+    }
+    dbIds.push_back(dbId);
+    ffnIdsByDbId.push_back(ffnId);
+}
+
+void FicIdMap::Finalize()
+{
+    std::vector<uint32_t> order(dbIds.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t left, uint32_t right){
+        return ffnIdsByDbId[left] < ffnIdsByDbId[right];
+    });
+    ffnIds.clear();
+    dbIdsByFfnId.clear();
+    ffnIds.reserve(order.size());
+    dbIdsByFfnId.reserve(order.size());
+    for(auto position : order)
+    {
+        // fics without ffn id can't be looked up from that side
+        if(ffnIdsByDbId[position] <= 0)
+            continue;
+        ffnIds.push_back(ffnIdsByDbId[position]);
+        dbIdsByFfnId.push_back(dbIds[position]);
+    }
+    dbIds.shrink_to_fit();
+    ffnIdsByDbId.shrink_to_fit();
+    qDebug() << "built fic id map for fics: " << dbIds.size();
+}
+
+void FicIdMap::Clear()
+{
+    dbIds.clear();
+    ffnIdsByDbId.clear();
+    ffnIds.clear();
+    dbIdsByFfnId.clear();
+}
+
+int32_t FicIdMap::DbIdFor(int32_t ffnId) const
+{
+    return Lookup(ffnIds, dbIdsByFfnId, ffnId);
+}
+
+int32_t FicIdMap::FfnIdFor(int32_t dbId) const
+{
+    return Lookup(dbIds, ffnIdsByDbId, dbId);
+}
+
+void FicIdMap::ConvertFFNToDB(QHash<int, int>& hash) const
+{
+    for(auto it = hash.begin(); it != hash.end();)
+    {
+        const auto dbId = DbIdFor(it.key());
+        if(dbId == -1)
+            it = hash.erase(it);
+        else
+        {
+            it.value() = dbId;
+            ++it;
+        }
+    }
+}
+
+void FicIdMap::ConvertDBToFFN(QHash<int, int>& hash) const
+{
+    for(auto it = hash.begin(); it != hash.end(); ++it)
+        it.value() = FfnIdFor(it.key());
+}
+
+}
@@ -0,0 +1,187 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/data_code/fic_search_index.h"
+#include "include/data_code/fic_store.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+namespace core{
+
+static std::vector<int32_t> MonthlyDayBounds(){
+    std::vector<int32_t> result{std::numeric_limits<int32_t>::min()};
+    const int lastYear = QDate::currentDate().year() + 2;
+    for(int year = 1998; year <= lastYear; year++)
+        for(int month = 1; month <= 12; month++)
+            result.push_back(static_cast<int32_t>(QDate(year, month, 1).toJulianDay()));
+    return result;
+}
+
+void FicRangeIndex::Init(std::vector<int32_t>&& newBounds)
+{
+    bounds = std::move(newBounds);
+    if(bounds.empty() || bounds.front() != std::numeric_limits<int32_t>::min())
+        bounds.insert(bounds.begin(), std::numeric_limits<int32_t>::min());
+    buckets.clear();
+    buckets.resize(bounds.size());
+}
+
+void FicRangeIndex::Add(uint32_t ficId, int32_t value)
+{
+    auto bucket = std::upper_bound(bounds.cbegin(), bounds.cend(), value) - bounds.cbegin() - 1;
+    buckets[static_cast<size_t>(std::max<std::ptrdiff_t>(0, bucket))].add(ficId);
+}
+
+void FicRangeIndex::Optimize()
+{
+    for(auto& bucket : buckets)
+    {
+        bucket.runOptimize();
+        bucket.shrinkToFit();
+    }
+}
+
+Roaring FicRangeIndex::Select(int32_t minValue, int32_t maxValue,
+                              const std::vector<uint32_t>& ids,
+                              const std::vector<int32_t>& column) const
+{
+    Roaring result;
+    if(minValue > maxValue)
+        return result;
+    std::vector<const Roaring*> fullBuckets;
+    for(size_t i = 0; i < buckets.size(); i++)
+    {
+        const int64_t low = bounds[i];
+        const int64_t high = i + 1 < bounds.size() ? static_cast<int64_t>(bounds[i + 1]) - 1 : std::numeric_limits<int32_t>::max();
+        if(high < minValue || low > maxValue)
+            continue;
+        if(low >= minValue && high <= maxValue)
+        {
+            fullBuckets.push_back(&buckets[i]);
+            continue;
+        }
+        // partially covered bucket, ids come in ascending order so the ordinal search only moves forward
+        auto position = ids.cbegin();
+        for(auto ficId : buckets[i])
+        {
+            position = std::lower_bound(position, ids.cend(), ficId);
+            if(position == ids.cend())
+                break;
+            const auto value = column[static_cast<size_t>(position - ids.cbegin())];
+            if(value >= minValue && value <= maxValue)
+                result.add(ficId);
+        }
+    }
+    if(!fullBuckets.empty())
+        result |= Roaring::fastunion(fullBuckets.size(), fullBuckets.data());
+    return result;
+}
+
+void FicSearchIndex::Add(const FicSearchRecord &record)
+{
+    if(record.id < 0 || (!ids.empty() && static_cast<uint32_t>(record.id) <= ids.back()))
+    {
+        qDebug() << "skipping out of order fic in search index: " << record.id;
+        return;
+    }
+    if(wordCountRanges.buckets.empty())
+    {
+        wordCountRanges.Init({0, 1000, 5000, 10000, 20000, 50000, 100000, 200000, 400000, 1000000});
+        favouritesRanges.Init({0, 10, 50, 100, 150, 300, 500, 1000, 3000, 10000});
+        publishedRanges.Init(MonthlyDayBounds());
+        updatedRanges.Init(MonthlyDayBounds());
+    }
+    const auto id = static_cast<uint32_t>(record.id);
+    ids.push_back(id);
+    wordCount.push_back(record.wordCount);
+    favourites.push_back(record.favourites);
+    reviews.push_back(record.reviews);
+    published.push_back(FicStore::DayNumber(record.published));
+    updated.push_back(FicStore::DayNumber(record.updated));
+
+    all.add(id);
+    if(record.complete)
+        complete.add(id);
+    if(record.ratedM)
+        ratedM.add(id);
+    if(record.keywordsResult)
+        slashKeywords.add(id);
+    if(record.filterPass1)
+        slashPass1.add(id);
+    if(record.filterPass2)
+        slashPass2.add(id);
+    if(record.genreString == QStringLiteral("not found"))
+        noGenre.add(id);
+
+    // same notion of a crossover as cfInIgnoredFandoms uses
+    if(record.fandom2 == -1)
+        pureFandomFics[record.fandom1].add(id);
+    else
+    {
+        crossovers.add(id);
+        crossoverFandomFics[record.fandom1].add(id);
+        crossoverFandomFics[record.fandom2].add(id);
+    }
+
+    const auto genreMask = FicStore::GenreMaskFromString(record.genreString);
+    for(size_t genre = 0; genre < genres.size(); genre++)
+        if(genreMask & (1u << genre))
+            genres[genre].add(id);
+
+    wordCountRanges.Add(id, record.wordCount);
+    favouritesRanges.Add(id, record.favourites);
+    publishedRanges.Add(id, published.back());
+    updatedRanges.Add(id, updated.back());
+}
+
+void FicSearchIndex::Finalize()
+{
+    auto optimize = [](Roaring& bitmap){
+        bitmap.runOptimize();
+        bitmap.shrinkToFit();
+    };
+    for(auto* bitmap : {&all, &complete, &ratedM, &noGenre, &crossovers, &slashKeywords, &slashPass1, &slashPass2})
+        optimize(*bitmap);
+    for(auto& bitmap : pureFandomFics)
+        optimize(bitmap);
+    for(auto& bitmap : crossoverFandomFics)
+        optimize(bitmap);
+    for(auto& bitmap : genres)
+        optimize(bitmap);
+    wordCountRanges.Optimize();
+    favouritesRanges.Optimize();
+    publishedRanges.Optimize();
+    updatedRanges.Optimize();
+    qDebug() << "search index finalized for fics: " << ids.size() << " fandoms: " << pureFandomFics.size();
+}
+
+uint32_t FicSearchIndex::OrdinalFor(uint32_t ficId, uint32_t searchFrom) const
+{
+    auto it = std::lower_bound(ids.cbegin() + std::min<size_t>(searchFrom, ids.size()), ids.cend(), ficId);
+    if(it == ids.cend() || *it != ficId)
+        return FicStore::invalidOrdinal;
+    return static_cast<uint32_t>(it - ids.cbegin());
+}
+
+Roaring FicSearchIndex::FandomFics(int fandom) const
+{
+    return pureFandomFics.value(fandom) | crossoverFandomFics.value(fandom);
+}
+
+}
@@ -0,0 +1,137 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/data_code/fic_store.h"
+
+#include <QDebug>
+#include <algorithm>
+
+namespace core{
+
+uint32_t FicStore::GenreMaskFromString(const QString &genreString)
+{
+    return genre_stats::GenreMaskFromString(genreString);
+}
+
+QString FicStore::GenreStringFromMask(uint32_t mask)
+{
+    QStringList result;
+    for(int genre = 0; genre < genre_stats::g_count; genre++)
+        if(mask & genre_stats::GenreMask(static_cast<genre_stats::EGenre>(genre)))
+            result.push_back(QString::fromLatin1(genre_stats::genreNames[genre]));
+    return result.join(QStringLiteral("/"));
+}
+
+FicWeightPtr FicStore::Materialize(uint32_t ordinal) const
+{
+    FicWeightPtr fic(new FanficDataForRecommendationCreation);
+    fic->id = static_cast<int>(ids[ordinal]);
+    fic->fandoms.push_back(fandom1[ordinal]);
+    fic->fandoms.push_back(fandom2[ordinal]);
+    fic->genreMask = genres[ordinal];
+    fic->genreString = GenreStringFromMask(genres[ordinal]);
+    fic->favCount = favCount[ordinal];
+    fic->wordCount = wordCount[ordinal];
+    fic->reviewCount = reviewCount[ordinal];
+    fic->authorId = authorId[ordinal];
+    fic->chapterCount = chapterCount[ordinal];
+    fic->complete = HasFlag(ordinal, ff_complete);
+    fic->slash = HasFlag(ordinal, ff_slash);
+    fic->dead = HasFlag(ordinal, ff_dead);
+    fic->sameLanguage = HasFlag(ordinal, ff_same_language);
+    fic->adult = HasFlag(ordinal, ff_adult);
+    fic->published = Published(ordinal);
+    fic->updated = Updated(ordinal);
+    return fic;
+}
+
+void FicStore::Build(const QHash<int, FicWeightPtr>& fics)
+{
+    Clear();
+    std::vector<uint32_t> sortedIds;
+    sortedIds.reserve(fics.size());
+    for(auto it = fics.cbegin(); it != fics.cend(); it++)
+        if(it.value())
+            sortedIds.push_back(static_cast<uint32_t>(it.key()));
+    std::sort(sortedIds.begin(), sortedIds.end());
+
+    const auto size = sortedIds.size();
+    ids = std::move(sortedIds);
+    fandom1.resize(size);
+    fandom2.resize(size);
+    genres.resize(size);
+    favCount.resize(size);
+    wordCount.resize(size);
+    reviewCount.resize(size);
+    authorId.resize(size);
+    chapterCount.resize(size);
+    flags.resize(size);
+    published.resize(size);
+    updated.resize(size);
+    const bool denseIds = size > 0 && ids.back() / 4 < size;
+    if(denseIds)
+        ordinals.assign(static_cast<size_t>(ids.back()) + 1, invalidOrdinal);
+
+    for(uint32_t ordinal = 0; ordinal < size; ordinal++)
+    {
+        const auto& fic = *fics.value(static_cast<int>(ids[ordinal]));
+        if(denseIds)
+            ordinals[ids[ordinal]] = ordinal;
+        fandom1[ordinal] = fic.fandoms.size() > 0 ? fic.fandoms.at(0) : -1;
+        fandom2[ordinal] = fic.fandoms.size() > 1 ? fic.fandoms.at(1) : -1;
+        genres[ordinal] = fic.genreMask;
+        favCount[ordinal] = fic.favCount;
+        wordCount[ordinal] = fic.wordCount;
+        reviewCount[ordinal] = fic.reviewCount;
+        authorId[ordinal] = fic.authorId;
+        chapterCount[ordinal] = static_cast<uint16_t>(std::clamp(fic.chapterCount, 0, static_cast<int>(std::numeric_limits<uint16_t>::max())));
+        uint8_t ficFlags = 0;
+        if(fic.complete)
+            ficFlags |= ff_complete;
+        if(fic.slash)
+            ficFlags |= ff_slash;
+        if(fic.dead)
+            ficFlags |= ff_dead;
+        if(fic.sameLanguage)
+            ficFlags |= ff_same_language;
+        if(fic.adult)
+            ficFlags |= ff_adult;
+        flags[ordinal] = ficFlags;
+        published[ordinal] = DayNumber(fic.published);
+        updated[ordinal] = DayNumber(fic.updated);
+    }
+    qDebug() << "built fic store of size: " << size;
+}
+
+void FicStore::Clear()
+{
+    ids.clear();
+    fandom1.clear();
+    fandom2.clear();
+    genres.clear();
+    favCount.clear();
+    wordCount.clear();
+    reviewCount.clear();
+    authorId.clear();
+    chapterCount.clear();
+    flags.clear();
+    published.clear();
+    updated.clear();
+    ordinals.clear();
+}
+
+}
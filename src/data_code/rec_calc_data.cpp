@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 
 #include <QSettings>
 #include <QFileInfo>
+#include <QDebug>
 
 
 
@@ -28,14 +29,27 @@ auto lambda = [](DataHolder* holder, QString storageFolder, QString fileBase, au
     holder->CreateTempDataDir(storageFolder);
     QSettings settings(holder->settingsFile, QSettings::IniFormat);
     QFileInfo fi;
-    if(settings.value("Settings/usestoreddata", true).toBool() && fi.exists(storageFolder + "/" + fileBase + "_0.txt"))
+    const bool useStoredData = settings.value("Settings/usestoreddata", true).toBool();
+    if(useStoredData && thread_boost::snapshot::SnapshotExists(storageFolder, fileBase)
+            && thread_boost::LoadSnapshot(storageFolder, fileBase, data))
+    {
+        holder->dataVersion++;
+        return;
+    }
+
+    if(useStoredData && fi.exists(storageFolder + "/" + fileBase + "_0.txt"))
+    {
         thread_boost::LoadData(storageFolder, fileBase, data);
+        // converting data stored by an older version so that next start reads the snapshot
+        thread_boost::SaveSnapshot(storageFolder, fileBase, data);
+    }
     else
     {
         auto& item = data;
         item = loadFunc(interface);
         saveFunc(storageFolder);
     }
+    holder->dataVersion++;
 };
 
 #define DISPATCH(X) \
@@ -46,10 +60,144 @@ auto lambda = [](DataHolder* holder, QString storageFolder, QString fileBase, au
     std::bind(&DataHolder::SaveData<X>, this, std::placeholders::_1));\
 }
 
-DISPATCH(rdt_favourites)
-DISPATCH(rdt_fics)
+template <>
+void DataHolder::LoadData<rdt_favourites>(QString storageFolder){
+    auto[data, interface] = get<rdt_favourites>();
+    lambda(this,storageFolder, QString::fromStdString(DataHolderInfo<rdt_favourites>::fileBase()), data.get(),interface, DataHolderInfo<rdt_favourites>::loadFunc(),
+    std::bind(&DataHolder::SaveData<rdt_favourites>, this, std::placeholders::_1));
+    BuildFicRecommendersIndex();
+    BuildAuthorOrdinals();
+    BuildRecommenderSketches();
+    BuildAuthorMoodMatrix();
+}
+
+void DataHolder::BuildFicRecommendersIndex()
+{
+    recommendersForFics.clear();
+    for(auto i = faves.cbegin(); i != faves.cend(); i++)
+    {
+        const uint32_t author = static_cast<uint32_t>(i.key());
+        for(auto fic : i.value())
+            recommendersForFics[fic].add(author);
+    }
+    for(auto& recommenders : recommendersForFics)
+    {
+        recommenders.runOptimize();
+        recommenders.shrinkToFit();
+    }
+    qDebug() << "built recommender index for fics: " << recommendersForFics.size();
+}
+
+void DataHolder::BuildAuthorOrdinals()
+{
+    authorOrdinals.Build(faves);
+    authorTables.SetOrdinals(&authorOrdinals);
+    qDebug() << "built ordinals for authors: " << authorOrdinals.Size();
+}
+
+void DataHolder::BuildRecommenderSketches()
+{
+    recommenderSketches.Build(authorOrdinals);
+}
+
+template <>
+void DataHolder::LoadData<rdt_fics>(QString storageFolder){
+    auto[data, interface] = get<rdt_fics>();
+    lambda(this,storageFolder, QString::fromStdString(DataHolderInfo<rdt_fics>::fileBase()), data.get(),interface, DataHolderInfo<rdt_fics>::loadFunc(),
+    std::bind(&DataHolder::SaveData<rdt_fics>, this, std::placeholders::_1));
+    BuildFicStore();
+}
+
+void DataHolder::BuildFicStore()
+{
+    ficStore.Build(fics);
+    fics.clear();
+    fics.squeeze();
+}
+
+template <>
+void DataHolder::LoadData<rdt_fic_genres_composite>(QString storageFolder){
+    auto[data, interface] = get<rdt_fic_genres_composite>();
+    lambda(this,storageFolder, QString::fromStdString(DataHolderInfo<rdt_fic_genres_composite>::fileBase()), data.get(),interface, DataHolderInfo<rdt_fic_genres_composite>::loadFunc(),
+    std::bind(&DataHolder::SaveData<rdt_fic_genres_composite>, this, std::placeholders::_1));
+    BuildGenreVectors();
+}
+
+template <>
+void DataHolder::LoadData<rdt_author_mood_distribution>(QString storageFolder){
+    auto[data, interface] = get<rdt_author_mood_distribution>();
+    lambda(this,storageFolder, QString::fromStdString(DataHolderInfo<rdt_author_mood_distribution>::fileBase()), data.get(),interface, DataHolderInfo<rdt_author_mood_distribution>::loadFunc(),
+    std::bind(&DataHolder::SaveData<rdt_author_mood_distribution>, this, std::placeholders::_1));
+    BuildAuthorMoodMatrix();
+}
+
+void DataHolder::BuildAuthorMoodMatrix()
+{
+    authorMoods.Build(authorMoodDistributions, authorOrdinals);
+}
+
+void DataHolder::BuildGenreVectors()
+{
+    genreVectors.Build(genreComposites);
+}
+
+void DataHolder::LoadFicIdMap()
+{
+    ficIds.Clear();
+    fanficsInterface->ProcessFicIdPairs([&](int dbId, int ffnId){
+        ficIds.Add(dbId, ffnId);
+    });
+    ficIds.Finalize();
+    dataVersion++;
+}
+
+QHash<uint32_t, FicWeightPtr> DataHolder::FicsForFFNIds(const QSet<int>& ffnIds, QList<int>& missingDbIds) const
+{
+    QHash<uint32_t, FicWeightPtr> result;
+    result.reserve(ffnIds.size());
+    for(auto ffnId : ffnIds)
+    {
+        const auto dbId = ficIds.DbIdFor(ffnId);
+        // not in the database either
+        if(dbId == -1)
+            continue;
+        const auto ordinal = ficStore.OrdinalFor(static_cast<uint32_t>(dbId));
+        if(ordinal == FicStore::invalidOrdinal)
+        {
+            missingDbIds.push_back(dbId);
+            continue;
+        }
+        result.insert(static_cast<uint32_t>(dbId), ficStore.Materialize(ordinal));
+    }
+    return result;
+}
+
+uint64_t DataHolder::FavouritesFingerprint() const
+{
+    // every value is mixed in order, both tables are sorted by id so the order is stable between runs
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](uint64_t value){
+        hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+        hash *= 1099511628211ull;
+    };
+    add(authorOrdinals.Size());
+    for(uint32_t ordinal = 0; ordinal < authorOrdinals.Size(); ordinal++)
+    {
+        const auto& favourites = *authorOrdinals.favourites[ordinal];
+        add(static_cast<uint32_t>(authorOrdinals.ids[ordinal]));
+        add(favourites.cardinality());
+        for(auto fic : favourites)
+            add(fic);
+    }
+    add(ficStore.Size());
+    for(uint32_t ordinal = 0; ordinal < ficStore.Size(); ordinal++)
+    {
+        add(ficStore.ids[ordinal]);
+        add(static_cast<uint32_t>(ficStore.favCount[ordinal]));
+    }
+    return hash;
+}
+
 DISPATCH(rdt_author_genre_distribution)
-DISPATCH(rdt_author_mood_distribution)
-DISPATCH(rdt_fic_genres_composite)
 
 }
@@ -0,0 +1,164 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/data_code/recommender_neighbours.h"
+#include "include/data_code/vector_io.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QDataStream>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+namespace core{
+
+namespace {
+constexpr char tableMagic[4] = {'R', 'N', 'B', 'R'};
+constexpr quint32 tableVersion = 1;
+
+struct Neighbour{
+    float similarity = 0;
+    int32_t recommender = 0;
+};
+}
+
+QList<int> RecommenderNeighbourTable::NeighboursFor(int recommender) const
+{
+    QList<int> result;
+    auto it = std::lower_bound(recommenders.cbegin(), recommenders.cend(), recommender);
+    if(it == recommenders.cend() || *it != recommender)
+        return result;
+    const auto row = static_cast<size_t>(it - recommenders.cbegin());
+    for(auto i = rowOffsets[row]; i < rowOffsets[row + 1]; i++)
+        result.push_back(neighbours[i]);
+    return result;
+}
+
+bool RecommenderNeighbourTable::Save(const QString& fileName) const
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qDebug() << "Could not save recommender neighbours: " << fileName;
+        return false;
+    }
+    QDataStream out(&file);
+    out.writeRawData(tableMagic, sizeof(tableMagic));
+    out << tableVersion;
+    const bool written = WriteVector(out, recommenders) && WriteVector(out, rowOffsets)
+            && WriteVector(out, neighbours) && WriteVector(out, similarities);
+    return written && out.status() == QDataStream::Ok;
+}
+
+bool RecommenderNeighbourTable::Load(const QString& fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&file);
+    char magic[sizeof(tableMagic)];
+    quint32 version = 0;
+    if(in.readRawData(magic, sizeof(magic)) != sizeof(magic) || std::memcmp(magic, tableMagic, sizeof(magic)) != 0)
+        return false;
+    in >> version;
+    if(version != tableVersion)
+        return false;
+    const bool loaded = ReadVector(in, recommenders) && ReadVector(in, rowOffsets)
+            && ReadVector(in, neighbours) && ReadVector(in, similarities);
+    return loaded && rowOffsets.size() == recommenders.size() + 1 && neighbours.size() == similarities.size()
+            && rowOffsets.back() == neighbours.size();
+}
+
+RecommenderNeighbourTable BuildRecommenderNeighbours(const AuthorOrdinals& authorOrdinals,
+                                                     const RecommenderSketches& sketches,
+                                                     const RecommenderNeighboursSettings& settings)
+{
+    RecommenderNeighbourTable result;
+    const auto authorCount = authorOrdinals.Size();
+    std::vector<std::vector<Neighbour>> rows(authorCount);
+    std::atomic<uint32_t> nextOrdinal{0};
+    std::atomic<uint32_t> processed{0};
+
+    // recommenders are taken one at a time as list sizes are very uneven
+    auto worker = [&](){
+        for(uint32_t ordinal = nextOrdinal++; ordinal < authorCount; ordinal = nextOrdinal++)
+        {
+            const Roaring& favourites = *authorOrdinals.favourites[ordinal];
+            const auto size = favourites.cardinality();
+            if(size < settings.minimumListSize)
+                continue;
+            auto& row = rows[ordinal];
+            const auto candidates = sketches.Candidates(favourites, settings.sketchContainment, authorOrdinals);
+            for(auto candidate : candidates)
+            {
+                const auto candidateOrdinal = authorOrdinals.OrdinalFor(candidate);
+                if(candidateOrdinal == ordinal || candidateOrdinal == AuthorOrdinals::invalidOrdinal)
+                    continue;
+                const Roaring& candidateFavourites = *authorOrdinals.favourites[candidateOrdinal];
+                const auto candidateSize = candidateFavourites.cardinality();
+                if(candidateSize < settings.minimumListSize)
+                    continue;
+                const auto matches = favourites.and_cardinality(candidateFavourites);
+                if(matches < settings.minimumMatches)
+                    continue;
+                const auto similarity = static_cast<float>(matches / std::sqrt(static_cast<double>(size) * static_cast<double>(candidateSize)));
+                row.push_back({similarity, candidate});
+            }
+            auto moreSimilar = [](const Neighbour& left, const Neighbour& right){
+                if(left.similarity != right.similarity)
+                    return left.similarity > right.similarity;
+                return left.recommender < right.recommender;
+            };
+            if(row.size() > settings.neighbours)
+            {
+                std::nth_element(row.begin(), row.begin() + settings.neighbours, row.end(), moreSimilar);
+                row.resize(settings.neighbours);
+            }
+            std::sort(row.begin(), row.end(), moreSimilar);
+            row.shrink_to_fit();
+            const auto done = ++processed;
+            if(done % 10000 == 0)
+                qDebug() << "recommenders with neighbours processed: " << done;
+        }
+    };
+    QVector<QFuture<void>> futures;
+    for(int i = 0; i < std::max(1, settings.threads); i++)
+        futures.push_back(QtConcurrent::run(worker));
+    for(auto& future : futures)
+        future.waitForFinished();
+
+    result.rowOffsets.push_back(0);
+    for(uint32_t ordinal = 0; ordinal < authorCount; ordinal++)
+    {
+        if(rows[ordinal].empty())
+            continue;
+        result.recommenders.push_back(authorOrdinals.ids[ordinal]);
+        for(const auto& neighbour : rows[ordinal])
+        {
+            result.neighbours.push_back(neighbour.recommender);
+            result.similarities.push_back(neighbour.similarity);
+        }
+        result.rowOffsets.push_back(result.neighbours.size());
+    }
+    qDebug() << "built neighbours for recommenders: " << result.Size() << " entries: " << result.neighbours.size();
+    return result;
+}
+
+}
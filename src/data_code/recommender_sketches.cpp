@@ -0,0 +1,132 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/data_code/recommender_sketches.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace core{
+
+namespace {
+// splitmix64 finalizer, fic ids are dense so they need to be scattered before binning
+uint64_t HashFic(uint32_t fic){
+    uint64_t value = fic + 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+}
+
+void RecommenderSketches::Build(const AuthorOrdinals& authorOrdinals)
+{
+    Clear();
+    const auto authorCount = authorOrdinals.Size();
+    sampleSizes.resize(authorCount);
+    // sampled fic in the high half so that sorting groups the recommenders by fic
+    std::vector<uint64_t> pairs;
+    pairs.reserve(static_cast<size_t>(authorCount) * 8);
+
+    constexpr uint64_t emptyBin = std::numeric_limits<uint64_t>::max();
+    std::array<uint64_t, sketchSize> binHashes;
+    std::array<uint32_t, sketchSize> binFics;
+    for(uint32_t ordinal = 0; ordinal < authorCount; ordinal++)
+    {
+        binHashes.fill(emptyBin);
+        for(auto fic : *authorOrdinals.favourites[ordinal])
+        {
+            const auto hash = HashFic(fic);
+            const auto bin = static_cast<size_t>(hash >> (64 - binBits));
+            if(hash < binHashes[bin])
+            {
+                binHashes[bin] = hash;
+                binFics[bin] = fic;
+            }
+        }
+        uint8_t sampled = 0;
+        for(size_t bin = 0; bin < sketchSize; bin++)
+        {
+            if(binHashes[bin] == emptyBin)
+                continue;
+            pairs.push_back((static_cast<uint64_t>(binFics[bin]) << 32) | ordinal);
+            sampled++;
+        }
+        sampleSizes[ordinal] = sampled;
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+    recommenders.reserve(pairs.size());
+    for(auto pair : pairs)
+    {
+        const auto fic = static_cast<uint32_t>(pair >> 32);
+        if(fics.empty() || fics.back() != fic)
+        {
+            fics.push_back(fic);
+            offsets.push_back(recommenders.size());
+        }
+        recommenders.push_back(static_cast<uint32_t>(pair));
+    }
+    offsets.push_back(recommenders.size());
+    qDebug() << "built recommender sketches for authors: " << authorCount << " sampled fics: " << fics.size();
+}
+
+void RecommenderSketches::Clear()
+{
+    sampleSizes.clear();
+    fics.clear();
+    offsets.clear();
+    recommenders.clear();
+}
+
+QList<int> RecommenderSketches::Candidates(const Roaring& fics, double minimumContainment, const AuthorOrdinals& authorOrdinals) const
+{
+    QList<int> result;
+    if(IsEmpty() || sampleSizes.size() != authorOrdinals.Size())
+        return result;
+
+    std::vector<uint8_t> hits(sampleSizes.size(), 0);
+    std::vector<uint32_t> touched;
+    // the list is iterated in ascending order so every lookup starts where the previous one stopped
+    auto searchFrom = this->fics.cbegin();
+    for(auto fic : fics)
+    {
+        searchFrom = std::lower_bound(searchFrom, this->fics.cend(), fic);
+        if(searchFrom == this->fics.cend())
+            break;
+        if(*searchFrom != fic)
+            continue;
+        const auto position = static_cast<size_t>(searchFrom - this->fics.cbegin());
+        for(auto i = offsets[position]; i < offsets[position + 1]; i++)
+        {
+            const auto ordinal = recommenders[i];
+            if(hits[ordinal]++ == 0)
+                touched.push_back(ordinal);
+        }
+    }
+
+    // ordinals follow the ascending author ids
+    std::sort(touched.begin(), touched.end());
+    result.reserve(static_cast<int>(touched.size()));
+    for(auto ordinal : touched)
+        if(hits[ordinal] >= minimumContainment * sampleSizes[ordinal])
+            result.push_back(authorOrdinals.ids[ordinal]);
+    return result;
+}
+
+}
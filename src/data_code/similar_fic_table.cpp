@@ -0,0 +1,168 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/data_code/similar_fic_table.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace core{
+
+namespace {
+constexpr char tableMagic[4] = {'S', 'I', 'M', 'F'};
+constexpr uint32_t tableVersion = 2;
+
+struct TableHeader{
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t neighboursPerFic = 0;
+    uint32_t rowCount = 0;
+    uint64_t entryCount = 0;
+    // DataHolder::FavouritesFingerprint of the data the table was built from
+    uint64_t fingerprint = 0;
+};
+static_assert(sizeof(TableHeader) == 32, "similar fic table header must not be padded");
+}
+
+SimilarFicTable::~SimilarFicTable()
+{
+    Close();
+}
+
+bool SimilarFicTable::Open(const QString& fileName, uint64_t expectedFingerprint)
+{
+    Close();
+    file.setFileName(fileName);
+    if(!file.open(QFile::ReadOnly))
+        return false;
+    const auto fileSize = static_cast<uint64_t>(file.size());
+    if(fileSize < sizeof(TableHeader))
+    {
+        qDebug() << "Similar fic table is truncated: " << fileName;
+        Close();
+        return false;
+    }
+    mapped = file.map(0, file.size());
+    if(!mapped)
+    {
+        qDebug() << "Could not map similar fic table: " << fileName;
+        Close();
+        return false;
+    }
+    TableHeader header;
+    std::memcpy(&header, mapped, sizeof(header));
+    const uint64_t expectedSize = sizeof(TableHeader)
+            + sizeof(SimilarFicRow) * static_cast<uint64_t>(header.rowCount)
+            + sizeof(SimilarFicEntry) * header.entryCount;
+    if(std::memcmp(header.magic, tableMagic, sizeof(header.magic)) != 0
+            || header.version != tableVersion
+            || expectedSize != fileSize)
+    {
+        qDebug() << "Similar fic table has unsupported format: " << fileName << " version: " << header.version;
+        Close();
+        return false;
+    }
+    if(header.fingerprint != expectedFingerprint)
+    {
+        qDebug() << "Similar fic table was built from different data: " << fileName;
+        Close();
+        return false;
+    }
+    rows = reinterpret_cast<const SimilarFicRow*>(mapped + sizeof(TableHeader));
+    entries = reinterpret_cast<const SimilarFicEntry*>(mapped + sizeof(TableHeader) + sizeof(SimilarFicRow) * header.rowCount);
+    rowCount = header.rowCount;
+    neighboursPerFic = header.neighboursPerFic;
+    for(uint32_t i = 0; i < rowCount; i++)
+    {
+        if(static_cast<uint64_t>(rows[i].firstEntry) + rows[i].entryCount > header.entryCount)
+        {
+            qDebug() << "Similar fic table has a row outside of its entries: " << fileName;
+            Close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void SimilarFicTable::Close()
+{
+    if(mapped)
+        file.unmap(mapped);
+    if(file.isOpen())
+        file.close();
+    mapped = nullptr;
+    rows = nullptr;
+    entries = nullptr;
+    rowCount = 0;
+    neighboursPerFic = 0;
+}
+
+const SimilarFicRow* SimilarFicTable::RowFor(uint32_t ficId) const
+{
+    if(!rows)
+        return nullptr;
+    auto it = std::lower_bound(rows, rows + rowCount, ficId, [](const SimilarFicRow& row, uint32_t id){
+        return row.ficId < id;
+    });
+    if(it == rows + rowCount || it->ficId != ficId)
+        return nullptr;
+    return it;
+}
+
+bool SimilarFicTable::Save(const QString& fileName, uint32_t neighboursPerFic, uint64_t fingerprint,
+                           const std::vector<SimilarFicRow>& rows, const std::vector<SimilarFicEntry>& entries)
+{
+    const QString tempFileName = fileName + QString(".tmp");
+    QFile file(tempFileName);
+    if(!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        qDebug() << "Could not open file: " << tempFileName;
+        return false;
+    }
+    TableHeader header;
+    std::memcpy(header.magic, tableMagic, sizeof(header.magic));
+    header.version = tableVersion;
+    header.neighboursPerFic = neighboursPerFic;
+    header.rowCount = static_cast<uint32_t>(rows.size());
+    header.entryCount = static_cast<uint64_t>(entries.size());
+    header.fingerprint = fingerprint;
+
+    const auto rowBytes = static_cast<qint64>(sizeof(SimilarFicRow) * rows.size());
+    const auto entryBytes = static_cast<qint64>(sizeof(SimilarFicEntry) * entries.size());
+    const bool written = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header)
+            && file.write(reinterpret_cast<const char*>(rows.data()), rowBytes) == rowBytes
+            && file.write(reinterpret_cast<const char*>(entries.data()), entryBytes) == entryBytes;
+    file.close();
+    if(!written)
+    {
+        qDebug() << "Failed writing similar fic table: " << tempFileName;
+        QFile::remove(tempFileName);
+        return false;
+    }
+
+    QFile::remove(fileName);
+    if(!QFile::rename(tempFileName, fileName))
+    {
+        qDebug() << "Could not move similar fic table into place: " << fileName;
+        return false;
+    }
+    qDebug() << "Saved similar fic table: " << fileName << " fics: " << header.rowCount << " entries: " << header.entryCount;
+    return true;
+}
+
+}
@@ -53,30 +53,20 @@ static std::function<bool(QString)> pageVerifier = [](QString page)->bool{
     return page.contains("Favs:", Qt::CaseInsensitive);
 };
 
+// the server answers these from its precomputed similar fic table
+// so nothing but the name and the source fic should be changed here
 QSharedPointer<core::RecommendationList> CreateSimilarFicParams()
 {
-    QSharedPointer<core::RecommendationList> list(new core::RecommendationList);
-    list->minimumMatch = 1;
-    list->isAutomatic = false;
-    list->useWeighting = false;
-    list->alwaysPickAt = 9999;
-    list->useMoodAdjustment = false;
+    auto list = core::RecommendationList::NewSimilarFicList();
     list->name = QStringLiteral("Recommendations");
     list->assignLikedToSources = true;
-    list->userFFNId = -1;
     return list;
 }
 
 
 
 QSharedPointer<core::RecommendationList>  FillRecommendationsForSingularFic(QSharedPointer<TaskEnvironment> environment, QString ficId){
-    QSharedPointer<core::RecommendationList> listParams;
-    //QString error;
-
     auto recList = CreateSimilarFicParams();
-    recList->ignoreBreakdowns= true;
-    recList->isAutomatic = true;
-    recList->listSizeMultiplier = 20000;
 
     QVector<core::Identity> pack;
     pack.resize(1);
@@ -90,7 +80,6 @@ QSharedPointer<core::RecommendationList>  FillRecommendationsForSingularFic(QSha
         recList->ficData->fics+=source.web.ffn;
         recList->ficData->sourceFicsFFN+=source.web.ffn;
     }
-    recList->resultLimit = 90;
     environment->ficSource->GetRecommendationListFromServer(recList);
     return recList;
 }
@@ -1529,13 +1518,6 @@ QSharedPointer<SendMessageCommand> CreateSimilarFicListAction::ExecuteImpl(QShar
     command.user->initNewEasyQuery();
 
     auto ficId = command.ids.at(0);
-    QSharedPointer<core::RecommendationList> listParams;
-    //QString error;
-
-    auto recList = CreateSimilarFicParams();
-    recList->ignoreBreakdowns= true;
-    recList->isAutomatic = true;
-    recList->listSizeMultiplier = 20000;
 
     QVector<core::Identity> pack;
     pack.resize(1);
@@ -1548,9 +1530,6 @@ QSharedPointer<SendMessageCommand> CreateSimilarFicListAction::ExecuteImpl(QShar
     {
         if(source.id > 0 )
             hasValidId = true;
-        recList->ficData->sourceFics+=source.id;
-        recList->ficData->fics+=source.web.ffn;
-        recList->ficData->sourceFicsFFN+=source.web.ffn;
     }
     if(!hasValidId)
     {
@@ -1558,7 +1537,7 @@ QSharedPointer<SendMessageCommand> CreateSimilarFicListAction::ExecuteImpl(QShar
         action->stopChain = true;
         return action;
     }
-    recList = FillRecommendationsForSingularFic(environment, QString::number(command.ids.at(0)));
+    auto recList = FillRecommendationsForSingularFic(environment, QString::number(command.ids.at(0)));
     // instantiating working set for user
     An<Users> users;
     command.user->SetTemporaryFicsData(recList->ficData);
@@ -24,10 +24,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include "threaded_data/threaded_load.h"
 #include "rec_calc/rec_calculator_weighted.h"
 #include "rec_calc/rec_calculator_mood_adjusted.h"
+#include "rec_calc/rec_calculator_policies.h"
+#include "task_scheduler.h"
 
 #include <QSettings>
 #include <QDir>
 #include <algorithm>
+#include <numeric>
 //#include <execution>
 #include <cmath>
 namespace core{
@@ -79,39 +82,55 @@ void RecCalculator::SaveFavouritesData()
 
 RecommendationListResult RecCalculator::GetMatchedFicsForFavList(QHash<uint32_t, core::FicWeightPtr> fetchedFics,
                                                                  QSharedPointer<RecommendationList> params,
-                                                                 genre_stats::GenreMoodData moodData)
+                                                                 genre_stats::GenreMoodData moodData,
+                                                                 QString sessionToken,
+                                                                 CancellationToken cancellation)
 {
+    const uint32_t dataVersion = holder.dataVersion;
     QSharedPointer<RecCalculatorImplBase> calculator;
     if(params->useWeighting)
     {
         if(params->useMoodAdjustment)
-           calculator.reset(new RecCalculatorImplMoodAdjusted({holder.faves, holder.fics, holder.authorMoodDistributions}, moodData));
+           calculator.reset(new RecCalculatorMoodAdjusted({holder.faves, holder.ficStore, holder.authorMoods, holder.recommendersForFics, holder.authorOrdinals, holder.authorTables, holder.recommenderSketches}, moodData));
         else
-           calculator.reset(new RecCalculatorImplWeighted({holder.faves, holder.fics, holder.authorMoodDistributions}));
+           calculator.reset(new RecCalculatorWeighted({holder.faves, holder.ficStore, holder.authorMoods, holder.recommendersForFics, holder.authorOrdinals, holder.authorTables, holder.recommenderSketches}));
     }
     else
-        calculator.reset(new RecCalculatorImplDefault({holder.faves, holder.fics, holder.authorMoodDistributions}));
+        calculator.reset(new RecCalculatorDefault({holder.faves, holder.ficStore, holder.authorMoods, holder.recommendersForFics, holder.authorOrdinals, holder.authorTables, holder.recommenderSketches}));
     calculator->fetchedFics = fetchedFics;
+    calculator->cancellation = cancellation;
     calculator->doTrashCounting = params->useDislikes;
     calculator->params = params;
     for(auto fic : std::as_const(params->majorNegativeVotes))
         calculator->ownMajorNegatives.add(static_cast<uint32_t>(fic));
     QLOG_INFO() << "Received negative votes: " << params->majorNegativeVotes.size();
+    if(!sessionToken.isEmpty())
+    {
+        auto state = relationSessions.Take(sessionToken);
+        if(state && state->CanBeUpdatedFor(*params, dataVersion))
+            calculator->relationsState = state;
+    }
     TimedAction action("Reclist Creation",[&](){
         calculator->result.success = calculator->Calc();
     });
     action.run();
+    if(!sessionToken.isEmpty() && calculator->relationsState)
+    {
+        calculator->relationsState->dataVersion = dataVersion;
+        relationSessions.Store(sessionToken, calculator->relationsState);
+    }
     calculator->result.authors = calculator->filteredAuthors;
 
     return calculator->result;
 }
 
-DiagnosticRecommendationListResult RecCalculator::GetDiagnosticRecommendationList(QHash<uint32_t, FicWeightPtr> fetchedFics, QSharedPointer<RecommendationList> params, genre_stats::GenreMoodData moodData)
+DiagnosticRecommendationListResult RecCalculator::GetDiagnosticRecommendationList(QHash<uint32_t, FicWeightPtr> fetchedFics, QSharedPointer<RecommendationList> params, genre_stats::GenreMoodData moodData, CancellationToken cancellation)
 {
     DiagnosticRecommendationListResult result;
 
-    QSharedPointer<RecCalculatorImplWeighted> actualCalculator(new RecCalculatorImplMoodAdjusted({holder.faves, holder.fics, holder.authorMoodDistributions}, moodData));
+    QSharedPointer<RecCalculatorImplWeighted> actualCalculator(new RecCalculatorMoodAdjusted({holder.faves, holder.ficStore, holder.authorMoods, holder.recommendersForFics, holder.authorOrdinals, holder.authorTables, holder.recommenderSketches}, moodData));
     actualCalculator->fetchedFics = fetchedFics;
+    actualCalculator->cancellation = cancellation;
     actualCalculator->params = params;
     actualCalculator->needsDiagnosticData = true;
 
@@ -139,31 +158,66 @@ DiagnosticRecommendationListResult RecCalculator::GetDiagnosticRecommendationLis
 
 FavouritesMatchResult RecCalculator::GetMatchedFics(UserMatchesInput input, int user2)
 {
-    QLOG_INFO() << "Creating calculator";
+    return GetMatchedFics(PrepareUserMatches(input), user2);
+}
+
+QHash<int, FavouritesMatchResult> RecCalculator::GetMatchedFics(UserMatchesInput input, const QList<int>& users, CancellationToken cancellation)
+{
+    const auto context = PrepareUserMatches(input);
+    std::vector<FavouritesMatchResult> matches(static_cast<size_t>(users.size()));
+    std::vector<uint8_t> matched(static_cast<size_t>(users.size()), 0);
+    auto& scheduler = TaskScheduler::Instance();
+    // chunks of about the same amount of favourites so that a few huge lists don't hold up the others
+    const auto ranges = scheduler.SplitByCost(matches.size(), [&](size_t position) -> uint64_t {
+        auto it = holder.faves.constFind(users.at(static_cast<int>(position)));
+        return it != holder.faves.cend() ? it.value().cardinality() : 0;
+    });
+    scheduler.ParallelFor(ranges, [&](size_t begin, size_t end){
+        for(size_t position = begin; position < end; position++)
+        {
+            if(cancellation.IsCancelled())
+                return;
+            matches[position] = GetMatchedFics(context, users.at(static_cast<int>(position)));
+            matched[position] = 1;
+        }
+    });
+    QHash<int, FavouritesMatchResult> result;
+    result.reserve(users.size());
+    for(int i = 0; i < users.size(); i++)
+        if(matched[static_cast<size_t>(i)])
+            result.insert(users.at(i), matches[static_cast<size_t>(i)]);
+    return result;
+}
+
+UserMatchesContext RecCalculator::PrepareUserMatches(UserMatchesInput input)
+{
     QSharedPointer<RecCalculatorImplWeighted> calculator;
-    calculator.reset(new RecCalculatorImplWeighted({holder.faves, holder.fics, holder.authorMoodDistributions}));
-    //calculator->fetchedFics = fetchedFics;
+    calculator.reset(new RecCalculatorWeighted({holder.faves, holder.ficStore, holder.authorMoods, holder.recommendersForFics, holder.authorOrdinals, holder.authorTables, holder.recommenderSketches}));
     QSharedPointer<RecommendationList> params(new RecommendationList);
     for(auto ignore: input.userIgnoredFandoms)
         params->ignoredFandoms.insert(ignore);
     calculator->params = params;
 
-    auto ignores = calculator->BuildIgnoreList();
-    QLOG_INFO() << "Making & list";
-    Roaring ignoredTemp = holder.faves[user2];
-    ignoredTemp = ignoredTemp & ignores;
-    QLOG_INFO() << "Checking cardinality";
-    auto unignoredSize = holder.faves[user2].xor_cardinality(ignoredTemp);
+    UserMatchesContext context;
+    context.userFavourites = std::move(input.userFavourites);
+    context.ignores = calculator->BuildIgnoreList();
+    return context;
+}
 
+FavouritesMatchResult RecCalculator::GetMatchedFics(const UserMatchesContext& input, int user2) const
+{
+    static const Roaring noFavourites;
+    // users are matched from several threads, the hash must not be touched with operator[]
+    auto it = holder.faves.constFind(user2);
+    const Roaring& favourites = it != holder.faves.cend() ? it.value() : noFavourites;
+    const auto unignoredSize = favourites.cardinality() - favourites.and_cardinality(input.ignores);
 
     FavouritesMatchResult result;
-    QLOG_INFO() << "Blargh";
-    Roaring temp = input.userFavourites;
-    temp = temp & holder.faves[user2];
-    for(auto fic : temp)
+    const Roaring matches = input.userFavourites & favourites;
+    for(auto fic : matches)
         result.matches.push_back(fic);
-    result.ratioWithoutIgnores = static_cast<float>(holder.faves[user2].cardinality())/static_cast<float>(temp.cardinality());
-    result.ratio = static_cast<float>(unignoredSize)/static_cast<float>(temp.cardinality());
+    result.ratioWithoutIgnores = static_cast<float>(favourites.cardinality())/static_cast<float>(matches.cardinality());
+    result.ratio = static_cast<float>(unignoredSize)/static_cast<float>(matches.cardinality());
     return result;
 }
 
@@ -19,12 +19,23 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include "include/db_fixers.h"
 
 #include "servers/feed.h"
+#include "servers/feed_async.h"
+#include "servers/similar_fics.h"
+#include "servers/sketch_evaluation.h"
+#include "data_code/recommender_neighbours.h"
+#include "favholder.h"
 #include "logger/QsLog.h"
 #include "loggers/usage_statistics.h"
 #include "Interfaces/interface_sqlite.h"
 #include <QCoreApplication>
 #include <QSettings>
+#include <QThread>
 #include <QtConcurrent>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <thread>
+#include <pthread.h>
 
 
 
@@ -67,6 +78,20 @@ void SetupStatLogger()
 }
 
 
+static std::atomic<bool> serving{false};
+
+// SIGINT and SIGTERM are taken by this thread instead of killing the process
+// so that a running server can stop accepting calls and answer the ones it already has
+static void WaitForTerminationSignal(sigset_t signals)
+{
+    int signalNumber = 0;
+    sigwait(&signals, &signalNumber);
+    if(!serving)
+        std::_Exit(128 + signalNumber);
+    QLOG_INFO() << "Received signal" << signalNumber << "stopping the server";
+    QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+}
+
 inline std::string CreateConnectString(QString ip,QString port)
 {
     QString server_address_proto("%1:%2");
@@ -76,6 +101,14 @@ inline std::string CreateConnectString(QString ip,QString port)
 
 int main(int argc, char *argv[])
 {
+    // blocked before any thread is started so that every thread inherits the mask
+    sigset_t terminationSignals;
+    sigemptyset(&terminationSignals);
+    sigaddset(&terminationSignals, SIGINT);
+    sigaddset(&terminationSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &terminationSignals, nullptr);
+    std::thread(WaitForTerminationSignal, terminationSignals).detach();
+
     QCoreApplication a(argc, argv);
     a.setApplicationName("Flipper");
 
@@ -86,26 +119,98 @@ int main(int argc, char *argv[])
     SetupStatLogger();
     QLOG_INFO() << "Feeder app started server";
     FeederService service;
-    auto serverSetup = [&](){
+    // offline refresh of the similar fic table, the server is restarted to pick it up
+    if(a.arguments().contains("--build-similar-fics"))
+    {
         QSettings settings("settings/settings_server.ini", QSettings::IniFormat);
-        auto ip = settings.value("Settings/serverIp", "127.0.0.1").toString();
-        auto port = settings.value("Settings/serverPort", "3055").toString();
-
-        std::string server_address = CreateConnectString(ip, port);
-        QLOG_INFO() << "Connection string is: " << QString::fromStdString(server_address);
-
+        SimilarFicsSettings similarFics;
+        similarFics.fileName = settings.value("SimilarFics/buildFileName", similarFics.fileName).toString();
+        similarFics.neighbours = settings.value("SimilarFics/neighbours", similarFics.neighbours).toUInt();
+        similarFics.minimumFavourites = settings.value("SimilarFics/minimumFavourites", similarFics.minimumFavourites).toInt();
+        An<core::RecCalculator> calculator;
+        return BuildSimilarFicTable(*calculator, similarFics) ? 0 : 1;
+    }
+    // offline refresh of the nearest recommenders used by GetUserMatches
+    if(a.arguments().contains("--build-recommender-neighbours"))
+    {
+        QSettings settings("settings/settings_server.ini", QSettings::IniFormat);
+        core::RecommenderNeighboursSettings neighbours;
+        neighbours.sketchContainment = settings.value("RecommenderNeighbours/sketchContainment", neighbours.sketchContainment).toDouble();
+        neighbours.minimumListSize = settings.value("RecommenderNeighbours/minimumListSize", neighbours.minimumListSize).toUInt();
+        neighbours.minimumMatches = settings.value("RecommenderNeighbours/minimumMatches", neighbours.minimumMatches).toUInt();
+        neighbours.neighbours = settings.value("RecommenderNeighbours/neighbours", neighbours.neighbours).toUInt();
+        neighbours.threads = settings.value("RecommenderNeighbours/threads", QThread::idealThreadCount()).toInt();
+        An<core::RecCalculator> calculator;
+        const auto table = core::BuildRecommenderNeighbours(calculator->holder.authorOrdinals, calculator->holder.recommenderSketches, neighbours);
+        const auto fileName = settings.value("RecommenderNeighbours/buildFileName", "ServerData/recommender_neighbours.bin").toString();
+        return table.Save(fileName) ? 0 : 1;
+    }
+    // offline comparison of the approximate candidate retrieval against the exact one
+    if(a.arguments().contains("--evaluate-sketches"))
+    {
+        QSettings settings("settings/settings_server.ini", QSettings::IniFormat);
+        SketchEvaluationSettings evaluation;
+        evaluation.minimumListSize = settings.value("SketchEvaluation/minimumListSize", evaluation.minimumListSize).toInt();
+        evaluation.lists = settings.value("SketchEvaluation/lists", evaluation.lists).toInt();
+        evaluation.resultLimit = settings.value("SketchEvaluation/resultLimit", evaluation.resultLimit).toInt();
+        const auto containments = settings.value("SketchEvaluation/containments").toStringList();
+        if(!containments.isEmpty())
+        {
+            evaluation.containments.clear();
+            for(const auto& containment : containments)
+                evaluation.containments.push_back(containment.toDouble());
+        }
+        An<core::RecCalculator> calculator;
+        EvaluateRecommenderSketches(*calculator, evaluation);
+        return 0;
+    }
+    QSettings settings("settings/settings_server.ini", QSettings::IniFormat);
+    auto ip = settings.value("Settings/serverIp", "127.0.0.1").toString();
+    auto port = settings.value("Settings/serverPort", "3055").toString();
+
+    std::string server_address = CreateConnectString(ip, port);
+    QLOG_INFO() << "Connection string is: " << QString::fromStdString(server_address);
+
+    // both servers are owned by main so that the exit path can shut them down before the service is destroyed
+    std::unique_ptr<FeederAsyncServer> asyncServer;
+    std::unique_ptr<Server> server;
+    if(settings.value("Settings/asyncServer", false).toBool())
+        asyncServer.reset(new FeederAsyncServer(&service, settings));
+    else
+    {
         ServerBuilder builder;
         builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
         builder.RegisterService(&service);
         builder.SetMaxMessageSize(1024 * 1024 * 1024);
-        std::unique_ptr<Server> server(builder.BuildAndStart());
+        server = builder.BuildAndStart();
         QLOG_INFO() << "Starting server";
-        stateFile.setValue("server_state", "Ready");
-        stateFile.sync();
-        settings.sync();
+    }
+    settings.sync();
+
+    auto serverSetup = [&](){
+        if(asyncServer)
+        {
+            QLOG_INFO() << "Starting async server";
+            asyncServer->Run(server_address);
+            return;
+        }
         server->Wait();
     };
-    QtConcurrent::run(serverSetup);
-    return a.exec();
+    stateFile.setValue("server_state", "Ready");
+    stateFile.sync();
+    serving = true;
+    auto serverThread = QtConcurrent::run(serverSetup);
+    const auto result = a.exec();
+    // the server stops accepting calls and finishes the accepted ones, the async one also drains its queues
+    // the server thread is joined before the service it calls into is destroyed
+    if(asyncServer)
+        asyncServer->Shutdown();
+    else
+        server->Shutdown();
+    serverThread.waitForFinished();
+    QLOG_INFO() << "Server stopped";
+    stateFile.setValue("server_state", "Stopped");
+    stateFile.sync();
+    return result;
 }
 
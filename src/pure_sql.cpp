@@ -1545,6 +1545,7 @@ static auto getFicWeightPtrFromQuery = [](auto& q){
     fw->published = q.value("published").toDate();
     fw->updated = q.value("updated").toDate();
     fw->genreString = QString::fromStdString(q.value("genres").toString());
+    fw->genreMask = genre_stats::GenreMaskFromString(fw->genreString);
     fw->id = q.value("id").toInt();
     fw->reviewCount = q.value("reviews").toInt();
     fw->slash = q.value("filter_pass_1").toBool();
@@ -1568,6 +1569,28 @@ DiagnosticSQLResult<QHash<uint32_t, core::FicWeightPtr>> GetFicsForRecCreation(s
 
 
 }
+DiagnosticSQLResult<QHash<uint32_t, core::FicWeightPtr>> GetFicsForRecCreationByIds(QList<int> ids, sql::Database db)
+{
+    SqlContext<QHash<uint32_t, core::FicWeightPtr>> ctx(db);
+    std::string qs = "select id,rated, chapters, author_id, complete, updated, "
+                         "fandom1,fandom2,favourites, published, updated,"
+                         "  genres, reviews, filter_pass_1, wordcount"
+                         "  from fanfics where id in ({0}) order by id asc";
+    QStringList inParts;
+    inParts.reserve(ids.size());
+    for(auto id: ids)
+        inParts.push_back(QString::number(id));
+    if(inParts.size() == 0)
+        return std::move(ctx.result);
+    qs = fmt::format(qs, inParts.join(",").toStdString());
+    ctx.FetchSelectFunctor(std::move(qs), DATAQ{
+                               auto fw = getFicWeightPtrFromQuery(q);
+                               if(fw)
+                                data[static_cast<uint32_t>(fw->id)] = fw;
+                           });
+    return std::move(ctx.result);
+}
+
 DiagnosticSQLResult<bool> ConvertFFNTaggedFicsToDB(QHash<int, int>& hash, sql::Database db)
 {
     SqlContext<int> ctx(db);
@@ -1776,6 +1799,7 @@ DiagnosticSQLResult<QHash<int, QList<genre_stats::GenreBit>>> GetFullGenreList(s
                 bit.genres.push_back(genreBit);
                 bit.isInTheOriginal = true;
                 bit.relevance = 1;
+                bit.UpdateMask();
                 dataForFic.push_back(bit);
             }
         }
@@ -1798,6 +1822,7 @@ DiagnosticSQLResult<QHash<int, QList<genre_stats::GenreBit>>> GetFullGenreList(s
                 for(const auto& genreBit : std::as_const(bit.genres))
                     if(genres.contains(genreBit))
                         bit.isInTheOriginal = true;
+                bit.UpdateMask();
 
                 dataForFic.push_back(bit);
             }
@@ -3744,6 +3769,45 @@ DiagnosticSQLResult<QVector<core::FicWeightPtr> > GetAllFicsWithEnoughFavesForWe
     return std::move(ctx.result);
 }
 
+DiagnosticSQLResult<bool> ProcessFicsForSearchIndex(std::function<void(const core::FicSearchRecord&)> processor, sql::Database db)
+{
+    SqlContext<bool> ctx(db);
+    std::string qs = "select id, fandom1, fandom2, wordcount, favourites, reviews, complete, rated, genres,"
+                     " published, updated, keywords_result, filter_pass_1, filter_pass_2"
+                     " from fanfics order by id asc";
+    core::FicSearchRecord record;
+    ctx.FetchSelectFunctor(std::move(qs), DATAQN{
+                               record.id = q.value("id").toInt();
+                               record.fandom1 = q.value("fandom1").toInt();
+                               record.fandom2 = q.value("fandom2").toInt();
+                               record.wordCount = q.value("wordcount").toInt();
+                               record.favourites = q.value("favourites").toInt();
+                               record.reviews = q.value("reviews").toInt();
+                               record.complete = q.value("complete").toBool();
+                               record.ratedM = QString::fromStdString(q.value("rated").toString()) == "M";
+                               record.genreString = QString::fromStdString(q.value("genres").toString());
+                               record.published = q.value("published").toDate();
+                               record.updated = q.value("updated").toDate();
+                               record.keywordsResult = q.value("keywords_result").toInt() == 1;
+                               record.filterPass1 = q.value("filter_pass_1").toInt() == 1;
+                               record.filterPass2 = q.value("filter_pass_2").toInt() == 1;
+                               processor(record);
+                           });
+    ctx.result.data = ctx.result.success;
+    return std::move(ctx.result);
+}
+
+DiagnosticSQLResult<bool> ProcessFicIdPairs(std::function<void(int, int)> processor, sql::Database db)
+{
+    SqlContext<bool> ctx(db);
+    std::string qs = "select id, ffn_id from fanfics order by id asc";
+    ctx.FetchSelectFunctor(std::move(qs), DATAQN{
+                               processor(q.value("id").toInt(), q.value("ffn_id").toInt());
+                           });
+    ctx.result.data = ctx.result.success;
+    return std::move(ctx.result);
+}
+
 
 DiagnosticSQLResult<QHash<int, core::AuthorFavFandomStatsPtr>> GetAuthorListFandomStatistics(QList<int> authors, sql::Database db)
 {
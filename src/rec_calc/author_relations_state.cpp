@@ -0,0 +1,85 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/rec_calc/author_relations_state.h"
+#include "include/core/recommendation_list.h"
+
+namespace core{
+
+bool AuthorRelationsState::CanBeUpdatedFor(const RecommendationList& params, uint32_t currentDataVersion) const
+{
+    return dataVersion == currentDataVersion
+            && userFFNId == params.userFFNId
+            && sketchContainment == params.sketchContainment
+            && ignoredFandoms == params.ignoredFandoms
+            && ignoredDeadFics == params.ignoredDeadFics;
+}
+
+void AuthorRelationsSessions::SetLimits(int maxSessions, int lifetimeSeconds)
+{
+    QMutexLocker locker(&lock);
+    this->maxSessions = maxSessions;
+    this->lifetimeSeconds = lifetimeSeconds;
+}
+
+QSharedPointer<AuthorRelationsState> AuthorRelationsSessions::Take(const QString& token)
+{
+    QMutexLocker locker(&lock);
+    RemoveExpired(QDateTime::currentDateTimeUtc());
+    auto it = sessions.find(token);
+    if(it == sessions.end())
+        return {};
+    auto state = it->state;
+    sessions.erase(it);
+    return state;
+}
+
+void AuthorRelationsSessions::Store(const QString& token, QSharedPointer<AuthorRelationsState> state)
+{
+    if(token.isEmpty() || !state)
+        return;
+    QMutexLocker locker(&lock);
+    if(maxSessions <= 0)
+        return;
+    const auto now = QDateTime::currentDateTimeUtc();
+    RemoveExpired(now);
+    if(!sessions.contains(token))
+    {
+        while(sessions.size() >= maxSessions)
+        {
+            auto oldest = sessions.begin();
+            for(auto it = sessions.begin(); it != sessions.end(); it++)
+                if(it->storedAt < oldest->storedAt)
+                    oldest = it;
+            sessions.erase(oldest);
+        }
+    }
+    sessions[token] = {state, now};
+}
+
+void AuthorRelationsSessions::RemoveExpired(const QDateTime& now)
+{
+    for(auto it = sessions.begin(); it != sessions.end();)
+    {
+        if(it->storedAt.secsTo(now) > lifetimeSeconds)
+            it = sessions.erase(it);
+        else
+            it++;
+    }
+}
+
+}
@@ -0,0 +1,235 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/rec_calc/list_overlap.h"
+#include "third_party/nanobench/nanobench.h"
+#include "logger/QsLog.h"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define LIST_OVERLAP_HAS_AVX2_PATH
+#endif
+
+namespace core{
+
+namespace {
+constexpr int maxOverlapTargets = 3;
+
+// and cardinalities of one bitset container against up to three others
+// the container of the list is only read once for all of them
+void BitsetAndCardinalitiesScalar(const uint64_t* list, const uint64_t* const* others, int otherCount, uint32_t** counters)
+{
+    uint64_t sums[maxOverlapTargets] = {};
+    for(int word = 0; word < BITSET_CONTAINER_SIZE_IN_WORDS; word++)
+    {
+        const uint64_t value = list[word];
+        for(int other = 0; other < otherCount; other++)
+            sums[other] += static_cast<uint64_t>(__builtin_popcountll(value & others[other][word]));
+    }
+    for(int other = 0; other < otherCount; other++)
+        *counters[other] += static_cast<uint32_t>(sums[other]);
+}
+
+#ifdef LIST_OVERLAP_HAS_AVX2_PATH
+// popcount through a nibble lookup table, AVX2 has no vector popcount instruction
+__attribute__((target("avx2")))
+void BitsetAndCardinalitiesAvx2(const uint64_t* list, const uint64_t* const* others, int otherCount, uint32_t** counters)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sums[maxOverlapTargets] = {zero, zero, zero};
+    for(int word = 0; word < BITSET_CONTAINER_SIZE_IN_WORDS; word += 4)
+    {
+        const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(list + word));
+        for(int other = 0; other < otherCount; other++)
+        {
+            const __m256i anded = _mm256_and_si256(value, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(others[other] + word)));
+            const __m256i low = _mm256_and_si256(anded, lowMask);
+            const __m256i high = _mm256_and_si256(_mm256_srli_epi16(anded, 4), lowMask);
+            const __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high));
+            sums[other] = _mm256_add_epi64(sums[other], _mm256_sad_epu8(bytes, zero));
+        }
+    }
+    for(int other = 0; other < otherCount; other++)
+    {
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sums[other]);
+        *counters[other] += static_cast<uint32_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+    }
+}
+
+bool CpuHasAvx2()
+{
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+}
+#endif
+
+void BitsetAndCardinalities(const uint64_t* list, const uint64_t* const* others, int otherCount, uint32_t** counters)
+{
+#ifdef LIST_OVERLAP_HAS_AVX2_PATH
+    if(CpuHasAvx2())
+    {
+        BitsetAndCardinalitiesAvx2(list, others, otherCount, counters);
+        return;
+    }
+#endif
+    BitsetAndCardinalitiesScalar(list, others, otherCount, counters);
+}
+
+// container level functions of the amalgamated header don't have C linkage and can't be called from here
+// so mismatched container types go through the public api on bitmaps made of just the two containers
+uint32_t ContainerAndCardinality(uint16_t key, const void* first, uint8_t firstType, const void* second, uint8_t secondType)
+{
+    void* firstContainers[1] = {const_cast<void*>(first)};
+    void* secondContainers[1] = {const_cast<void*>(second)};
+    uint16_t keys[1] = {key};
+    uint8_t firstTypes[1] = {firstType};
+    uint8_t secondTypes[1] = {secondType};
+    roaring_bitmap_t firstBitmap;
+    firstBitmap.high_low_container = {1, 1, firstContainers, keys, firstTypes};
+    firstBitmap.copy_on_write = false;
+    roaring_bitmap_t secondBitmap;
+    secondBitmap.high_low_container = {1, 1, secondContainers, keys, secondTypes};
+    secondBitmap.copy_on_write = false;
+    return static_cast<uint32_t>(roaring_bitmap_and_cardinality(&firstBitmap, &secondBitmap));
+}
+
+// position in a bitmap that only moves forward, the keys of the list are visited in ascending order
+struct ContainerCursor{
+    explicit ContainerCursor(const Roaring& bitmap):containers(&bitmap.roaring.high_low_container){}
+    // container with this key or nullptr
+    const void* Seek(uint16_t key, uint8_t* type){
+        if(position < 0 || (position < containers->size && containers->keys[position] < key))
+            position = ra_advance_until(containers, key, position);
+        if(position >= containers->size || containers->keys[position] != key)
+            return nullptr;
+        *type = containers->typecodes[position];
+        return container_unwrap_shared(containers->containers[position], type);
+    }
+    const roaring_array_t* containers;
+    int32_t position = -1;
+};
+}
+
+ListOverlap CalcListOverlap(const Roaring& list, const Roaring& ignores, const Roaring& favourites, const Roaring& negatives)
+{
+    ListOverlap result;
+    ContainerCursor cursors[maxOverlapTargets] = {ContainerCursor(ignores), ContainerCursor(favourites), ContainerCursor(negatives)};
+    uint32_t* counters[maxOverlapTargets] = {&result.ignored, &result.matches, &result.negativeMatches};
+
+    const roaring_array_t& containers = list.roaring.high_low_container;
+    for(int32_t i = 0; i < containers.size; i++)
+    {
+        uint8_t type = containers.typecodes[i];
+        const void* container = container_unwrap_shared(containers.containers[i], &type);
+        result.size += static_cast<uint32_t>(container_get_cardinality(container, type));
+
+        const uint64_t* bitsets[maxOverlapTargets];
+        uint32_t* bitsetCounters[maxOverlapTargets];
+        int bitsetCount = 0;
+        for(int target = 0; target < maxOverlapTargets; target++)
+        {
+            uint8_t otherType = 0;
+            const void* other = cursors[target].Seek(containers.keys[i], &otherType);
+            if(!other)
+                continue;
+            if(type == BITSET_CONTAINER_TYPE_CODE && otherType == BITSET_CONTAINER_TYPE_CODE)
+            {
+                bitsets[bitsetCount] = static_cast<const bitset_container_t*>(other)->array;
+                bitsetCounters[bitsetCount] = counters[target];
+                bitsetCount++;
+            }
+            else
+                *counters[target] += ContainerAndCardinality(containers.keys[i], container, type, other, otherType);
+        }
+        if(bitsetCount > 0)
+            BitsetAndCardinalities(static_cast<const bitset_container_t*>(container)->array, bitsets, bitsetCount, bitsetCounters);
+    }
+    return result;
+}
+
+void BenchmarkListOverlap(const QHash<int, Roaring>& faves)
+{
+    // every n-th list keeps the size distribution of the real data
+    std::vector<int> authors;
+    authors.reserve(static_cast<size_t>(faves.size()));
+    for(auto it = faves.cbegin(); it != faves.cend(); it++)
+        authors.push_back(it.key());
+    std::sort(authors.begin(), authors.end());
+    const size_t step = std::max<size_t>(1, authors.size()/5000);
+    std::vector<const Roaring*> sample;
+    for(size_t i = 0; i < authors.size(); i += step)
+        sample.push_back(&faves.find(authors[i]).value());
+    if(sample.size() < 2)
+    {
+        QLOG_INFO() << "Not enough favourites to benchmark list overlap";
+        return;
+    }
+
+    // user lists: a list of a typical size for favourites, a part of another one for negatives
+    // and the biggest lists together standing in for ignored fandoms
+    std::vector<const Roaring*> bySize = sample;
+    std::sort(bySize.begin(), bySize.end(), [](const Roaring* left, const Roaring* right){
+        return left->cardinality() < right->cardinality();
+    });
+    const Roaring& favourites = *bySize[bySize.size()*3/4];
+    Roaring negatives;
+    uint32_t position = 0;
+    for(auto fic : *bySize[bySize.size()*3/4 - 1])
+        if(position++ % 5 == 0)
+            negatives.add(fic);
+    std::vector<const Roaring*> biggest(bySize.end() - static_cast<std::ptrdiff_t>(std::min<size_t>(20, bySize.size())), bySize.end());
+    Roaring ignores = Roaring::fastunion(biggest.size(), biggest.data());
+
+    int mismatches = 0;
+    for(auto list : sample)
+    {
+        const auto fused = CalcListOverlap(*list, ignores, favourites, negatives);
+        if(fused.size != list->cardinality()
+                || fused.ignored != list->and_cardinality(ignores)
+                || fused.matches != list->and_cardinality(favourites)
+                || fused.negativeMatches != list->and_cardinality(negatives))
+            mismatches++;
+    }
+    QLOG_INFO() << "List overlap benchmark on lists:" << sample.size() << "mismatches:" << mismatches;
+
+    ankerl::nanobench::Bench bench;
+    bench.title("List overlap").relative(true).minEpochIterations(5);
+    bench.run("separate roaring calls", [&](){
+        uint64_t sum = 0;
+        for(auto list : sample)
+            sum += list->cardinality() + list->and_cardinality(ignores) + list->and_cardinality(favourites) + list->and_cardinality(negatives);
+        ankerl::nanobench::doNotOptimizeAway(sum);
+    });
+    bench.run("fused", [&](){
+        uint64_t sum = 0;
+        for(auto list : sample)
+        {
+            const auto overlap = CalcListOverlap(*list, ignores, favourites, negatives);
+            sum += overlap.size + overlap.ignored + overlap.matches + overlap.negativeMatches;
+        }
+        ankerl::nanobench::doNotOptimizeAway(sum);
+    });
+}
+
+}
@@ -16,11 +16,12 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
 #include "include/rec_calc/rec_calculator_base.h"
+#include "include/rec_calc/list_overlap.h"
 #include "timeutils.h"
+#include "task_scheduler.h"
 #include "third_party/nanobench/nanobench.h"
-#include <QFuture>
-#include <QtConcurrent>
 #include <execution>
+#include <algorithm>
 
 namespace core{
 void RecCalculatorImplBase::ResetAccumulatedData()
@@ -29,70 +30,6 @@ void RecCalculatorImplBase::ResetAccumulatedData()
     filteredAuthors.clear();
 }
 
-auto threadedIntListProcessor = [](QString taskName, int threadsToUse, QList<int> list, auto worker, auto resultingDataProcessor){
-    QVector<std::pair<QList<int>::const_iterator,QList<int>::const_iterator>> iterators;
-    int chunkSize = list.size()/threadsToUse;
-    int listSize = list.size();
-    int  i = 0;
-    iterators.reserve(threadsToUse);
-    while(i*chunkSize < listSize)
-    {
-        QList<int>::const_iterator begin = list.cbegin();
-        QList<int>::const_iterator end = list.cbegin();
-        std::advance(begin, i*chunkSize);
-        int rightBorder = i*chunkSize + chunkSize;
-        if(rightBorder < list.size())
-            std::advance(end, rightBorder);
-        else
-            end = list.cend();
-        iterators.push_back({begin, end});
-        i++;
-    }
-    typedef std::pair<QList<int>::const_iterator,QList<int>::const_iterator> PairType;
-    TimedAction task(taskName,[&](){
-        QVector<QFuture<decltype(worker(std::declval<PairType>()))>> futures;
-        for(int i = 0; i < iterators.size(); i++)
-            futures.push_back(QtConcurrent::run(std::bind(worker,iterators.at(i))));
-        for(auto future: futures)
-            future.waitForFinished();
-        for(const auto& future: futures)
-            resultingDataProcessor(future.result());
-    });
-    task.run();
-};
-
-auto threadedIntListTupleProcessor = [](QString taskName, int threadsToUse, QList<int> list, auto worker, auto resultingDataProcessor){
-    QVector<std::tuple<QList<int>::const_iterator,QList<int>::const_iterator,QList<int>::const_iterator>> iterators;
-    int chunkSize = list.size()/threadsToUse;
-    int listSize = list.size();
-    int  i = 0;
-    iterators.reserve(threadsToUse);
-    while(i*chunkSize < listSize)
-    {
-        QList<int>::const_iterator begin = list.cbegin();
-        QList<int>::const_iterator end = list.cbegin();
-        std::advance(begin, i*chunkSize);
-        int rightBorder = i*chunkSize + chunkSize;
-        if(rightBorder < list.size())
-            std::advance(end, rightBorder);
-        else
-            end = list.cend();
-        iterators.push_back({list.begin(),begin, end});
-        i++;
-    }
-    typedef std::tuple<QList<int>::const_iterator,QList<int>::const_iterator,QList<int>::const_iterator> TupleType;
-    TimedAction task(taskName,[&](){
-        QVector<QFuture<decltype(worker(std::declval<TupleType>()))>> futures;
-        for(int i = 0; i < iterators.size(); i++)
-            futures.push_back(QtConcurrent::run(std::bind(worker,iterators.at(i))));
-        for(auto future: futures)
-            future.waitForFinished();
-        for(const auto& future: futures)
-            resultingDataProcessor(future.result());
-    });
-    task.run();
-};
-
 bool RecCalculatorImplBase::Calc(){
     auto filters = GetFilterList();
     auto actions = GetActionList();
@@ -103,8 +40,12 @@ bool RecCalculatorImplBase::Calc(){
         //});
     //});
     //relations.run();
+    if(cancellation.IsCancelled())
+        return false;
     params->ratioCutoff = ratioCutoff;
     RunMatchingAndWeighting(params, filters, actions);
+    if(cancellation.IsCancelled())
+        return false;
     QLOG_INFO() << "filtered authors after default pass:" << filteredAuthors.size();
 
     CalculateNegativeToPositiveRatio();
@@ -131,27 +72,19 @@ bool RecCalculatorImplBase::Calc(){
 
 void RecCalculatorImplBase::RunMatchingAndWeighting(QSharedPointer<RecommendationList> params, const FilterListType& filters, const ActionListType& actions)
 {
-    int  i = 0;
-    AutoAdjustmentAndFilteringResult firstAdjustmentResult;
-    do
-    {
-        ResetAccumulatedData();
-        TimedAction filtering("Filtering data",[&](){
-            Filter(params, filters, actions);
-        });
-        filtering.run();
+    ResetAccumulatedData();
+    TimedAction filtering("Filtering data",[&](){
+        FilterAuthors(params, filters, actions);
+    });
+    filtering.run();
 
-        TimedAction weighting("weighting",[&](){
-            CalcWeightingParams();
-        });
-        weighting.run();
-        if(!params->isAutomatic && !params->adjusting)
-            break;
-        i++;
-    }while(params->adjusting);
+    TimedAction weighting("weighting",[&](){
+        CalcWeightingParams();
+    });
+    weighting.run();
 }
 
-double GetCoeffForTouchyDiff(double diff, bool useScaleDown = true)
+double GetCoeffForTouchyDiff(double diff, bool useScaleDown)
 {
 
     if(diff <= 0.1)
@@ -172,292 +105,290 @@ double GetCoeffForTouchyDiff(double diff, bool useScaleDown = true)
 }
 
 
-QSet<int> LimitResults(QSharedPointer<RecommendationList> params,
-                       RecommendationListResult& result,
-                       QHash<uint32_t, core::FicWeightPtr>& fetchedFics){
-    QSet<int> limiterResults;
-    std::list<int> scores;
-    std::list<int> ids;
-        scores.clear();
-        ids.clear();
-        if(params->resultLimit != 0){
-
-            auto itHash = result.recommendations.cbegin();
-            auto itHashEnd = result.recommendations.cend();
-            bool top = false;
-            bool bubble = false;
-
-            while(itHash != itHashEnd){
-                top = false;
-                bubble = false;
-                auto& key = itHash.key();
-                auto& value = itHash.value();
-                if(fetchedFics.contains(key))
-                {
-                    itHash++;
-                    continue;
-                }
-                if(scores.back() <= value)
-                    top = true;
-                else if(scores.front() < value || scores.size() < params->resultLimit)
-                    bubble = true;
-                else if(scores.front() == value)
-                {
-                    if(scores.size() < params->resultLimit)
-                        bubble = true;
-                }
-                if(top)
-                {
-                    scores.push_back(value);
-                    ids.push_back(key);
-                    if(scores.size() > params->resultLimit)
-                    {
-                        scores.pop_front();
-                        ids.pop_front();
-                    }
-                }
-                else if(bubble){
-                    auto itList = scores.cbegin();
-                    auto itListEnd = scores.cend();
-                    int counter = 0;
-                    while(itList!=itListEnd){
-                        if(*itList >= value){
-                            break;
-                        }
-                        counter++;
-                        itList++;
-                    }
-                    if(counter > 0 || scores.size() < params->resultLimit){
-                        auto itChange = scores.cbegin();
-                        auto itChangeIds = ids.cbegin();
-                        std::advance(itChange, counter);
-                        std::advance(itChangeIds, counter);
-                        scores.insert(itChange, value);
-                        ids.insert(itChangeIds, key);
-                    }
-                    if(scores.size() > params->resultLimit)
-                    {
-                        scores.pop_front();
-                        ids.pop_front();
-                    }
-                }
-                itHash++;
-            }
-        }
+void FicVoteAccumulator::Init(const FicStore* ficStore, uint32_t firstOrdinal, uint32_t endOrdinal)
+{
+    if(store)
+        Clear();
+    store = ficStore;
+    this->firstOrdinal = firstOrdinal;
+    firstId = firstOrdinal == 0 ? 0 : store->ids[firstOrdinal];
+    lastId = endOrdinal >= store->Size() ? std::numeric_limits<uint32_t>::max() : store->ids[endOrdinal] - 1;
+    slotsByOrdinal.assign(endOrdinal - firstOrdinal, noSlot);
+}
 
-//    auto itScores = scores.cbegin();
-//    auto itIds = ids.cbegin();
-//    qDebug() << "LIMITS RESULTS";
-//    for(auto i = 0 ; i < params->resultLimit; i++)
-//    {
-//        qDebug() << *itScores << " " << *itIds;
-//        itScores++;itIds++;
-//    }
-    for(auto id: ids){
-        limiterResults.insert(id);
+uint32_t FicVoteAccumulator::NewSlot(uint32_t ficId)
+{
+    fics.push_back(FicVotes());
+    fics.back().ficId = ficId;
+    return static_cast<uint32_t>(fics.size() - 1);
+}
+
+FicVotes& FicVoteAccumulator::ForFicOutsideStore(uint32_t ficId)
+{
+    auto it = slotsOutsideStore.find(ficId);
+    if(it == slotsOutsideStore.end())
+        it = slotsOutsideStore.insert(ficId, NewSlot(ficId));
+    return fics[it.value()];
+}
+
+void FicVoteAccumulator::Clear()
+{
+    for(const auto& fic : fics)
+    {
+        const auto ordinal = store->OrdinalFor(fic.ficId);
+        if(ordinal != FicStore::invalidOrdinal)
+            slotsByOrdinal[ordinal - firstOrdinal] = noSlot;
     }
+    slotsOutsideStore.clear();
+    fics.clear();
+}
+
+// fics with the highest votes that aren't in the user's own list
+// ties are resolved in favour of the lower fic id so that the result doesn't depend on accumulation order
+QSet<int> LimitResults(int resultLimit,
+                       const std::vector<FicVoteAccumulator>& ficVotes,
+                       const QHash<uint32_t, core::FicWeightPtr>& fetchedFics){
+    QSet<int> limiterResults;
+    if(resultLimit <= 0)
+        return limiterResults;
+
+    std::vector<std::pair<int, uint32_t>> candidates;
+    for(const auto& range : ficVotes)
+        for(const auto& fic : range.fics)
+            if(!fetchedFics.contains(fic.ficId))
+                candidates.push_back({fic.votes, fic.ficId});
+
+    auto ranksHigher = [](const std::pair<int, uint32_t>& left, const std::pair<int, uint32_t>& right){
+        if(left.first != right.first)
+            return left.first > right.first;
+        return left.second < right.second;
+    };
+    const auto limit = std::min(candidates.size(), static_cast<size_t>(resultLimit));
+    if(limit < candidates.size())
+        std::nth_element(candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(limit), candidates.end(), ranksHigher);
+
+    limiterResults.reserve(static_cast<int>(limit));
+    for(size_t i = 0; i < limit; i++)
+        limiterResults.insert(static_cast<int>(candidates[i].second));
     return limiterResults;
 }
 
+// calls visitor for every fic of every author that falls into the range
+// fics of a range are always visited in the order of authorVotes, whichever thread does it
+template <typename Visitor>
+void VisitRange(const std::vector<AuthorVote>& authorVotes, FicVoteAccumulator& range, Visitor visitor)
+{
+    for(const auto& authorVote : authorVotes)
+    {
+        if(!authorVote.fics)
+            continue;
+        auto it = authorVote.fics->begin();
+        const auto& end = authorVote.fics->end();
+        if(range.firstId > 0)
+            it.equalorlarger(range.firstId);
+        for(; it != end && *it <= range.lastId; ++it)
+            visitor(authorVote, range.ForFic(*it));
+    }
+}
+
+template <typename Visitor>
+void VisitAllRanges(const std::vector<AuthorVote>& authorVotes, std::vector<FicVoteAccumulator>& ranges, Visitor visitor)
+{
+    if(ranges.size() == 1)
+    {
+        VisitRange(authorVotes, ranges.front(), visitor);
+        return;
+    }
+    auto& scheduler = TaskScheduler::Instance();
+    scheduler.ParallelFor(scheduler.SplitEvenly(ranges.size()), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++)
+            VisitRange(authorVotes, ranges[i], visitor);
+    });
+}
+
+void RecCalculatorImplBase::PrepareVoteRanges()
+{
+    const auto& store = inputs.ficStore;
+    int threadsToUse = 1;
+    if(filteredAuthors.size() >= parallelVotingThreshold)
+        threadsToUse = TaskScheduler::Instance().ThreadCount() + 1;
+    const uint32_t rangeCount = std::max(1u, std::min(static_cast<uint32_t>(threadsToUse), store.Size()));
+    const uint32_t chunkSize = store.Size()/rangeCount;
+
+    ficVotes.resize(rangeCount);
+    for(uint32_t i = 0; i < rangeCount; i++)
+    {
+        const uint32_t begin = i*chunkSize;
+        const uint32_t end = i == rangeCount - 1 ? store.Size() : begin + chunkSize;
+        ficVotes[i].Init(&store, begin, end);
+    }
+}
 
 bool RecCalculatorImplBase::CollectVotes()
 {
-    auto weightingFunc = GetWeightingFunc();
-    auto authorSize = filteredAuthors.size();
     if(filteredAuthors.size() == 0)
         return false;
     qDebug() << "Max Matches:" <<  prevMaximumMatches;
-    std::for_each(filteredAuthors.cbegin(), filteredAuthors.cend(), [this](int author){
-        for(auto fic: inputs.faves[author])
-        {
-            result.recommendations[fic]+= 1;
-        }
+
+    // fics are accumulated in the order authors come in filteredAuthors
+    std::vector<AuthorVote> authorVotes;
+    authorVotes.reserve(static_cast<size_t>(filteredAuthors.size()));
+    for(auto author: std::as_const(filteredAuthors))
+    {
+        AuthorVote authorVote;
+        auto it = inputs.faves.find(author);
+        if(it != inputs.faves.cend())
+            authorVote.fics = &it.value();
+        authorVotes.push_back(authorVote);
+    }
+
+    // each range is only ever written by a single thread, no locking or merging needed
+    // and every fic sees its votes added in the same order as in a single threaded run
+    PrepareVoteRanges();
+    VisitAllRanges(authorVotes, ficVotes, [](const AuthorVote&, FicVotes& votes){
+        votes.pureVotes++;
     });
+    if(cancellation.IsCancelled())
+        return false;
+
     int maxValue = 0;
     int maxId = -1;
+    for(const auto& range : ficVotes)
+    {
+        for(const auto& fic : range.fics)
+        {
+            if(fic.pureVotes > maxValue || (fic.pureVotes == maxValue && maxId != -1 && static_cast<int>(fic.ficId) < maxId))
+            {
+                maxValue = fic.pureVotes;
+                maxId = static_cast<int>(fic.ficId);
+            }
+        }
+    }
 
     uint32_t negativeSum = 0;
     for(auto author: std::as_const(filteredAuthors))
         negativeSum+=allAuthors[author].negativeMatches;
     negativeAverage = negativeSum/filteredAuthors.size();
 
-    auto it = result.recommendations.cbegin();
-    while(it != result.recommendations.cend())
-    {
-        if(it.value() > maxValue )
-        {
-            maxValue = it.value();
-            maxId = it.key();
-        }
-        result.pureMatches[it.key()] = it.value();
-        it++;
-    }
     qDebug() << "Max pure votes: " << maxValue;
     qDebug() << "Max id: " << maxId;
-    result.recommendations.clear();
     uint32_t negativeMatchCutoff = negativeAverage/3;
 
-    std::for_each(filteredAuthors.cbegin(), filteredAuthors.cend(), [maxValue,weightingFunc, authorSize, this, negativeMatchCutoff](int author){
-        for(auto fic: inputs.faves[author])
-        {
-            result.sumNegativeMatchesForFic[fic] += allAuthors[author].negativeMatches;
-            auto weighting = weightingFunc(allAuthors[author],authorSize, maxValue );
-            double matchCountSimilarityCoef = weighting.GetCoefficient();
-            if(allAuthors[author].negativeMatches <= negativeMatchCutoff)
-                result.sumNegativeVotesForFic[fic]++;
-
-
-            double vote = votesBase;
-
-            //std::optional<double> neutralMoodSimilarity = GetNeutralDiffForLists(author);
-
-            std::optional<double> touchyMoodSimilarity = GetTouchyDiffForLists(author);
-            double moodCoef  = 1;
-            if(touchyMoodSimilarity.has_value())
-            {
-
-                if(weighting.authorType == core::AuthorWeightingResult::EAuthorType::rare ||
-                        weighting.authorType == core::AuthorWeightingResult::EAuthorType::unique)
-                    moodCoef = GetCoeffForTouchyDiff(touchyMoodSimilarity.value(), false);
-                else
-                    moodCoef = GetCoeffForTouchyDiff(touchyMoodSimilarity.value());
-
-                if(moodCoef > 0.99)
-                    result.decentMatches[fic] = 1;
-                //                if(author == 77257)
-                //                    qDebug() << "similarity coef for author: " << 77257 << "is: " << coef;
-            }
-            vote = (votesBase + matchCountSimilarityCoef)*moodCoef;
-            if(doTrashCounting &&  ownMajorNegatives.cardinality() > startOfTrashCounting){
-                if(allAuthors[author].negativeToPositiveMatches > 1.5){
-                    vote = 0;
-                }
-                else if(allAuthors[author].negativeToPositiveMatches > (averageNegativeToPositiveMatches*2))
-                {
-                    vote = vote / (1 + (allAuthors[author].negativeToPositiveMatches - averageNegativeToPositiveMatches));
-                    //if(allAuthors[author].negativeToPositiveMatches > averageNegativeToPositiveMatches*2)
-                        //QLOG_INFO() << "reducing vote for fic: " << fic << "from: " << originalVote << " to: " << vote;
-                }
-                else if(allAuthors[author].negativeToPositiveMatches < (averageNegativeToPositiveMatches - averageNegativeToPositiveMatches/2.)){
-                    vote = vote * (1 + (averageNegativeToPositiveMatches - allAuthors[author].negativeToPositiveMatches)*3);
-                    //QLOG_INFO() << "increasing vote for fic: " << fic << "from: " << originalVote << " to: " << vote;
-                }
-                else if(allAuthors[author].negativeToPositiveMatches < (averageNegativeToPositiveMatches - averageNegativeToPositiveMatches/3.))
-                    vote = vote * (1 + ((averageNegativeToPositiveMatches - averageNegativeToPositiveMatches/3.) - allAuthors[author].negativeToPositiveMatches));
-
-//                else if(allAuthors[author].negativeToPositiveMatches < (averageNegativeToPositiveMatches))
-//                    vote = vote * (1 + (averageNegativeToPositiveMatches - allAuthors[author].negativeToPositiveMatches));
-            }
-
-            result.recommendations[fic]+= vote;
-            result.AddToBreakdown(fic, weighting.authorType, 1+weighting.GetCoefficient());
-        }
+    // everything a vote depends on is a property of the author, it's computed once per author instead of once per fic
+    WeighAuthorVotes(authorVotes, maxValue, negativeMatchCutoff);
+
+    VisitAllRanges(authorVotes, ficVotes, [](const AuthorVote& authorVote, FicVotes& votes){
+        const auto type = static_cast<size_t>(authorVote.type);
+        votes.negativeMatches += authorVote.negativeMatches;
+        if(authorVote.countsAsNegativeVote)
+            votes.negativeVotes++;
+        if(authorVote.decent)
+            votes.decent = true;
+        // votes are kept as integers, same as they always were
+        votes.votes = static_cast<int>(votes.votes + authorVote.vote);
+        votes.typeCounts[type]++;
+        votes.typeVotes[type] += authorVote.breakdownVote;
     });
 
-
+    WriteVotesIntoResult();
     if(params->resultLimit != 0){
-        result.limitedResults = LimitResults(params,result, fetchedFics);
+        result.limitedResults = LimitResults(params->resultLimit, ficVotes, fetchedFics);
     }
 
     return true;
 }
 
-AutoAdjustmentAndFilteringResult RecCalculatorImplBase::AutoAdjustRecommendationParamsAndFilter(QSharedPointer<RecommendationList> params)
+void RecCalculatorImplBase::WeighAuthorVotes(std::vector<AuthorVote>& authorVotes, int maxValue, uint32_t negativeMatchCutoff)
 {
-    AutoAdjustmentAndFilteringResult result;
-    // if the options were supplied manually, we just return what we got
-    if(!params->isAutomatic && !params->adjusting)
-        return result;
-    // else we try to adjust minimum mathes so that a set of conditionsa re met
-    // 1) for the average of 3 numbers we take a differnece between it and the middle one
-    //    divide by the middle one and check to see if it's >0.05
-    // 2) only apply this if average of 3 is > 70
+    WeighAuthors(authorVotes, maxValue, negativeMatchCutoff, GetWeightingFunc());
+}
 
+void RecCalculatorImplBase::FillAuthorVote(AuthorVote& authorVote, int author, const AuthorResult& authorData,
+                                           AuthorWeightingResult weighting, uint32_t negativeMatchCutoff)
+{
+    authorVote.negativeMatches = authorData.negativeMatches;
+    authorVote.countsAsNegativeVote = authorData.negativeMatches <= negativeMatchCutoff;
+    double matchCountSimilarityCoef = weighting.GetCoefficient();
 
-    // first we need to prepare the dataset
-    QMap<int, QList<int>> authorsByMatches;
-    int totalMatches = 0;
-    for(auto author : std::as_const(filteredAuthors))
+    //std::optional<double> neutralMoodSimilarity = GetNeutralDiffForLists(author);
+
+    const bool rareAuthor = weighting.authorType == core::AuthorWeightingResult::EAuthorType::rare ||
+            weighting.authorType == core::AuthorWeightingResult::EAuthorType::unique;
+    double moodCoef  = 1;
+    if(!moodWeights.empty())
     {
-        authorsByMatches[allAuthors[author].matches].push_back(allAuthors[author].id);
-        totalMatches++;
+        // same as the GetTouchyDiffForLists branch, authors without a mood row are neither weighted nor decent
+        const auto ordinal = inputs.authorOrdinals.OrdinalFor(author);
+        if(ordinal < moodWeights.size() && inputs.moods.HasMoods(ordinal))
+        {
+            moodCoef = rareAuthor ? std::max(moodWeights[ordinal], 1.) : moodWeights[ordinal];
+            if(moodCoef > 0.99)
+                authorVote.decent = true;
+        }
     }
-    //QLOG_INFO() << "authorsByMatches: " << authorsByMatches;
-    // then we go through matches calculating averages and checking that conditions are satisfied
-
-    // this will tell us where cutoff happened
-    // if it's 2, then we need to take a look if we need to _relax_ settings, not tighten them
-    int stoppingIndex = -1;
-    QList<int> matches = authorsByMatches.keys();
-    QLOG_INFO() << "Keys used: " << matches;
-    QLOG_INFO() << "matches count is: " << matches.count();
-    //QLOG_INFO() << "total matches: " << totalMatches;
-    auto matchCountPreIndex = [&](int externalIndex){
-        int sum = 0;
-        for(int index = 0; index <= externalIndex && index < matches.size(); index++){
-            sum+=authorsByMatches[matches[index]].count();
+    else
+    {
+        std::optional<double> touchyMoodSimilarity = GetTouchyDiffForLists(author);
+        // only authors whose moods are known can make a fic a decent match
+        if(touchyMoodSimilarity.has_value())
+        {
+            moodCoef = GetCoeffForTouchyDiff(touchyMoodSimilarity.value(), !rareAuthor);
+            if(moodCoef > 0.99)
+                authorVote.decent = true;
         }
-        //QLOG_INFO() << "Matches left: " << totalMatches - sum;
-        return totalMatches - sum;
-
-    };
+    }
+    double vote = (votesBase + matchCountSimilarityCoef)*moodCoef;
+    if(doTrashCounting &&  ownMajorNegatives.cardinality() > startOfTrashCounting){
+        if(authorData.negativeToPositiveMatches > 1.5){
+            vote = 0;
+        }
+        else if(authorData.negativeToPositiveMatches > (averageNegativeToPositiveMatches*2))
+        {
+            vote = vote / (1 + (authorData.negativeToPositiveMatches - averageNegativeToPositiveMatches));
+        }
+        else if(authorData.negativeToPositiveMatches < (averageNegativeToPositiveMatches - averageNegativeToPositiveMatches/2.)){
+            vote = vote * (1 + (averageNegativeToPositiveMatches - authorData.negativeToPositiveMatches)*3);
+        }
+        else if(authorData.negativeToPositiveMatches < (averageNegativeToPositiveMatches - averageNegativeToPositiveMatches/3.))
+            vote = vote * (1 + ((averageNegativeToPositiveMatches - averageNegativeToPositiveMatches/3.) - authorData.negativeToPositiveMatches));
+    }
+    authorVote.vote = vote;
+    authorVote.type = weighting.authorType;
+    authorVote.breakdownVote = 1+weighting.GetCoefficient();
+}
 
-    if(matches.size() && matches.last() >= params->maxUnmatchedPerMatch/2)
+void RecCalculatorImplBase::WriteVotesIntoResult()
+{
+    int ficCount = 0;
+    for(const auto& range : ficVotes)
+        ficCount += static_cast<int>(range.fics.size());
+    result.recommendations.reserve(ficCount);
+    result.pureMatches.reserve(ficCount);
+    result.sumNegativeMatchesForFic.reserve(ficCount);
+    result.breakdowns.reserve(ficCount);
+    for(const auto& range : ficVotes)
     {
-        for(int i = 0; i < matches.count() - 2; i ++){
-            if(i > 0)
-                result.adjustmentStoppedAtFirstIteration = false;
-
-            QLOG_INFO() << "starting processing of: " << i;
-            int firstCount = authorsByMatches[matches[i]].count();
-            int secondCount = authorsByMatches[matches[i+1]].count();
-            int thirdCount = authorsByMatches[matches[i+2]].count();
-            QLOG_INFO() << firstCount << secondCount << thirdCount;
-            result.sizes[0] = firstCount;
-            result.sizes[1] = secondCount;
-            result.sizes[2] = thirdCount;
-            double average = static_cast<double>(firstCount + secondCount + thirdCount)/3.;
-            //QLOG_INFO() << "average is: " << average;
-
-            if(i == 0 && average < 70)
-            {
-                stoppingIndex = 0;
-                break;
-            }
-            if(static_cast<float>(matchCountPreIndex(i+2))/static_cast<float>(totalMatches) < 0.1f)
-            {
-                stoppingIndex = i;
-                break;
-            }
-            double relative = std::abs((static_cast<double>(secondCount) - average)/static_cast<double>(secondCount));
-            QLOG_INFO() << "relative is: " << relative;
-            //QLOG_INFO() << " first condition: " << (thirdCount - firstCount)/2. << " second condition: " <<  secondCount/5.;
-            if(relative > 0.05 && (std::abs(firstCount - thirdCount)) < 30 && stoppingIndex < 0)
+        for(const auto& fic : range.fics)
+        {
+            const int id = static_cast<int>(fic.ficId);
+            result.pureMatches[id] = fic.pureVotes;
+            result.recommendations[id] = fic.votes;
+            result.sumNegativeMatchesForFic[id] = fic.negativeMatches;
+            if(fic.negativeVotes > 0)
+                result.sumNegativeVotesForFic[id] = fic.negativeVotes;
+            if(fic.decent)
+                result.decentMatches[id] = 1;
+            auto& breakdown = result.breakdowns[fic.ficId];
+            breakdown.ficId = fic.ficId;
+            for(size_t type = 0; type < fic.typeCounts.size(); type++)
             {
-                QLOG_INFO() << "relative bigger than threshhold, stopping: " << relative;
-                stoppingIndex = i;
-
+                if(fic.typeCounts[type] == 0)
+                    continue;
+                breakdown.AddAuthorResult(static_cast<AuthorWeightingResult::EAuthorType>(type),
+                                          fic.typeCounts[type], fic.typeVotes[type]);
             }
         }
     }
-    stoppingIndex = stoppingIndex < 0 ? 0 : stoppingIndex;
-    QLOG_INFO() << "Adjustment stopped at: " << stoppingIndex;
-    //QHash<int, AuthorResult> result;
-    result.performedFiltering = true;
-    params->minimumMatch = matches[stoppingIndex];
-
-    if(params->minimumMatch > 20)
-        params->minimumMatch = 20;
-    for(auto matchCount : std::as_const(matches)){
-        if(matchCount < params->minimumMatch)
-        {
-            //QLOG_INFO() << "discarding match count: " << matchCount;
-            continue;
-        }
-        //QLOG_INFO() << "adding authors for match count: " << matchCount << " amount:" << authorsByMatches[matchCount].size();
-        result.authors += QSet<int>(authorsByMatches[matchCount].cbegin(), authorsByMatches[matchCount].cend());
-    }
-    return result;
 }
 
 void RecCalculatorImplBase::AdjustRatioForAutomaticParams()
@@ -465,101 +396,64 @@ void RecCalculatorImplBase::AdjustRatioForAutomaticParams()
     // intentionally does nothing
 }
 
-bool RecCalculatorImplBase::AdjustParamsToHaveExceptionalLists(QSharedPointer<RecommendationList> params, const AutoAdjustmentAndFilteringResult& adjustmentResult)
+Roaring RecCalculatorImplBase::BuildIgnoreList()
 {
-    int dropMinimum = 1;
-    int dropRatio = 1;
-    auto stopAdjusting = [&](){
-        params->isAutomatic = false;
-        params->adjusting = false;
-        return false;
-    };
-    if(adjustmentResult.adjustmentStoppedAtFirstIteration && adjustmentResult.sizes[2]*6 > params->maxUnmatchedPerMatch)
-        return stopAdjusting();
-    if(params->minimumMatch-dropMinimum < 10 && params->maxUnmatchedPerMatch - dropRatio <= 10)
-        return stopAdjusting();
-    if(params->minimumMatch-dropMinimum < 10 && params->maxUnmatchedPerMatch-dropRatio <= 10)
-    {
-        // we've failed to find exceptional lists, better to just fall back to higher ratio
-        //params->maxUnmatchedPerMatch*=2;
-        return stopAdjusting();
-    }
-
-    if(params->maxUnmatchedPerMatch-dropRatio < 10 && params->minimumMatch == 20)
-    {
-        // we've failed to find exceptional lists, better to just fall back to higher ratio
-        //params->maxUnmatchedPerMatch*=2;
-        return stopAdjusting();
-    }
-
-    bool canDropRatio = params->maxUnmatchedPerMatch-dropRatio > 10;
-    bool canDropMin = params->minimumMatch-dropMinimum > 10;
-    if(canDropRatio  || canDropMin ){
-        if(canDropRatio)
-            params->maxUnmatchedPerMatch-=dropRatio;
-        if(canDropMin )
-            params->minimumMatch-=dropMinimum;
-        params->isAutomatic = false;
-        params->adjusting = true;
-        QLOG_INFO() << "params after adjustment: " <<  params->minimumMatch << " " << params->maxUnmatchedPerMatch;
-        return true;
-    }
-
-    return stopAdjusting();
+    return ExcludeFromIgnores(BuildBaseIgnoreList());
 }
 
-
-Roaring RecCalculatorImplBase::BuildIgnoreList()
+Roaring RecCalculatorImplBase::BuildBaseIgnoreList()
 {
     QLOG_INFO() << "Building ignore list";
     QLOG_INFO() << "Ignored fics size:" << params->ignoredDeadFics.size();
+    const auto& store = inputs.ficStore;
     Roaring fullIgnores;
-    auto ficKeys = inputs.fics.keys();
-
-    auto worker = [&](const std::pair<QList<int>::const_iterator,QList<int>::const_iterator>& beginEnd){
-            auto itCurrent = beginEnd.first;
-            auto itEnd= beginEnd.second;
-            Roaring ignores;
-            while(itCurrent < itEnd)
-            {
-                auto& fic = inputs.fics[*itCurrent];
-                itCurrent++;
 
-                if(!fic)
-                    continue;
-
-                bool inIgnored = false;
-                // we don't ignore fics that are soruces for the recommednation list
-                if(params->ficData->sourceFics.contains(fic->id))
-                    continue;
+    // the fics that were maked as "Limbo"
+    for(auto fic: std::as_const(params->ignoredDeadFics))
+        if(store.Contains(static_cast<uint32_t>(fic)))
+            fullIgnores.add(static_cast<uint32_t>(fic));
 
-                // we don't ignore fics that user pressed negative tag on for weighting
-                if(params->majorNegativeVotes.contains(fic->id))
-                    continue;
+    Roaring ignoredFandoms;
+    for(auto fandom: std::as_const(params->ignoredFandoms))
+        if(fandom >= 1)
+            ignoredFandoms.add(static_cast<uint32_t>(fandom));
 
-                // the fics that were maked as "Limbo"
-                if(params->ignoredDeadFics.contains(fic->id))
-                    inIgnored = true;
-
-                for(auto fandom: std::as_const(fic->fandoms))
-                {
-                    if(params->ignoredFandoms.contains(fandom) && fandom >= 1)
-                        inIgnored = true;
-                }
-                if(inIgnored)
-                    ignores.add(fic->id);
+    if(!ignoredFandoms.isEmpty())
+    {
+        // fandom columns are scanned in contiguous ordinal ranges
+        auto& scheduler = TaskScheduler::Instance();
+        auto worker = [&](size_t begin, size_t end){
+            Roaring ignores;
+            for(size_t ordinal = begin; ordinal < end; ordinal++)
+            {
+                const auto fandom1 = store.fandom1[ordinal];
+                const auto fandom2 = store.fandom2[ordinal];
+                if((fandom1 >= 1 && ignoredFandoms.contains(static_cast<uint32_t>(fandom1)))
+                        || (fandom2 >= 1 && ignoredFandoms.contains(static_cast<uint32_t>(fandom2))))
+                    ignores.add(store.ids[ordinal]);
             }
-            QLOG_INFO() << "returning ignored fics of size: " << ignores.cardinality();
             return ignores;
         };
-
-    threadedIntListProcessor("Creation of ignore list", QThread::idealThreadCount() - 3,ficKeys,  worker, [&fullIgnores](const Roaring& data){
-        fullIgnores= fullIgnores | data;
-    });
-    QLOG_INFO() << "fanfic ignore list is of size: " << fullIgnores.cardinality();
+        TimedAction task("Creation of ignore list",[&](){
+            fullIgnores |= scheduler.ParallelReduce(scheduler.SplitEvenly(store.Size(), 4096), Roaring(), worker,
+                                                    [](Roaring& result, Roaring&& partial){result |= partial;});
+        });
+        task.run();
+    }
     return fullIgnores;
+}
 
+Roaring RecCalculatorImplBase::ExcludeFromIgnores(Roaring fullIgnores) const
+{
+    // we don't ignore fics that are soruces for the recommednation list
+    for(auto fic: std::as_const(params->ficData->sourceFics))
+        fullIgnores.remove(static_cast<uint32_t>(fic));
+    // we don't ignore fics that user pressed negative tag on for weighting
+    for(auto fic: std::as_const(params->majorNegativeVotes))
+        fullIgnores.remove(static_cast<uint32_t>(fic));
 
+    QLOG_INFO() << "fanfic ignore list is of size: " << fullIgnores.cardinality();
+    return fullIgnores;
 }
 
 //struct RatioHash{
@@ -575,13 +469,6 @@ Roaring RecCalculatorImplBase::BuildIgnoreList()
 //    QReadWriteLock lock;
 //};
 
-struct AuthorRelationsResult{
-    uint maximumMatches = 0;
-    uint matchSum = 0;
-    std::vector<int> matchCounts;
-    QMap<uint32_t, RatioInfo> ratioInfo;
-    QMap<uint32_t, RatioSumInfo> ratioSumInfo;
-};
 template <typename T>
 void Save( const QMap<uint32_t, T>& data )
 {
@@ -601,152 +488,276 @@ void Save( const QMap<uint32_t, T>& data )
 }
 
 
+QList<int> RecCalculatorImplBase::CollectCandidateRecommenders() const
+{
+    // only recommenders that share at least one fic with the user can get matches
+    // everyone else would be discarded by the filters anyway
+    // falling back to the full list if the index wasn't built for this data
+    if(inputs.recommendersForFics.isEmpty())
+        return inputs.faves.keys();
+
+    QVector<const Roaring*> recommenderLists;
+    recommenderLists.reserve(ownFavourites.cardinality() + ownMajorNegatives.cardinality());
+    auto collector = [&](const Roaring& fics){
+        for(auto fic : fics)
+        {
+            auto it = inputs.recommendersForFics.find(fic);
+            if(it != inputs.recommendersForFics.cend())
+                recommenderLists.push_back(&it.value());
+        }
+    };
+    collector(ownFavourites);
+    collector(ownMajorNegatives);
+
+    QList<int> result;
+    if(recommenderLists.isEmpty())
+        return result;
+
+    Roaring candidates = Roaring::fastunion(recommenderLists.size(), recommenderLists.data());
+    result.reserve(candidates.cardinality());
+    for(auto author : candidates)
+        result.push_back(static_cast<int>(author));
+    return result;
+}
+
 void RecCalculatorImplBase::FetchAuthorRelations()
 {
     qDebug() << "faves is of size: " << inputs.faves.size();
-    allAuthors.clear();
-    std::vector<AuthorResult> tempAuthors;
-    tempAuthors.resize(inputs.faves.size());
+    allAuthors.Reset();
     ownFavourites = {};
     maximumMatches = 0;
     matchSum = 0;
-    Roaring ignores = BuildIgnoreList();
 
     for(auto i = fetchedFics.cbegin(); i != fetchedFics.cend(); i++)
         ownFavourites.add(i.key());
 
-    qDebug() << "finished creating roaring";
     QLOG_INFO() << "user's FFN id: " << params->userFFNId;
-
     ownProfileId = params->userFFNId;
-    maximumMatches = params->minimumMatch;
-    AuthorRelationsResult funcResult;
-    //RatioHash ratioHash;
-    TimedAction action("Relations Creation",[&](){
-        auto worker = [&](const std::tuple<QList<int>::const_iterator,QList<int>::const_iterator,QList<int>::const_iterator>& iterators){
-            AuthorRelationsResult tempResult;
-            tempResult.maximumMatches = params->minimumMatch;
-            auto itCurrent = std::get<1>(iterators);
-            auto itEnd= std::get<2>(iterators);
-            auto rangeBegin = std::get<0>(iterators);
-            while(itCurrent < itEnd)
-            {
-                auto& author = tempAuthors[itCurrent-rangeBegin];
-                author.id = *itCurrent;
-                if(ownProfileId == author.id)
-                {
-                    itCurrent++;
-                    continue;
-                }
-
-                const auto& tempAuthorRoaring = std::as_const(inputs.faves)[author.id];
-                author.fullListSize = tempAuthorRoaring.cardinality();
-                const uint ignoredFics = tempAuthorRoaring.and_cardinality(ignores);
-                const auto unignoredSize = tempAuthorRoaring.cardinality() - ignoredFics;
-
-                // first we need to remove ignored fics
-                //auto unignoredSize = inputs.faves[author.id].xor_cardinality(ignoredTemp);
-                //Roaring temp = tempAuthorRoaring.operator&(ownFavourites);
-                author.matches = tempAuthorRoaring.and_cardinality(ownFavourites);
-                author.negativeMatches = tempAuthorRoaring.and_cardinality(ownMajorNegatives);
-                if(author.matches > 10 && static_cast<double>(author.negativeMatches)/static_cast<double>(author.matches) > 1.5)
-                    author.matches = 0;
-                if(author.fullListSize > 10 && author.matches < 2 && ownFavourites.cardinality() > 5)
-                    author.matches = 0;
-                author.sizeAfterIgnore = unignoredSize;
-
-                // not interested with lists that don't add anything new
-                // also not very interested with listsizes of less than 10 because their ratio will be too skewed
-                if(author.matches > 0){
-                    const auto ratio = author.sizeAfterIgnore/author.matches;
-                    if(ratio <= 1 || author.sizeAfterIgnore < 10){
-                        itCurrent++;
-                        continue;
-                    }
-                    author.ratio = ratio;
-                    //ratioHash.AddToken(ratio);
-                    auto& ratioObject = tempResult.ratioInfo[ratio];
-                    ratioObject.ratio = ratio;
-                    ratioObject.authors++;
-                    if(ratioObject.minMatches > author.matches)
-                        ratioObject.minMatches = author.matches;
-                    //ratioObject.fics|=tempAuthorRoaring;
-                    ratioObject.ficsAfterIgnore|=tempAuthorRoaring.operator-(ignores);
-
-                    if(ratioObject.minListSize > author.sizeAfterIgnore)
-                        ratioObject.minListSize = author.sizeAfterIgnore;
-                    if(ratioObject.maxListSize < author.sizeAfterIgnore)
-                        ratioObject.maxListSize = author.sizeAfterIgnore;
-                    if(tempResult.maximumMatches < author.matches)
-                    {
-                        prevMaximumMatches = tempResult.maximumMatches;
-                        tempResult.maximumMatches = author.matches;
-                    }
-                    tempResult.matchSum+=author.matches;
-                    tempResult.matchCounts.push_back(author.matches);
-                }
-                itCurrent++;
-            }
-            return tempResult;
-        };
+    // recounting only the changed recommenders needs to know who has the changed fics
+    bool updated = false;
+    if(relationsState && !inputs.recommendersForFics.isEmpty())
+    {
+        TimedAction action("Updating author relations",[&](){
+            updated = UpdateAuthorRelations();
+        });
+        action.run();
+    }
+    if(!updated)
+        CountAuthorRelations();
+    if(cancellation.IsCancelled())
+    {
+        QLOG_INFO() << "Calculation cancelled while fetching author relations";
+        return;
+    }
+    SummarizeAuthorRelations();
+}
 
+AuthorRelationCounts RecCalculatorImplBase::CountAuthorRelation(uint32_t authorId, const Roaring& ignores) const
+{
+    static const Roaring noFavourites;
+    const auto authorOrdinal = inputs.authorOrdinals.OrdinalFor(static_cast<int>(authorId));
+    const Roaring& authorFavourites = authorOrdinal != AuthorOrdinals::invalidOrdinal ? *inputs.authorOrdinals.favourites[authorOrdinal] : noFavourites;
+    AuthorRelationCounts result;
+    result.authorId = authorId;
+    // all of the counts in a single pass over the containers of the list
+    result.overlap = CalcListOverlap(authorFavourites, ignores, ownFavourites, ownMajorNegatives);
+    return result;
+}
 
-        threadedIntListTupleProcessor("Creation of author relations", QThread::idealThreadCount() - 3,inputs.faves.keys(),  worker, [&funcResult](AuthorRelationsResult&& data){
-            if(funcResult.maximumMatches < data.maximumMatches)
-                funcResult.maximumMatches = data.maximumMatches;
-            funcResult.matchSum+=data.matchSum;
-            if(funcResult.matchCounts.size()>data.matchCounts.size()) {
-                funcResult.matchCounts.insert(funcResult.matchCounts.end(),data.matchCounts.begin(),data.matchCounts.end());
-            } else {
-                data.matchCounts.insert(data.matchCounts.end(),funcResult.matchCounts.begin(),funcResult.matchCounts.end());
-                funcResult.matchCounts = data.matchCounts;
-            }
+void RecCalculatorImplBase::CountAuthorRelations()
+{
+    relationsState = QSharedPointer<AuthorRelationsState>::create();
+    auto& state = *relationsState;
+    state.userFFNId = params->userFFNId;
+    state.ignoredFandoms = params->ignoredFandoms;
+    state.ignoredDeadFics = params->ignoredDeadFics;
+    state.baseIgnores = BuildBaseIgnoreList();
+    state.ignores = ExcludeFromIgnores(state.baseIgnores);
+    state.favourites = ownFavourites;
+    state.negatives = ownMajorNegatives;
 
-            for(auto i = data.ratioInfo.cbegin(); i != data.ratioInfo.cend(); i++){
-                funcResult.ratioInfo[i.key()]+=i.value();
+    qDebug() << "finished creating roaring";
+    state.sketchContainment = params->sketchContainment;
+    const bool useSketches = params->sketchContainment > 0 && !inputs.recommenderSketches.IsEmpty();
+    const auto candidateRecommenders = useSketches
+            ? inputs.recommenderSketches.Candidates(ownFavourites, params->sketchContainment, inputs.authorOrdinals)
+            : CollectCandidateRecommenders();
+    QLOG_INFO() << "candidate recommenders: " << candidateRecommenders.size();
+    state.usesSketches = useSketches;
+    if(useSketches)
+        for(auto author : candidateRecommenders)
+            state.sketchCandidates.add(static_cast<uint32_t>(author));
+    // every task writes into its own part of the vector
+    std::vector<AuthorRelationCounts> counts(static_cast<size_t>(candidateRecommenders.size()));
+    auto& scheduler = TaskScheduler::Instance();
+    // the cost of a recommender is the size of their list, prolific ones would otherwise pile up in a single chunk
+    const auto ranges = scheduler.SplitByCost(counts.size(), [&](size_t index) -> uint64_t{
+        const auto ordinal = inputs.authorOrdinals.OrdinalFor(candidateRecommenders[static_cast<int>(index)]);
+        return ordinal != AuthorOrdinals::invalidOrdinal ? inputs.authorOrdinals.favourites[ordinal]->cardinality() : 0;
+    });
+    TimedAction task("Creation of author relations",[&](){
+        scheduler.ParallelFor(ranges, [&](size_t begin, size_t end){
+            for(size_t index = begin; index < end; index++)
+            {
+                // the rest of the chunks still get picked up but return right away
+                if((index - begin) % 64 == 0 && cancellation.IsCancelled())
+                    return;
+                const auto author = candidateRecommenders[static_cast<int>(index)];
+                if(author != ownProfileId)
+                    counts[index] = CountAuthorRelation(static_cast<uint32_t>(author), state.ignores);
             }
         });
     });
-    action.run();
+    task.run();
+    if(cancellation.IsCancelled())
+    {
+        // partially counted relations can't be reused by the next request of the session
+        relationsState.reset();
+        return;
+    }
+
+    // candidates come from a roaring so they are already sorted by id
+    state.authors.reserve(counts.size());
+    for(const auto& author : counts)
+        if(author.overlap.matches > 0 || author.overlap.negativeMatches > 0)
+            state.authors.push_back(author);
+}
+
+bool RecCalculatorImplBase::UpdateAuthorRelations()
+{
+    auto& state = *relationsState;
+    const bool useSketches = params->sketchContainment > 0 && !inputs.recommenderSketches.IsEmpty();
+    // the state was counted over a different candidate set
+    if(useSketches != state.usesSketches)
+        return false;
+    Roaring ignores = ExcludeFromIgnores(state.baseIgnores);
+    // fics that entered or left any of the lists, only recommenders that have them can get different counts
+    Roaring changedFics = (ownFavourites ^ state.favourites) | (ownMajorNegatives ^ state.negatives) | (ignores ^ state.ignores);
+    QVector<const Roaring*> recommenderLists;
+    for(auto fic : changedFics)
+    {
+        auto it = inputs.recommendersForFics.find(fic);
+        if(it != inputs.recommendersForFics.cend())
+            recommenderLists.push_back(&it.value());
+    }
+    Roaring authorsToCount = recommenderLists.isEmpty() ? Roaring() : Roaring::fastunion(recommenderLists.size(), recommenderLists.data());
+    Roaring sketchCandidates;
+    if(useSketches)
+    {
+        // a fresh calculation would only count the recommenders the sketches pick for the new favourites
+        // the ones that weren't picked before haven't been counted at all, whether their fics changed or not
+        for(auto author : inputs.recommenderSketches.Candidates(ownFavourites, params->sketchContainment, inputs.authorOrdinals))
+            sketchCandidates.add(static_cast<uint32_t>(author));
+        authorsToCount &= sketchCandidates;
+        authorsToCount |= sketchCandidates - state.sketchCandidates;
+    }
+    QLOG_INFO() << "changed fics:" << changedFics.cardinality() << "recommenders to recount:" << authorsToCount.cardinality() << "of:" << state.authors.size();
+    // a full count is cheaper once a big part of the candidates has to be recounted anyway
+    if(authorsToCount.cardinality() > state.authors.size()/2)
+        return false;
+
+    // counted before the state is touched so that a cancelled update leaves nothing half done
+    std::vector<AuthorRelationCounts> counts;
+    counts.reserve(authorsToCount.cardinality());
+    for(auto authorId : authorsToCount)
+    {
+        if(counts.size() % 64 == 0 && cancellation.IsCancelled())
+        {
+            relationsState.reset();
+            return true;
+        }
+        if(static_cast<int>(authorId) != ownProfileId)
+            counts.push_back(CountAuthorRelation(authorId, ignores));
+    }
+
+    state.ignores = ignores;
+    state.favourites = ownFavourites;
+    state.negatives = ownMajorNegatives;
+    if(useSketches)
+    {
+        // recommenders the sketches don't pick anymore aren't candidates of a fresh calculation either
+        state.authors.erase(std::remove_if(state.authors.begin(), state.authors.end(), [&](const AuthorRelationCounts& author){
+            return !sketchCandidates.contains(author.authorId);
+        }), state.authors.end());
+        state.sketchCandidates = std::move(sketchCandidates);
+    }
+
+    auto byId = [](const AuthorRelationCounts& author, uint32_t authorId){return author.authorId < authorId;};
+    std::vector<AuthorRelationCounts> newAuthors;
+    for(const auto& author : counts)
+    {
+        auto it = std::lower_bound(state.authors.begin(), state.authors.end(), author.authorId, byId);
+        if(it != state.authors.end() && it->authorId == author.authorId)
+            *it = author;
+        else if(author.overlap.matches > 0 || author.overlap.negativeMatches > 0)
+            newAuthors.push_back(author);
+    }
+    // authors that don't share anything with the user anymore stop being candidates
+    state.authors.erase(std::remove_if(state.authors.begin(), state.authors.end(), [](const AuthorRelationCounts& author){
+        return author.overlap.matches == 0 && author.overlap.negativeMatches == 0;
+    }), state.authors.end());
+    const auto oldSize = state.authors.size();
+    state.authors.insert(state.authors.end(), newAuthors.begin(), newAuthors.end());
+    std::inplace_merge(state.authors.begin(), state.authors.begin() + static_cast<std::ptrdiff_t>(oldSize), state.authors.end(),
+                       [](const AuthorRelationCounts& left, const AuthorRelationCounts& right){return left.authorId < right.authorId;});
+    return true;
+}
 
-    for(auto&& author: tempAuthors){
-        auto id = author.id;
-        allAuthors.emplace(std::move(id),std::move(author));
+void RecCalculatorImplBase::SummarizeAuthorRelations()
+{
+    const auto& state = *relationsState;
+    static const Roaring noFavourites;
+    maximumMatches = state.authors.empty() ? 0 : static_cast<uint32_t>(params->minimumMatch);
+    matchSum = 0;
+    uint32_t matchedAuthors = 0;
+    const auto ownFavouritesSize = ownFavourites.cardinality();
+    // favourites of the matched authors by ratio, ascending
+    QMap<uint32_t, QVector<const Roaring*>> listsByRatio;
+    for(const auto& relation : state.authors)
+    {
+        auto& author = allAuthors[static_cast<int>(relation.authorId)];
+        author.id = relation.authorId;
+        author.fullListSize = relation.overlap.size;
+        author.matches = relation.overlap.matches;
+        author.negativeMatches = relation.overlap.negativeMatches;
+        if(author.matches > 10 && static_cast<double>(author.negativeMatches)/static_cast<double>(author.matches) > 1.5)
+            author.matches = 0;
+        if(author.fullListSize > 10 && author.matches < 2 && ownFavouritesSize > 5)
+            author.matches = 0;
+        author.sizeAfterIgnore = relation.overlap.size - relation.overlap.ignored;
+
+        // not interested with lists that don't add anything new
+        // also not very interested with listsizes of less than 10 because their ratio will be too skewed
+        if(author.matches == 0)
+            continue;
+        const auto ratio = author.sizeAfterIgnore/author.matches;
+        if(ratio <= 1 || author.sizeAfterIgnore < 10)
+            continue;
+        author.ratio = ratio;
+        const auto authorOrdinal = inputs.authorOrdinals.OrdinalFor(static_cast<int>(author.id));
+        listsByRatio[ratio].push_back(authorOrdinal != AuthorOrdinals::invalidOrdinal ? inputs.authorOrdinals.favourites[authorOrdinal] : &noFavourites);
+        if(maximumMatches < author.matches)
+        {
+            prevMaximumMatches = maximumMatches;
+            maximumMatches = author.matches;
+        }
+        matchSum += author.matches;
+        matchedAuthors++;
     }
-    matchSum = funcResult.matchSum;
-    maximumMatches = funcResult.maximumMatches;
-    RatioSumInfo tempSummary;
 
-    auto result = std::accumulate(funcResult.matchCounts.begin(),funcResult.matchCounts.end(), 0);
-    int average = result/funcResult.matchCounts.size();
+    int average = matchedAuthors > 0 ? static_cast<int>(matchSum)/static_cast<int>(matchedAuthors) : 0;
     QLOG_INFO() << "average ratio is: " << average;
     if(average == 0)
         average = 1;
-
-    Roaring taggedFics;
-    QLOG_INFO() << "Processing tagged fics:" << params->ficData->taggedFics.size();
-    for(const auto& fic: std::as_const(params->ficData->taggedFics))
-        taggedFics.add(fic);
-
     minimumRatio = (average+1)/2 > 1 ? (average+1)/2 : 1;
 
-    for(auto i = funcResult.ratioInfo.cbegin(); i != funcResult.ratioInfo.cend(); i++) {
-        int tempCardinality = tempSummary.fics.cardinality();
-        const auto& item = i.value();
-        tempSummary.authors += item.authors;
-        tempSummary.ficsAfterIgnore |= item.ficsAfterIgnore;
-        tempSummary.ficsAfterIgnore|=tempSummary.ficsAfterIgnore.operator-(taggedFics);
-
-        auto& sumratio = funcResult.ratioSumInfo[i.key()];
-        sumratio.ratio = i.key();
-        sumratio.lastFicsAdded = tempSummary.fics.cardinality() - tempCardinality;
-        sumratio.fics = tempSummary.fics;
-        sumratio.ficsAfterIgnore = tempSummary.ficsAfterIgnore;
-        sumratio.authors = tempSummary.authors;
-        sumratio.minListSize = item.minListSize;
-        sumratio.maxListSize= item.maxListSize;
-        //QLOG_INFO() << "ratio: " <<  i.key() << " own size: " << ownFavourites.cardinality() << " projected cardinality: " << ownFavourites.cardinality() * 200  << " sum cardinality: " << sumratio.ficsAfterIgnore.cardinality();
-        if(ratioCutoff == std::numeric_limits<uint16_t>::max() && (sumratio.ficsAfterIgnore.cardinality() > (ownFavourites.cardinality() * params->listSizeMultiplier)))
+    // the cutoff is the first ratio at which the lists up to it hold enough unignored fics
+    Roaring listsUpToRatio;
+    for(auto i = listsByRatio.begin(); i != listsByRatio.end() && ratioCutoff == std::numeric_limits<uint16_t>::max(); i++)
+    {
+        listsUpToRatio |= Roaring::fastunion(i.value().size(), i.value().data());
+        const auto unignoredFics = listsUpToRatio.cardinality() - listsUpToRatio.and_cardinality(state.ignores);
+        if(unignoredFics > ownFavouritesSize * params->listSizeMultiplier)
         {
             QLOG_INFO() << "Picking ratio: " << i.key();
             ratioCutoff = i.key();
@@ -879,38 +890,19 @@ void RecCalculatorImplBase::Filter(QSharedPointer<RecommendationList> params,
                                    const QList<std::function<bool (AuthorResult &, QSharedPointer<RecommendationList>)> >& filters,
                                    const QList<std::function<void (RecCalculatorImplBase *, AuthorResult &)> >& actions)
 {
-    auto thisPtr = this;
-    using FilterType = std::decay<decltype(filters)>::type::value_type;
-    using ActionType = std::decay<decltype(actions)>::type::value_type;
-
-    for(auto & [ key, author]: allAuthors){
-        auto setInvalid = [](auto& author){
-            author.ratio = 99999;
-            author.similarityPercentage = 0;
-        };
-        if(author.matches == 0 || author.sizeAfterIgnore < 10 || author.matches < minimumRatio){
-            setInvalid(author);
-        }
-        else{
-            author.similarityPercentage = author.matches/(static_cast<double>(author.sizeAfterIgnore)/100.);
-            author.ratio = static_cast<double>(author.sizeAfterIgnore)/static_cast<double>(author.matches);
-            author.negativeRatio = author.negativeMatches != 0  ? static_cast<double>(author.negativeMatches)/static_cast<double>(author.fullListSize) : std::numeric_limits<double>::max();
-            author.listDiff.touchyDifference = GetTouchyDiffForLists(author.id);
-            author.listDiff.neutralDifference = GetNeutralDiffForLists(author.id);
-            bool fail = std::any_of(std::execution::par_unseq,filters.cbegin(), filters.cend(), [author = std::ref(author),&params](const FilterType& filter){
-                return filter(author, params) == 0;
-
-            });
-            if(fail || author.ratio == 1){
-                setInvalid(author);
-                continue;
-            }
-            std::for_each(actions.cbegin(), actions.cend(), [thisPtr, author = std::ref(author)](const ActionType& action){
-                action(thisPtr, author);
-            });
+    FilterWith([&](AuthorResult& author){
+        return std::all_of(filters.cbegin(), filters.cend(), [&](const auto& filter){
+            return filter(author, params);
+        });
+    }, [&](AuthorResult& author){
+        for(const auto& action : actions)
+            action(this, author);
+    });
+}
 
-        }
-    };
+void RecCalculatorImplBase::FilterAuthors(QSharedPointer<RecommendationList> params, const FilterListType& filters, const ActionListType& actions)
+{
+    Filter(params, filters, actions);
 }
 
 void RecCalculatorImplBase::CalculateNegativeToPositiveRatio()
@@ -17,6 +17,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
 #include "include/rec_calc/rec_calculator_weighted.h"
 #include <cmath>
+#include <algorithm>
+#include <vector>
 namespace core {
 
 
@@ -79,10 +81,9 @@ RecCalculatorImplWeighted::FilterListType RecCalculatorImplWeighted::GetFilterLi
     return {matchesFilter, ratioFilter, negativeFilter};
 }
 RecCalculatorImplBase::ActionListType RecCalculatorImplWeighted::GetActionList(){
-    auto ratioAccumulator = [ratioSum = std::reference_wrapper<double>(this->ratioSum)](RecCalculatorImplBase* calc,AuthorResult & author)
+    auto ratioAccumulator = [this](RecCalculatorImplBase*,AuthorResult & author)
     {
-        if(calc->ownProfileId != static_cast<int>(author.id))
-            ratioSum+=author.ratio;
+        AccumulateRatio::Apply(this, author);
     };
     return {authorAccumulator, ratioAccumulator};
 };
@@ -95,7 +96,11 @@ std::function<AuthorWeightingResult(AuthorResult&, int, int)> RecCalculatorImplW
 }
 
 void RecCalculatorImplWeighted::CalcWeightingParams(){
-    auto authorList = filteredAuthors.values();
+    // ratios are copied out once, sorting and searching then don't need to go through allAuthors
+    std::vector<std::pair<double, int>> authorList;
+    authorList.reserve(static_cast<size_t>(filteredAuthors.size()));
+    for(auto author: std::as_const(filteredAuthors))
+        authorList.push_back({allAuthors[author].ratio, author});
     QLOG_INFO() << "inputs to weighting:";
     QLOG_INFO() << "matchsum:" << matchSum;
     QLOG_INFO() << "inputs.faves.size():" << inputs.faves.size();
@@ -108,10 +113,10 @@ void RecCalculatorImplWeighted::CalcWeightingParams(){
 
     double normalizer = 1./static_cast<double>(authorList.size()-1.);
     double sum = 0;
-    for(auto author: authorList)
+    for(const auto& [ratio, author]: authorList)
     {
-        if(this->ownProfileId != static_cast<int>(allAuthors[author].id))
-            sum+=std::pow(allAuthors[author].ratio - ratioMedian, 2);
+        if(this->ownProfileId != author)
+            sum+=std::pow(ratio - ratioMedian, 2);
     }
 
     quadraticDeviation = std::sqrt(normalizer * sum);
@@ -119,18 +124,10 @@ void RecCalculatorImplWeighted::CalcWeightingParams(){
     qDebug () << "median of match value is: " << matchMedian;
     qDebug () << "median of ratio is: " << ratioMedian;
 
-    //auto keysRatio = inputs.faves.keys();
-    auto keysMedian = inputs.faves.keys();
-    std::sort(keysMedian.begin(), keysMedian.end(),[&](const int& i1, const int& i2){
-        return allAuthors[i1].matches < allAuthors[i2].matches;
-    });
-
-    std::sort(authorList.begin(), authorList.end(),[&](const int& i1, const int& i2){
-        return allAuthors[i1].ratio < allAuthors[i2].ratio;
-    });
+    std::sort(authorList.begin(), authorList.end());
 
-    auto ratioMedianIt = std::lower_bound(authorList.cbegin(), authorList.cend(), ratioMedian, [&](const int& i1, const int& ){
-        return allAuthors[i1].ratio < ratioMedian;
+    auto ratioMedianIt = std::lower_bound(authorList.cbegin(), authorList.cend(), ratioMedian, [&](const std::pair<double, int>& author, const double& ){
+        return author.first < ratioMedian;
     });
     auto beginningOfQuadraticToMedianRange = ratioMedianIt - authorList.cbegin();
     qDebug() << "distance to median is: " << beginningOfQuadraticToMedianRange;
@@ -139,8 +136,8 @@ void RecCalculatorImplWeighted::CalcWeightingParams(){
     qDebug() << "sigma: " << quadraticDeviation;
     qDebug() << "2 sigma: " << quadraticDeviation * 2;
 
-    auto ratioSigma2 = std::lower_bound(authorList.cbegin(), authorList.cend(), ratioMedian, [&](const int& i1, const int& ){
-        return allAuthors[i1].ratio < (ratioMedian - quadraticDeviation*2);
+    auto ratioSigma2 = std::lower_bound(authorList.cbegin(), authorList.cend(), ratioMedian, [&](const std::pair<double, int>& author, const double& ){
+        return author.first < (ratioMedian - quadraticDeviation*2);
     });
     endOfUniqueAuthorRange = ratioSigma2 - authorList.cbegin();
     qDebug() << "distance to sigma15 is: " << endOfUniqueAuthorRange;
@@ -155,31 +152,27 @@ void RecCalculatorImplWeighted::CalcWeightingParams(){
 
     QLOG_INFO() << "Ratio median:" << ratioMedian;
 
-    for(auto authorId: authorList){
+    for(const auto& [ratio, authorId]: authorList){
         seenAuthorCount++;
         if(seenAuthorCount == uncommonAuthorCount){
-            //QLOG_INFO() << "Author ratio: " << allAuthors[authorId].ratio << " assigning ratio: uncommon";
-            auto ratio = allAuthors[authorId].ratio;
+            //QLOG_INFO() << "Author ratio: " << ratio << " assigning ratio: uncommon";
             auto currentRange = ratioMedian - ratio;
             uncommonRange = currentRange;
         }else if(seenAuthorCount == rareAuthorCount){
-            auto ratio = allAuthors[authorId].ratio;
             auto currentRange = ratioMedian - ratio;
-            //QLOG_INFO() << "Author ratio: " << allAuthors[authorId].ratio << " assigning ratio: rare";
+            //QLOG_INFO() << "Author ratio: " << ratio << " assigning ratio: rare";
             rareRange = currentRange;
         }else if(seenAuthorCount == uniqueAuthorCount){
-            auto ratio = allAuthors[authorId].ratio;
             auto currentRange = ratioMedian - ratio;
-            //QLOG_INFO() << "Author ratio: " << allAuthors[authorId].ratio << " assigning ratio: unique";
+            //QLOG_INFO() << "Author ratio: " << ratio << " assigning ratio: unique";
             uniqueRange = currentRange;
         }
         else
-            //QLOG_INFO() << "Author ratio: " << allAuthors[authorId].ratio;
-        allAuthors[authorId].distance = ratioMedian - allAuthors[authorId].ratio;
+            //QLOG_INFO() << "Author ratio: " << ratio;
+        allAuthors[authorId].distance = ratioMedian - ratio;
     }
 
-    for(auto authorId: authorList){
-        auto ratio = allAuthors[authorId].ratio;
+    for(const auto& [ratio, authorId]: authorList){
         if(ratioMedian - ratio > uniqueRange)
             this->uniqueAuthors++;
         else if(ratioMedian - ratio > rareRange)
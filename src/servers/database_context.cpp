@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include "Interfaces/ffn/ffn_authors.h"
 #include "Interfaces/ffn/ffn_fanfics.h"
 #include "Interfaces/fandoms.h"
+#include "include/sqlitefunctions.h"
 static QString GetDbNameFromCurrentThread(){
     std::stringstream ss;
     ss << std::this_thread::get_id();
@@ -28,11 +29,21 @@ static QString GetDbNameFromCurrentThread(){
     return QString("Crawler_") + QString::fromStdString(id);
 }
 
+QSharedPointer<database::IDBWrapper> ThreadConnection(){
+    thread_local QSharedPointer<database::IDBWrapper> connection;
+    if(!connection)
+    {
+        connection.reset(new database::SqliteInterface());
+        QString name = GetDbNameFromCurrentThread();
+        QLOG_INFO() << "OPENING CONNECTION:" << name;
+        connection->InitDatabase2("database/CrawlerDB", name, false);
+        database::sqlite::EnableStatementCache(connection->GetDatabase());
+    }
+    return connection;
+}
+
 DatabaseContext::DatabaseContext(){
-    dbInterface.reset(new database::SqliteInterface());
-    QString name = GetDbNameFromCurrentThread();
-    QLOG_TRACE() << "OPENING CONNECTION:" << name;
-    dbInterface->InitDatabase2("database/CrawlerDB", name, false);
+    dbInterface = ThreadConnection();
 }
 
 void DatabaseContext::InitFanfics()
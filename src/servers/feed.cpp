@@ -42,13 +42,22 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include "Interfaces/fanfics.h"
 #include "Interfaces/genres.h"
 #include "Interfaces/recommendation_lists.h"
+#include "Interfaces/data_source_bitmap.h"
+#include "rec_calc/list_overlap.h"
+#include "servers/rec_list_cache.h"
+#include "servers/similar_fics.h"
+#include "data_code/recommender_neighbours.h"
 #include "tasks/author_genre_iteration_processor.h"
 #include "third_party/nanobench/nanobench.h"
+#include "cancellation_token.h"
 
 
 #include <QSettings>
 #include <QThread>
 #include <QRegularExpression>
+#include <QCryptographicHash>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 
 
 #define TO_STR2(x) #x
@@ -58,6 +67,34 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 //template void core::DataHolder::LoadData<1>(QString);
 void AccumulatorIntoSectionStats(core::FavListDetails& result, const core::FicListDataAccumulator& dataResult);
 
+// cancelled once the client is gone or its deadline has passed
+// the token must not outlive the call, it polls the context
+static CancellationToken CancellationForContext(grpc::ServerContext* context)
+{
+    if(!context)
+        return {};
+    auto deadline = CancellationToken::Clock::time_point::max();
+    const auto clientDeadline = context->deadline();
+    if(clientDeadline != std::chrono::system_clock::time_point::max())
+    {
+        const auto remaining = clientDeadline - std::chrono::system_clock::now();
+        deadline = CancellationToken::Clock::now() + std::chrono::duration_cast<CancellationToken::Clock::duration>(remaining);
+    }
+    return CancellationToken([context](){return context->IsCancelled();}, deadline);
+}
+
+// for handlers that only run sql, the statements of the thread are interrupted once the client is gone
+struct CallCancellation{
+    explicit CallCancellation(grpc::ServerContext* context):token(CancellationForContext(context)), scope(token){}
+    CancellationToken token;
+    CancellationScope scope;
+};
+
+static Status CancelledStatus()
+{
+    return Status(grpc::StatusCode::CANCELLED, "Request was cancelled or ran past its deadline");
+}
+
 static QString GetDbNameFromCurrentThread(){
     std::stringstream ss;
     ss << std::this_thread::get_id();
@@ -94,6 +131,8 @@ FeederService::FeederService(QObject* parent): QObject(parent){
     calculator->holder.LoadData<core::rdt_fics>("ServerData");
     qDebug() << "loading favourites";
     calculator->holder.LoadData<core::rdt_favourites>("ServerData");
+    qDebug() << "loading fic id map";
+    calculator->holder.LoadFicIdMap();
     qDebug() << "loading genres composite";
     //genres->loadOriginalGenresOnly = true;
     calculator->holder.LoadData<core::rdt_fic_genres_composite>("ServerData");
@@ -106,7 +145,7 @@ FeederService::FeederService(QObject* parent): QObject(parent){
         qDebug() << "calculating moods";
         AuthorGenreIterationProcessor iteratorProcessor;
         calculator->holder.LoadData<core::rdt_author_genre_distribution>("ServerData");
-        iteratorProcessor.ReprocessGenreStats(calculator->holder.genreComposites, calculator->holder.faves);
+        iteratorProcessor.ReprocessGenreStats(calculator->holder.genreVectors, calculator->holder.faves);
         auto testedAuthor = iteratorProcessor.resultingMoodAuthorData[94186];
         QStringList moodList;
         moodList << "Neutral" << "Funny"  << "Shocky" << "Flirty" << "Dramatic" << "Hurty" << "Bondy";
@@ -116,11 +155,59 @@ FeederService::FeederService(QObject* parent): QObject(parent){
             qDebug() << moodList[i] << ": " << userValue;
         }
         qDebug() << "saving moods";
-        thread_boost::SaveData("ServerData","amd",iteratorProcessor.resultingMoodAuthorData);
+        thread_boost::SaveSnapshot("ServerData","amd",iteratorProcessor.resultingMoodAuthorData);
         calculator->holder.LoadData<core::rdt_author_mood_distribution>("ServerData");
         qDebug() << "finished saving moods";
     }
 
+    QSettings settings("settings/settings_server.ini", QSettings::IniFormat);
+    if(settings.value("Settings/bitmapSearch", true).toBool())
+    {
+        qDebug() << "building search index";
+        QSharedPointer<core::FicSearchIndex> index(new core::FicSearchIndex());
+        TimedAction indexAction("Building search index",[&](){
+            fanfics->ProcessFicsForSearchIndex([&index](const core::FicSearchRecord& record){
+                index->Add(record);
+            });
+            index->Finalize();
+        });
+        indexAction.run();
+        searchIndex = index;
+    }
+    calculator->relationSessions.SetLimits(settings.value("Settings/relationSessions", 16).toInt(),
+                                           settings.value("Settings/relationSessionMinutes", 30).toInt() * 60);
+    const auto recListCacheMegabytes = settings.value("Settings/recListCacheMegabytes", 256).toULongLong();
+    if(recListCacheMegabytes > 0)
+        recListCache.reset(new RecListCache(recListCacheMegabytes * 1024 * 1024));
+    const auto similarFicsFile = settings.value("SimilarFics/fileName").toString();
+    if(!similarFicsFile.isEmpty())
+    {
+        QSharedPointer<core::SimilarFicTable> table(new core::SimilarFicTable());
+        if(table->Open(similarFicsFile, calculator->holder.FavouritesFingerprint()))
+        {
+            QLOG_INFO() << "Similar fic table opened, fics: " << table->Size() << " neighbours per fic: " << table->NeighboursPerFic();
+            similarFicTable = table;
+        }
+        else
+            QLOG_WARN() << "Could not open similar fic table or it was built from other data, similar fic lists will be calculated live: " << similarFicsFile;
+    }
+    const auto recommenderNeighboursFile = settings.value("RecommenderNeighbours/fileName").toString();
+    if(!recommenderNeighboursFile.isEmpty())
+    {
+        QSharedPointer<core::RecommenderNeighbourTable> table(new core::RecommenderNeighbourTable());
+        if(table->Load(recommenderNeighboursFile))
+        {
+            QLOG_INFO() << "Recommender neighbours loaded for recommenders: " << table->Size();
+            recommenderNeighbours = table;
+        }
+        else
+            QLOG_WARN() << "Could not load recommender neighbours: " << recommenderNeighboursFile;
+    }
+    sketchContainment = settings.value("Settings/sketchContainment", 0).toDouble();
+    sketchFromListSize = settings.value("Settings/sketchFromListSize", 2000).toInt();
+    if(settings.value("Settings/benchmarkListOverlap", false).toBool())
+        core::BenchmarkListOverlap(calculator->holder.faves);
+
     logTimer.reset(new QTimer());
     logTimer->start(3600000);
     connect(logTimer.data(), SIGNAL(timeout()), this, SLOT(OnPrintStatistics()), Qt::QueuedConnection);
@@ -200,8 +287,10 @@ UsedInSearch FeederService::PrepareSearch(::ProtoSpace::ResponseInfo* response,
 Status FeederService::Search(ServerContext* context, const ProtoSpace::SearchTask* task,
                              ProtoSpace::SearchResponse* response)
 {
-    Q_UNUSED(context);
     QLOG_INFO() << "///Searching";
+    const auto cancellation = CancellationForContext(context);
+    // interrupts the sqlite statements of this thread once the client is gone
+    CancellationScope cancellationScope(cancellation);
     RequestContext reqContext("Searching",task->controls(), this);
     auto prepared = PrepareSearch(response->mutable_response_info(),task->filter(),
                                   task->user_data(),reqContext);
@@ -217,6 +306,11 @@ Status FeederService::Search(ServerContext* context, const ProtoSpace::SearchTas
         prepared.ficSource->FetchData(prepared.filter, &data);
     });
     action.run();
+    if(cancellation.IsCancelled())
+    {
+        QLOG_INFO() << "Search cancelled after: " << action.ms;
+        return CancelledStatus();
+    }
 
     AddToStatistics(reqContext.userToken, prepared.filter);
 
@@ -309,18 +403,15 @@ grpc::Status FeederService::SearchByFFNID(grpc::ServerContext *, const ProtoSpac
 
 grpc::Status FeederService::GetUserMatches(grpc::ServerContext *context, const ProtoSpace::UserMatchRequest *task, ProtoSpace::UserMatchResponse *response)
 {
-    Q_UNUSED(context);
-    QLOG_INFO() << "Starting user matches";
+    const auto cancellation = CancellationForContext(context);
     An<core::RecCalculator> holder;
-    QHash<int, core::FavouritesMatchResult> fics;
-    QLOG_INFO() << "received user task of size: " << task->test_users_size();
+    QLOG_INFO() << "Starting user matches, received user task of size: " << task->test_users_size();
     Roaring r;
     Roaring ignoredFandoms;
     if(task->user_fics_size() > 0)
     {
         for(int i = 0; i < task->user_fics_size(); i++)
             r.add(task->user_fics(i));
-        QLOG_INFO() << "reading fandom ignores";
         for(int i = 0; i < task->fandom_ignores_size(); i++)
         {
             if(task->fandom_ignores(i) >= 0)
@@ -328,19 +419,29 @@ grpc::Status FeederService::GetUserMatches(grpc::ServerContext *context, const P
         }
     }
     else
-        r = holder->holder.faves[task->source_user()];
+        r = holder->holder.faves.value(task->source_user());
     core::UserMatchesInput input;
     input.userFavourites = r;
     input.userIgnoredFandoms = ignoredFandoms;
+
+    QList<int> users;
+    users.reserve(task->test_users_size());
     for(int i = 0; i < task->test_users_size(); i++)
+        users.push_back(task->test_users(i));
+    // without users to test against the closest recommenders of the source user are matched
+    if(users.isEmpty() && task->user_fics_size() == 0 && recommenderNeighbours)
     {
-        QLOG_INFO() << "Processing user: " << i;
-        fics[task->test_users(i)] = holder->GetMatchedFics(input, task->test_users(i));
-        QLOG_INFO() << "Ratio for user: " << task->test_users(i) << " " << fics[task->test_users(i)].ratio;
-        QLOG_INFO() << "Ratio without ignores for user: " << task->test_users(i) << " " << fics[task->test_users(i)].ratioWithoutIgnores;
-        QLOG_INFO() << "Matches for user: " << task->test_users(i) << " " << fics[task->test_users(i)].matches;
+        users = recommenderNeighbours->NeighboursFor(task->source_user());
+        QLOG_INFO() << "Matching precomputed neighbours of user: " << task->source_user() << " " << users.size();
     }
-    QLOG_INFO() << "Responding";
+
+    QHash<int, core::FavouritesMatchResult> fics;
+    TimedAction matching("Matching users",[&](){
+        fics = holder->GetMatchedFics(input, users, cancellation);
+    });
+    matching.run();
+    if(cancellation.IsCancelled())
+        return CancelledStatus();
     response->set_success(true);
 
     for(auto i = fics.cbegin(); i != fics.cend(); i++)
@@ -360,7 +461,7 @@ grpc::Status FeederService::GetUserMatches(grpc::ServerContext *context, const P
 Status FeederService::GetFicCount(ServerContext* context, const ProtoSpace::FicCountTask* task,
                                   ProtoSpace::FicCountResponse* response)
 {
-    Q_UNUSED(context);
+    CallCancellation cancellation(context);
     RequestContext reqContext("Getting fic count",task->controls(), this);
     auto prepared = PrepareSearch(response->mutable_response_info(),task->filter(),
                                   task->user_data(),reqContext);
@@ -385,14 +486,13 @@ Status FeederService::GetFicCount(ServerContext* context, const ProtoSpace::FicC
 Status FeederService::SyncFandomList(ServerContext* context, const ProtoSpace::SyncFandomListTask* task,
                                      ProtoSpace::SyncFandomListResponse* response)
 {
-    Q_UNUSED(context);
+    CallCancellation cancellation(context);
     RequestContext reqContext("Fandom synch",task->controls(), this);
     if(!reqContext.Process(response->mutable_response_info()))
         return Status::OK;
 
-    DatabaseContext dbContext;
     QSharedPointer<interfaces::Fandoms> fandomInterface (new interfaces::Fandoms());
-    fandomInterface->db = dbContext.dbInterface->GetDatabase();
+    fandomInterface->db = reqContext.dbContext.dbInterface->GetDatabase();
     auto lastServerFandomID = fandomInterface->GetLastFandomID();
     QLOG_INFO() << "Client last fandom ID: " << task->last_fandom_id();
     QLOG_INFO() << "Server last fandom ID: " << lastServerFandomID;
@@ -417,36 +517,28 @@ Status FeederService::SyncFandomList(ServerContext* context, const ProtoSpace::S
     QLOG_INFO() << " ";
     return Status::OK;
 }
-std::once_flag moodsFlag;
-genre_stats::GenreMoodData CalcMoodDistributionForFicList(QList<uint32_t> ficList, core::FicGenreCompositeType ficGenres){
+genre_stats::GenreMoodData CalcMoodDistributionForFicList(const QList<uint32_t>& ficList, const core::FicGenreVectors& ficVectors){
 
     genre_stats::GenreMoodData result;
     Roaring r;
     for(auto fic : ficList)
         r.add(fic);
 
-    QHash<int, Roaring> favourites;
-    AuthorGenreIterationProcessor iteratorProcessor;
-    favourites[0] = r;
-    iteratorProcessor.ReprocessGenreStats(ficGenres, favourites);
+    AuthorGenreIterationProcessor::CalcListGenreStats(ficVectors, r, result.listGenreData, result.listMoodData);
     result.isValid = true;
-    result.listMoodData = iteratorProcessor.resultingMoodAuthorData[0];
-    result.listGenreData = iteratorProcessor.resultingGenreAuthorData[0];
     qDebug() << "Logging reference list";
     result.listMoodData.Log();
 
-    static QStringList moodList;
-    std::call_once(moodsFlag, [&](){
-        moodList << "Neutral" << "Funny"  << "Shocky" << "Flirty" << "Dramatic" << "Hurty" << "Bondy";
-    });
-
-    for(int i= 0; i < moodList.size(); i++)
+    for(int mood = genre_stats::gm_neutral; mood < genre_stats::gm_count; mood++)
     {
-        auto userValue =  interfaces::Genres::ReadMoodValue(moodList[i], result.listMoodData);
+        const auto moodType = static_cast<genre_stats::EGenreMood>(mood);
+        auto userValue =  result.listMoodData.MoodValue(moodType);
         if(userValue >= 0.5)
         {
-            qDebug() << "detected axis mood:" << moodList[i];
-            result.moodAxis.push_back(moodList[i]);
+            const auto moodName = QString::fromLatin1(genre_stats::moodNames[mood]);
+            qDebug() << "detected axis mood:" << moodName;
+            result.moodAxis.push_back(moodName);
+            result.moodAxisMask |= genre_stats::MoodMask(moodType);
         }
     }
 
@@ -485,6 +577,7 @@ const static auto basicRecommendationsParamReader = [](RequestContext& reqContex
     for(auto i = 0; i< task->data().user_data().negative_feedback().strongnegatives_size(); i++)
         params->majorNegativeVotes.insert(task->data().user_data().negative_feedback().strongnegatives(i));
     params->resultLimit = task->data().response_data_controls().output_size();
+    params->ignoreBreakdowns = task->data().response_data_controls().ignore_breakdowns();
 
     QLOG_INFO() << "Dumping received list creation params:";
     params->Log();
@@ -492,6 +585,32 @@ const static auto basicRecommendationsParamReader = [](RequestContext& reqContex
 };
 
 
+// source fics come from the server's fic store
+// the ones that exist in the database but not in the store are looked up by their id
+// the cfInSourceFics scan is only used when the store isn't loaded
+static QHash<uint32_t, core::FicWeightPtr> FetchSourceFics(RequestContext& reqContext, const QSet<int>& sourceFics)
+{
+    QHash<uint32_t, core::FicWeightPtr> result;
+    An<core::RecCalculator> recCalculator;
+    const auto& holder = recCalculator->holder;
+    if(holder.ficIds.IsEmpty())
+    {
+        reqContext.recsData->sourceFics = sourceFics;
+        return reqContext.dbContext.fanfics->GetFicsForRecCreation();
+    }
+    QList<int> missingDbIds;
+    result = holder.FicsForFFNIds(sourceFics, missingDbIds);
+    if(!missingDbIds.isEmpty())
+    {
+        QLOG_INFO() << "fics missing from the fic store:" << missingDbIds.size();
+        const auto fetchedFics = reqContext.dbContext.fanfics->GetFicsForRecCreation(missingDbIds);
+        for(auto it = fetchedFics.cbegin(); it != fetchedFics.cend(); it++)
+            result.insert(it.key(), it.value());
+    }
+    reqContext.recsData->sourceFics = sourceFics;
+    return result;
+}
+
 struct RecommendationsSourceFics{
     QSet<int> sourceFics;
     QHash<uint32_t, core::FicWeightPtr> fetchedFics;
@@ -506,10 +625,9 @@ const static auto ficPackReader = [](RequestContext& reqContext, const auto& tas
         //recs->recommendationList[task->id_packs().ffn_ids(i)]
     }
     QLOG_INFO() << "source contains fics: " << result.sourceFics.size();
-    reqContext.recsData->sourceFics = result.sourceFics;
 
     TimedAction action("Fic ids conversion",[&](){
-        result.fetchedFics = reqContext.dbContext.fanfics->GetFicsForRecCreation();
+        result.fetchedFics = FetchSourceFics(reqContext, result.sourceFics);
     });
     action.run();
     return result;
@@ -519,7 +637,7 @@ grpc::Status FeederService::DiagnosticRecommendationListCreation(grpc::ServerCon
                                                                  const ProtoSpace::DiagnosticRecommendationListCreationRequest *task,
                                                                  ProtoSpace::DiagnosticRecommendationListCreationResponse *response)
 {
-    Q_UNUSED(context);
+    const auto cancellation = CancellationForContext(context);
     RequestContext reqContext("Diagnostic Reclist Creation",task->controls(), this);
     if(!reqContext.Process(response->mutable_response_info()))
         return Status::OK;
@@ -533,9 +651,11 @@ grpc::Status FeederService::DiagnosticRecommendationListCreation(grpc::ServerCon
 
     auto recommendationsCreationParams = basicRecommendationsParamReader(reqContext, task);
     auto ficResult = ficPackReader(reqContext, task);
-    auto moodData = CalcMoodDistributionForFicList(ficResult.fetchedFics.keys(), recCalculator->holder.genreComposites);
+    auto moodData = CalcMoodDistributionForFicList(ficResult.fetchedFics.keys(), recCalculator->holder.genreVectors);
 
-    auto list = recCalculator->GetDiagnosticRecommendationList(ficResult.fetchedFics, recommendationsCreationParams, moodData);
+    auto list = recCalculator->GetDiagnosticRecommendationList(ficResult.fetchedFics, recommendationsCreationParams, moodData, cancellation);
+    if(cancellation.IsCancelled())
+        return CancelledStatus();
     TimedAction dataPassAction("Passing data: ",[&](){
         auto* targetList = response->mutable_list();
 
@@ -570,38 +690,47 @@ grpc::Status FeederService::DiagnosticRecommendationListCreation(grpc::ServerCon
     return Status::OK;
 }
 
-Status FeederService::RecommendationListCreation(ServerContext* context, const ProtoSpace::RecommendationListCreationRequest* task,
-                                                 ProtoSpace::RecommendationListCreationResponse* response)
+// the order of ids in the request doesn't matter for the result
+template <typename RepeatedIds>
+static void SortUniqueIds(RepeatedIds* ids)
 {
+    std::sort(ids->begin(), ids->end());
+    ids->Truncate(static_cast<int>(std::unique(ids->begin(), ids->end()) - ids->begin()));
+}
 
-    Q_UNUSED(context);
-    //grpcutils::DumpToLog("Received recommendations request: ", task);
-
-    RequestContext reqContext("Reclist Creation",task->controls(), this);
-    if(!reqContext.Process(response->mutable_response_info()))
-        return Status::OK;
-
-
-    QLOG_TRACE() << "Verifying request params";
-    if(!VerifyRecommendationsRequest(task, response->mutable_response_info()))
-    {
-        SetRecommedationDataError(response->mutable_response_info());
-        QLOG_INFO() << "data size error, exiting";
-        return Status::OK;
-    }
-
-    reqContext.dbContext.InitFanfics();
-
-    if(task->data().id_packs().ffn_ids_size() == 0)
-        return Status::OK;
-
-    auto recommendationsCreationParams = basicRecommendationsParamReader(reqContext, task);
-    if(recommendationsCreationParams->resultLimit > 100)
+// canonical form of the request data with every id list sorted, hashed together with the version of server data
+// controls aren't part of the data so the same list requested by different users shares the entry
+template <typename RequestData>
+static QByteArray RecListCacheKey(const RequestData& requestData, uint32_t dataVersion)
+{
+    RequestData data = requestData;
+    SortUniqueIds(data.mutable_id_packs()->mutable_ffn_ids());
+    SortUniqueIds(data.mutable_user_data()->mutable_ignored_fandoms()->mutable_fandom_ids());
+    SortUniqueIds(data.mutable_user_data()->mutable_ignored_fics());
+    SortUniqueIds(data.mutable_user_data()->mutable_tagged_fics());
+    SortUniqueIds(data.mutable_user_data()->mutable_liked_authors());
+    SortUniqueIds(data.mutable_user_data()->mutable_negative_feedback()->mutable_basicnegatives());
+    SortUniqueIds(data.mutable_user_data()->mutable_negative_feedback()->mutable_strongnegatives());
+
+    std::string serialized;
     {
-        response->mutable_response_info()->set_error("result limit must not be greater than 100");
-        return Status::OK;
+        google::protobuf::io::StringOutputStream stream(&serialized);
+        google::protobuf::io::CodedOutputStream output(&stream);
+        output.SetSerializationDeterministic(true);
+        data.SerializeToCodedStream(&output);
     }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(reinterpret_cast<const char*>(&dataVersion), sizeof(dataVersion));
+    hash.addData(serialized.data(), static_cast<int>(serialized.size()));
+    return hash.result();
+}
 
+// everything RecommendationListCreation does once the request is verified, the result is what the cache stores
+static void CreateRecommendationList(RequestContext& reqContext, const ProtoSpace::RecommendationListCreationRequest* task,
+                                     QSharedPointer<core::RecommendationList> recommendationsCreationParams,
+                                     ProtoSpace::RecommendationListCreationResponse* response,
+                                     const CancellationToken& cancellation)
+{
     auto ficResult = ficPackReader(reqContext, task);
     auto& fetchedFics = ficResult.fetchedFics;
     if(recommendationsCreationParams->ficFavouritesCutoff != 0){
@@ -624,10 +753,16 @@ Status FeederService::RecommendationListCreation(ServerContext* context, const P
 
     An<core::RecCalculator> recCalculator;
     QLOG_INFO() << "Mood data for source ficlist:";
-    auto moodData = CalcMoodDistributionForFicList(ficResult.fetchedFics.keys(), recCalculator->holder.genreComposites);
+    auto moodData = CalcMoodDistributionForFicList(ficResult.fetchedFics.keys(), recCalculator->holder.genreVectors);
 
 
-    auto list = recCalculator->GetMatchedFicsForFavList(ficResult.fetchedFics, recommendationsCreationParams, moodData);
+    auto list = recCalculator->GetMatchedFicsForFavList(ficResult.fetchedFics, recommendationsCreationParams, moodData, reqContext.userToken, cancellation);
+    // nobody is going to read the list, it's left empty so that the cache doesn't store it
+    if(cancellation.IsCancelled())
+    {
+        response->Clear();
+        return;
+    }
     int baseVotes = recommendationsCreationParams->useMoodAdjustment ? 20 : 1;
 
     //TimedAction dataPassAction("Passing data: ",[&](){
@@ -656,7 +791,9 @@ Status FeederService::RecommendationListCreation(ServerContext* context, const P
                 continue;
             const auto& value = i.value();
             //QLOG_INFO() << " n_fic_id: " << key << " n_matches: " << list[key];
-            if(!recCalculator->holder.fics.contains(key))
+            const auto& ficStore = recCalculator->holder.ficStore;
+            const auto ficOrdinal = ficStore.OrdinalFor(static_cast<uint32_t>(key));
+            if(ficOrdinal == core::FicStore::invalidOrdinal)
             {
                 qDebug() << "probably an older database, skipping key: " << key;
                 continue;
@@ -673,33 +810,25 @@ Status FeederService::RecommendationListCreation(ServerContext* context, const P
             if(recommendationsCreationParams->useMoodAdjustment
                     //&& (static_cast<float>(list.decentMatches.value(key)) / static_cast<float>(list.pureMatches.value(key))) < 0.1f
                     && list.decentMatches.value(key) < 1 && adjustedVotes < 10
-                    && !recommendationsCreationParams->likedAuthors.contains(recCalculator->holder.fics.value(key)->authorId))
+                    && !recommendationsCreationParams->likedAuthors.contains(ficStore.authorId[ficOrdinal]))
             {
                 bool axisGenre = false;;
                 //qDebug() << "attempting to purge fic: " << key;
-                const QHash<int, QList<genre_stats::GenreBit>>& ref = recCalculator->holder.genreComposites;
-                const QList<genre_stats::GenreBit>& refList = ref[key];
-                double maxValue = 0.;
-                // shit code, but I really don't want to refactor rn
+                const auto& composites = recCalculator->holder.genreComposites;
+                auto compositeIt = composites.constFind(key);
+                const QList<genre_stats::GenreBit> refList = compositeIt != composites.cend() ? compositeIt.value() : QList<genre_stats::GenreBit>();
+                uint16_t maxWeight = 0;
                 for(const auto& genreBit: refList)
-                {
-                    if(genreBit.relevance > maxValue)
-                        maxValue = genreBit.relevance;
-                }
+                    maxWeight = std::max(maxWeight, genreBit.weight);
 
+                uint32_t significantGenres = 0;
                 for(const auto& genreBit: refList)
                 {
                     //qDebug() << "genres: " << genreBit.genres << " relevance: " << genreBit.relevance;
-                    if(genreBit.relevance/maxValue > 0.45)
-                    {
-                        for(const auto& actualGenre : std::as_const(genreBit.genres))
-                        {
-                            auto mood = interfaces::Genres::MoodForGenre(actualGenre);
-                            if(moodData.moodAxis.contains(mood))
-                                axisGenre = true;
-                        }
-                    }
+                    if(static_cast<float>(genreBit.weight) > 0.45f * static_cast<float>(maxWeight))
+                        significantGenres |= genreBit.genreMask;
                 }
+                axisGenre = (genre_stats::MoodMaskForGenres(significantGenres) & moodData.moodAxisMask) != 0;
 
                 if(!axisGenre)
                     targetList->add_purged(1);
@@ -752,6 +881,84 @@ Status FeederService::RecommendationListCreation(ServerContext* context, const P
 //    });
 //    dataPassAction.run();
     QLOG_INFO() << "Byte size will be: " << response->ByteSizeLong();
+}
+
+
+Status FeederService::RecommendationListCreation(ServerContext* context, const ProtoSpace::RecommendationListCreationRequest* task,
+                                                 ProtoSpace::RecommendationListCreationResponse* response)
+{
+
+    const auto cancellation = CancellationForContext(context);
+    //grpcutils::DumpToLog("Received recommendations request: ", task);
+
+    RequestContext reqContext("Reclist Creation",task->controls(), this);
+    if(!reqContext.Process(response->mutable_response_info()))
+        return Status::OK;
+
+
+    QLOG_TRACE() << "Verifying request params";
+    if(!VerifyRecommendationsRequest(task, response->mutable_response_info()))
+    {
+        SetRecommedationDataError(response->mutable_response_info());
+        QLOG_INFO() << "data size error, exiting";
+        return Status::OK;
+    }
+
+    reqContext.dbContext.InitFanfics();
+
+    if(task->data().id_packs().ffn_ids_size() == 0)
+        return Status::OK;
+
+    auto recommendationsCreationParams = basicRecommendationsParamReader(reqContext, task);
+    if(recommendationsCreationParams->resultLimit > 100)
+    {
+        response->mutable_response_info()->set_error("result limit must not be greater than 100");
+        return Status::OK;
+    }
+
+    // the protocol has no field for it, big lists get the approximate mode of the server
+    if(sketchContainment > 0 && task->data().id_packs().ffn_ids_size() >= sketchFromListSize)
+        recommendationsCreationParams->sketchContainment = sketchContainment;
+
+    // "fics similar to X" lists are precomputed, the ones for fics missing from the table are calculated
+    if(similarFicTable && task->data().id_packs().ffn_ids_size() == 1
+            && task->data().response_data_controls().ignore_breakdowns()
+            && recommendationsCreationParams->IsSimilarFicList())
+    {
+        An<core::RecCalculator> recCalculator;
+        const auto sourceFic = recCalculator->holder.ficIds.DbIdFor(task->data().id_packs().ffn_ids(0));
+        if(sourceFic != -1 && FillSimilarFicListFromTable(*similarFicTable, recCalculator->holder.ficStore, static_cast<uint32_t>(sourceFic),
+                                                          *recommendationsCreationParams, response))
+        {
+            similarFicTableHits++;
+            QLOG_INFO() << "Similar fic list served from the table for fic: " << sourceFic;
+            return Status::OK;
+        }
+        similarFicTableMisses++;
+    }
+
+    if(!recListCache)
+    {
+        CreateRecommendationList(reqContext, task, recommendationsCreationParams, response, cancellation);
+        return cancellation.IsCancelled() ? CancelledStatus() : Status::OK;
+    }
+
+    An<core::RecCalculator> recCalculator;
+    const auto cacheKey = RecListCacheKey(task->data(), recCalculator->holder.dataVersion);
+    bool computedHere = false;
+    auto cachedResponse = recListCache->GetOrCompute(cacheKey, [&]() -> QByteArray {
+        CreateRecommendationList(reqContext, task, recommendationsCreationParams, response, cancellation);
+        if(!response->list().success())
+            return QByteArray();
+        return QByteArray::fromStdString(response->SerializeAsString());
+    }, &computedHere);
+    if(!computedHere)
+    {
+        QLOG_INFO() << "Reclist served from cache, byte size: " << cachedResponse.size();
+        response->ParseFromArray(cachedResponse.constData(), cachedResponse.size());
+    }
+    else if(cancellation.IsCancelled())
+        return CancelledStatus();
     return Status::OK;
 }
 
@@ -760,7 +967,7 @@ Status FeederService::RecommendationListCreation(ServerContext* context, const P
 Status FeederService::GetDBFicIDS(ServerContext* context, const ProtoSpace::FicIdRequest* task,
                                   ProtoSpace::FicIdResponse* response)
 {
-    Q_UNUSED(context);
+    CallCancellation cancellation(context);
     RequestContext reqContext("FFN fic IDS",task->controls(), this);
     if(!reqContext.Process(response->mutable_response_info()))
         return Status::OK;
@@ -775,8 +982,15 @@ Status FeederService::GetDBFicIDS(ServerContext* context, const ProtoSpace::FicI
     QHash<int, int> idsToFill;
     for(int i = 0; i < task->ids().ffn_ids_size(); i++)
         idsToFill[task->ids().ffn_ids(i)] = -1;
-    reqContext.dbContext.InitFanfics();
-    bool result = reqContext.dbContext.fanfics->ConvertFFNTaggedFicsToDB(idsToFill);
+    bool result = true;
+    An<core::RecCalculator> holder;
+    if(!holder->holder.ficIds.IsEmpty())
+        holder->holder.ficIds.ConvertFFNToDB(idsToFill);
+    else
+    {
+        reqContext.dbContext.InitFanfics();
+        result = reqContext.dbContext.fanfics->ConvertFFNTaggedFicsToDB(idsToFill);
+    }
     if(!result)
     {
         QLOG_ERROR() << "failed to convert";
@@ -798,7 +1012,7 @@ Status FeederService::GetDBFicIDS(ServerContext* context, const ProtoSpace::FicI
 Status FeederService::GetFFNFicIDS(ServerContext* context, const ProtoSpace::FicIdRequest* task,
                                    ProtoSpace::FicIdResponse* response)
 {
-    Q_UNUSED(context);
+    CallCancellation cancellation(context);
     RequestContext reqContext("FFN fic IDS",task->controls(), this);
     if(!reqContext.Process(response->mutable_response_info()))
         return Status::OK;
@@ -807,12 +1021,19 @@ Status FeederService::GetFFNFicIDS(ServerContext* context, const ProtoSpace::Fic
     if(!VerifyIDPack(task->ids(), response->mutable_response_info()))
         return Status::OK;
 
-    reqContext.dbContext.InitFanfics();
     QHash<int, int> idsToFill;
     for(int i = 0; i < task->ids().db_ids_size(); i++)
         idsToFill[task->ids().db_ids(i)] = -1;
 
-    bool result = reqContext.dbContext.fanfics->ConvertDBFicsToFFN(idsToFill);
+    bool result = true;
+    An<core::RecCalculator> holder;
+    if(!holder->holder.ficIds.IsEmpty())
+        holder->holder.ficIds.ConvertDBToFFN(idsToFill);
+    else
+    {
+        reqContext.dbContext.InitFanfics();
+        result = reqContext.dbContext.fanfics->ConvertDBFicsToFFN(idsToFill);
+    }
     if(!result)
     {
         response->set_success(false);
@@ -836,7 +1057,7 @@ grpc::Status FeederService::GetFavListDetails(grpc::ServerContext *context,
                                               const ProtoSpace::FavListDetailsRequest *task,
                                               ProtoSpace::FavListDetailsResponse *response)
 {
-    Q_UNUSED(context);
+    CallCancellation cancellation(context);
     RequestContext reqContext("Favlist details",task->controls(), this);
     if(!reqContext.Process(response->mutable_response_info()))
         return Status::OK;
@@ -853,30 +1074,23 @@ grpc::Status FeederService::GetFavListDetails(grpc::ServerContext *context,
     if(sourceFics.size() == 0)
         return Status::OK;
 
-    reqContext.recsData->sourceFics = sourceFics;
     TimedAction action("Fic ids conversion",[&](){
-        fetchedFics = reqContext.dbContext.fanfics->GetFicsForRecCreation();
+        fetchedFics = FetchSourceFics(reqContext, sourceFics);
     });
     action.run();
     core::FavListDetails result;
 
     core::FicListDataAccumulator dataAccumulator;
-    auto genresInterface  = QSharedPointer<interfaces::Genres> (new interfaces::Genres());
-    genresInterface->db = reqContext.dbContext.dbInterface->GetDatabase();;
-    interfaces::GenreConverter conv;
-    An<interfaces::GenreIndex> genreIndex;
-    for(const auto& fic: std::as_const(fetchedFics))
+    // every fic is visited once, the records are read as they are
+    for(const auto& fic : std::as_const(fetchedFics))
     {
-        fic->genres = conv.GetFFNGenreList(fic->genreString);
-        for(const auto& genre: std::as_const(fic->genres))
-        {
-            if(auto genreObject = genreIndex->GenreByName(genre); genreObject.isValid)
-            {
-                auto index = genreObject.indexInDatabase;
-                dataAccumulator.genreCounters[index]++;
-            }
-        }
-        dataAccumulator.AddFandoms(fic->fandoms);
+        if(!fic)
+            continue;
+        const auto genreMask = fic->genreMask;
+        for(size_t index = 0; index < dataAccumulator.genreCounters.size(); index++)
+            dataAccumulator.genreCounters[index] += (genreMask >> index) & 1u;
+        dataAccumulator.AddFandoms(fic->fandoms.size() > 0 ? fic->fandoms.at(0) : -1,
+                                   fic->fandoms.size() > 1 ? fic->fandoms.at(1) : -1);
         dataAccumulator.AddFavourites(fic->favCount);
         dataAccumulator.AddPublishDate(fic->published);
         dataAccumulator.AddWordcount(fic->wordCount, fic->chapterCount);
@@ -899,7 +1113,7 @@ grpc::Status FeederService::GetFavListDetails(grpc::ServerContext *context,
 
 grpc::Status FeederService::GetAuthorsForFicList(grpc::ServerContext *context, const ProtoSpace::AuthorsForFicsRequest *task, ProtoSpace::AuthorsForFicsResponse *response)
 {
-    Q_UNUSED(context);
+    CallCancellation cancellation(context);
     RequestContext reqContext("Authors for fics",task->controls(), this);
     if(!reqContext.Process(response->mutable_response_info()))
         return Status::OK;
@@ -932,7 +1146,7 @@ grpc::Status FeederService::GetAuthorsForFicList(grpc::ServerContext *context, c
 
 grpc::Status FeederService::GetAuthorsFromRecListContainingFic(grpc::ServerContext *context, const ProtoSpace::AuthorsForFicInReclistRequest *task, ProtoSpace::AuthorsForFicInReclistResponse *response)
 {
-    Q_UNUSED(context);
+    CallCancellation cancellation(context);
     RequestContext reqContext("Authors for fic in reclist", task->controls(), this);
     if(!reqContext.Process(response->mutable_response_info()))
         return Status::OK;
@@ -1075,6 +1289,18 @@ void FeederService::PrintStatistics(){
     STAT_INFO() << "Generic: " << genericSearches;
     STAT_INFO() << "Recommendations: " << recommendationsSearches;
     STAT_INFO() << "Random: " << randomSearches;
+    if(similarFicTable)
+        STAT_INFO() << "Similar fic table hits: " << similarFicTableHits.load() << " misses: " << similarFicTableMisses.load();
+    if(recListCache)
+    {
+        const auto cacheStatistics = recListCache->GetStatistics();
+        STAT_INFO() << "Reclist cache hits: " << cacheStatistics.hits
+                    << " misses: " << cacheStatistics.misses
+                    << " coalesced: " << cacheStatistics.coalesced;
+        STAT_INFO() << "Reclist cache entries: " << cacheStatistics.entries
+                    << " bytes: " << cacheStatistics.bytes
+                    << " evictions: " << cacheStatistics.evictions;
+    }
 }
 
 bool FeederService::VerifySearchInput(QString userToken,
@@ -1151,12 +1377,13 @@ QSharedPointer<FicSource> FeederService::InitFicSource(QString userToken,
                                                        QSharedPointer<database::IDBWrapper> dbInterface)
 {
     //DatabaseContext dbContext;
-    QSharedPointer<FicSource> ficSource(new FicSourceDirect(dbInterface,rngData));
-    auto* convertedFicSource = dynamic_cast<FicSourceDirect*>(ficSource.data());
+    QSharedPointer<FicSourceDirect> directSource(new FicSourceDirect(dbInterface,rngData));
     QLOG_TRACE() << "Initializing fic source mode";
-    convertedFicSource->InitQueryType(true, userToken);
+    directSource->InitQueryType(true, userToken);
     //QLOG_INFO() << "Initialized fic source mode";
-    return ficSource;
+    if(searchIndex)
+        return QSharedPointer<FicSource>(new FicSourceBitmap(searchIndex, directSource));
+    return directSource;
 }
 
 QSet<int> FeederService::ProcessIDPackIntoFfnFicSet(const ProtoSpace::SiteIDPack & pack)
@@ -0,0 +1,219 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "servers/feed_async.h"
+#include "logger/QsLog.h"
+
+#include <QSettings>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace {
+class AsyncCallBase{
+public:
+    virtual ~AsyncCallBase() = default;
+    virtual void Proceed(bool ok) = 0;
+};
+
+// a single call of one rpc method
+// lives from the moment it starts waiting for a request until its response is sent
+template <typename Request, typename Response>
+class AsyncCall : public AsyncCallBase{
+public:
+    using Responder = grpc::ServerAsyncResponseWriter<Response>;
+    using RequestFunction = std::function<void(grpc::ServerContext*, Request*, Responder*, grpc::ServerCompletionQueue*, void*)>;
+    using HandlerFunction = std::function<grpc::Status(grpc::ServerContext*, const Request*, Response*)>;
+
+    AsyncCall(AsyncCallLane* lane, RequestFunction requestFunction, HandlerFunction handler)
+        : lane(lane), requestFunction(requestFunction), handler(handler), responder(&context), doneTag(this)
+    {
+        // handlers poll IsCancelled, with the async api it only works for calls that asked to be notified
+        context.AsyncNotifyWhenDone(&doneTag);
+        requestFunction(&context, &request, &responder, lane->queue.get(), this);
+    }
+
+    void Proceed(bool ok) override{
+        // the response is sent
+        if(responding){
+            Release();
+            return;
+        }
+        // the server is shutting down, a call that never started doesn't get the done notification
+        if(!ok){
+            delete this;
+            return;
+        }
+        responding = true;
+        // keeps the method accepting new calls while this one is processed
+        if(lane->accepting)
+            new AsyncCall(lane, requestFunction, handler);
+
+        if(lane->maxPending > 0 && ++lane->pending > lane->maxPending)
+        {
+            lane->pending--;
+            QLOG_WARN() << "Rejecting call, lane is busy:" << lane->name;
+            responder.FinishWithError(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Server is busy, try again later"), this);
+            return;
+        }
+        QtConcurrent::run(&lane->workers, [this](){
+            auto status = handler(&context, &request, &response);
+            if(lane->maxPending > 0)
+                lane->pending--;
+            responder.Finish(response, status, this);
+        });
+    }
+
+private:
+    // delivered when the call is finished or cancelled, either before or after the response is sent
+    struct DoneTag : public AsyncCallBase{
+        explicit DoneTag(AsyncCall* call):call(call){}
+        void Proceed(bool) override{
+            call->Release();
+        }
+        AsyncCall* call = nullptr;
+    };
+
+    // both events come through the completion queue of the lane, so from the same poller thread
+    void Release(){
+        if(--pendingEvents == 0)
+            delete this;
+    }
+
+    AsyncCallLane* lane = nullptr;
+    RequestFunction requestFunction;
+    HandlerFunction handler;
+    grpc::ServerContext context;
+    Request request;
+    Response response;
+    Responder responder;
+    DoneTag doneTag;
+    // the sent response and the done notification
+    int pendingEvents = 2;
+    bool responding = false;
+};
+}
+
+AsyncCallLane::AsyncCallLane(QString name, int threads, int maxPending):name(name), maxPending(maxPending)
+{
+    workers.setMaxThreadCount(std::max(1, threads));
+    // handlers open their database connections per thread, keeping the threads alive lets them reuse those
+    workers.setExpiryTimeout(-1);
+}
+
+FeederAsyncServer::FeederAsyncServer(FeederService* service, QSettings& settings):
+    service(service),
+    fastLane("fast",
+             settings.value("AsyncServer/fastThreads", 2).toInt(),
+             settings.value("AsyncServer/fastMaxPending", 64).toInt()),
+    commonLane("common",
+               settings.value("AsyncServer/commonThreads", QThread::idealThreadCount()).toInt(),
+               settings.value("AsyncServer/commonMaxPending", 128).toInt()),
+    heavyLane("heavy",
+              settings.value("AsyncServer/heavyThreads", 2).toInt(),
+              settings.value("AsyncServer/heavyMaxPending", 8).toInt())
+{
+}
+
+#define ASYNC_CALL(LANE, METHOD, REQUEST, RESPONSE) \
+    new AsyncCall<ProtoSpace::REQUEST, ProtoSpace::RESPONSE>(&LANE, \
+        [this](grpc::ServerContext* context, ProtoSpace::REQUEST* request, \
+               grpc::ServerAsyncResponseWriter<ProtoSpace::RESPONSE>* responder, \
+               grpc::ServerCompletionQueue* queue, void* tag){ \
+            asyncService.Request##METHOD(context, request, responder, queue, queue, tag);}, \
+        [this](grpc::ServerContext* context, const ProtoSpace::REQUEST* request, ProtoSpace::RESPONSE* response){ \
+            return service->METHOD(context, request, response);})
+
+void FeederAsyncServer::RegisterCalls()
+{
+    ASYNC_CALL(fastLane, GetStatus, StatusRequest, StatusResponse);
+    ASYNC_CALL(fastLane, SearchByFFNID, SearchByFFNIDTask, SearchByFFNIDResponse);
+    ASYNC_CALL(fastLane, GetFicCount, FicCountTask, FicCountResponse);
+
+    ASYNC_CALL(heavyLane, RecommendationListCreation, RecommendationListCreationRequest, RecommendationListCreationResponse);
+    ASYNC_CALL(heavyLane, DiagnosticRecommendationListCreation, DiagnosticRecommendationListCreationRequest, DiagnosticRecommendationListCreationResponse);
+    ASYNC_CALL(heavyLane, GetUserMatches, UserMatchRequest, UserMatchResponse);
+
+    ASYNC_CALL(commonLane, Search, SearchTask, SearchResponse);
+    ASYNC_CALL(commonLane, SearchByIdList, SearchByIdListTask, SearchByIdListResponse);
+    ASYNC_CALL(commonLane, SyncFandomList, SyncFandomListTask, SyncFandomListResponse);
+    ASYNC_CALL(commonLane, GetDBFicIDS, FicIdRequest, FicIdResponse);
+    ASYNC_CALL(commonLane, GetFFNFicIDS, FicIdRequest, FicIdResponse);
+    ASYNC_CALL(commonLane, GetFavListDetails, FavListDetailsRequest, FavListDetailsResponse);
+    ASYNC_CALL(commonLane, GetAuthorsForFicList, AuthorsForFicsRequest, AuthorsForFicsResponse);
+    ASYNC_CALL(commonLane, GetAuthorsFromRecListContainingFic, AuthorsForFicInReclistRequest, AuthorsForFicInReclistResponse);
+    ASYNC_CALL(commonLane, GetExpiredSnoozes, SnoozeInfoRequest, SnoozeInfoResponse);
+}
+#undef ASYNC_CALL
+
+void FeederAsyncServer::PollLane(AsyncCallLane* lane)
+{
+    void* tag = nullptr;
+    bool ok = false;
+    while(lane->queue->Next(&tag, &ok))
+        static_cast<AsyncCallBase*>(tag)->Proceed(ok);
+    QLOG_INFO() << "Completion queue drained:" << lane->name;
+}
+
+void FeederAsyncServer::Run(const std::string& address)
+{
+    ServerBuilder builder;
+    builder.AddListeningPort(address, grpc::InsecureServerCredentials());
+    builder.RegisterService(&asyncService);
+    builder.SetMaxMessageSize(1024 * 1024 * 1024);
+    std::vector<AsyncCallLane*> lanes = {&fastLane, &commonLane, &heavyLane};
+    for(auto lane : lanes)
+        lane->queue = builder.AddCompletionQueue();
+    {
+        std::lock_guard<std::mutex> lock(serverLock);
+        server = builder.BuildAndStart();
+        if(shutdownRequested)
+            server->Shutdown();
+    }
+    RegisterCalls();
+    for(auto lane : lanes)
+        QLOG_INFO() << "Async lane:" << lane->name << "threads:" << lane->workers.maxThreadCount() << "max pending:" << lane->maxPending;
+
+    std::vector<std::thread> pollers;
+    for(auto lane : lanes)
+        pollers.emplace_back(&FeederAsyncServer::PollLane, this, lane);
+
+    server->Wait();
+    // handlers still need the queues to send their responses
+    for(auto lane : lanes)
+        lane->workers.waitForDone();
+    for(auto lane : lanes)
+        lane->queue->Shutdown();
+    for(auto& poller : pollers)
+        poller.join();
+}
+
+void FeederAsyncServer::Shutdown()
+{
+    for(auto lane : {&fastLane, &commonLane, &heavyLane})
+        lane->accepting = false;
+    std::lock_guard<std::mutex> lock(serverLock);
+    if(shutdownRequested)
+        return;
+    shutdownRequested = true;
+    QLOG_INFO() << "Shutting down async server";
+    if(server)
+        server->Shutdown();
+}
@@ -0,0 +1,122 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "servers/rec_list_cache.h"
+
+namespace {
+// hash node, list node and the key copy in the recency list
+constexpr uint64_t entryOverhead = 96;
+}
+
+RecListCache::RecListCache(uint64_t maxBytes):maxBytes(maxBytes)
+{
+}
+
+QByteArray RecListCache::GetOrCompute(const QByteArray& key, const std::function<QByteArray()>& compute, bool* computedHere)
+{
+    QMutexLocker locker(&lock);
+    auto entry = entries.find(key);
+    if(entry != entries.end())
+    {
+        statistics.hits++;
+        recency.splice(recency.begin(), recency, entry->recencyPosition);
+        *computedHere = false;
+        return entry->value;
+    }
+
+    auto flight = inFlight.value(key);
+    if(flight)
+    {
+        statistics.coalesced++;
+        while(!flight->done)
+            flight->finished.wait(&lock);
+        if(!flight->result.isEmpty())
+        {
+            *computedHere = false;
+            return flight->result;
+        }
+        locker.unlock();
+        *computedHere = true;
+        return compute();
+    }
+
+    statistics.misses++;
+    flight = QSharedPointer<InFlight>::create();
+    inFlight.insert(key, flight);
+    locker.unlock();
+
+    // waiters must be released even if the calculation throws
+    struct FlightGuard{
+        ~FlightGuard(){
+            if(!finished)
+                cache->Finish(key, flight, QByteArray());
+        }
+        RecListCache* cache;
+        const QByteArray& key;
+        QSharedPointer<InFlight> flight;
+        bool finished = false;
+    } guard{this, key, flight};
+
+    auto result = compute();
+    guard.finished = true;
+    Finish(key, flight, result);
+    *computedHere = true;
+    return result;
+}
+
+void RecListCache::Finish(const QByteArray& key, QSharedPointer<InFlight> flight, const QByteArray& result)
+{
+    QMutexLocker locker(&lock);
+    if(!result.isEmpty())
+        Insert(key, result);
+    flight->result = result;
+    flight->done = true;
+    inFlight.remove(key);
+    flight->finished.wakeAll();
+}
+
+void RecListCache::Insert(const QByteArray& key, const QByteArray& value)
+{
+    const auto size = EntrySize(key, value);
+    if(size > maxBytes)
+        return;
+    while(statistics.bytes + size > maxBytes && !recency.empty())
+    {
+        auto evicted = entries.find(recency.back());
+        statistics.bytes -= EntrySize(evicted.key(), evicted->value);
+        entries.erase(evicted);
+        recency.pop_back();
+        statistics.evictions++;
+    }
+    recency.push_front(key);
+    entries.insert(key, {value, recency.begin()});
+    statistics.bytes += size;
+    statistics.entries = static_cast<uint64_t>(entries.size());
+}
+
+uint64_t RecListCache::EntrySize(const QByteArray& key, const QByteArray& value)
+{
+    return static_cast<uint64_t>(value.size()) + 2*static_cast<uint64_t>(key.size()) + entryOverhead;
+}
+
+RecListCache::Statistics RecListCache::GetStatistics() const
+{
+    QMutexLocker locker(&lock);
+    auto result = statistics;
+    result.entries = static_cast<uint64_t>(entries.size());
+    return result;
+}
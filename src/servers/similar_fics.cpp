@@ -0,0 +1,147 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "servers/similar_fics.h"
+#include "favholder.h"
+#include "timeutils.h"
+#include "core/recommendation_list.h"
+#include "grpc/grpc_source.h"
+#include "logger/QsLog.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+static uint16_t ClampToRow(int value)
+{
+    return static_cast<uint16_t>(std::clamp(value, 0, static_cast<int>(std::numeric_limits<uint16_t>::max())));
+}
+
+bool BuildSimilarFicTable(core::RecCalculator& calculator, const SimilarFicsSettings& settings)
+{
+    const auto& ficStore = calculator.holder.ficStore;
+    std::vector<core::SimilarFicRow> rows;
+    std::vector<core::SimilarFicEntry> entries;
+    int calculated = 0;
+    int failed = 0;
+
+    TimedAction buildAction("Building similar fic table",[&](){
+        for(uint32_t ordinal = 0; ordinal < ficStore.Size(); ordinal++)
+        {
+            if(ficStore.favCount[ordinal] < settings.minimumFavourites)
+                continue;
+            const auto ficId = ficStore.ids[ordinal];
+            QHash<uint32_t, core::FicWeightPtr> sourceFics;
+            sourceFics.insert(ficId, ficStore.Materialize(ordinal));
+
+            auto params = core::RecommendationList::NewSimilarFicList();
+            params->resultLimit = static_cast<int>(settings.neighbours);
+            const auto list = calculator.GetMatchedFicsForFavList(sourceFics, params);
+            calculated++;
+            if(calculated % 1000 == 0)
+                QLOG_INFO() << "Similar fic lists calculated: " << calculated << " rows: " << rows.size();
+            if(!list.success)
+            {
+                failed++;
+                continue;
+            }
+
+            // same order LimitResults picks fics in so that a shorter list is a prefix of the row
+            std::vector<std::pair<int, uint32_t>> neighbours;
+            neighbours.reserve(static_cast<size_t>(list.limitedResults.size()));
+            // fics missing from the store are kept, the live list only skips them after the result limit is applied
+            for(auto fic : list.limitedResults)
+                neighbours.push_back({list.recommendations.value(fic), static_cast<uint32_t>(fic)});
+            std::sort(neighbours.begin(), neighbours.end(), [](const auto& left, const auto& right){
+                if(left.first != right.first)
+                    return left.first > right.first;
+                return left.second < right.second;
+            });
+
+            core::SimilarFicRow row;
+            row.ficId = ficId;
+            row.firstEntry = static_cast<uint32_t>(entries.size());
+            row.entryCount = ClampToRow(static_cast<int>(neighbours.size()));
+            row.flags = params->isAutomatic ? core::SimilarFicRow::rf_automatic : 0;
+            row.minimumMatch = ClampToRow(params->minimumMatch);
+            row.maxUnmatchedPerMatch = ClampToRow(params->maxUnmatchedPerMatch);
+            for(const auto& neighbour : neighbours)
+            {
+                core::SimilarFicEntry entry;
+                entry.ficId = neighbour.second;
+                entry.matches = static_cast<uint32_t>(std::max(1, neighbour.first));
+                entry.votes = static_cast<uint32_t>(std::max(0, list.pureMatches.value(static_cast<int>(neighbour.second))));
+                entries.push_back(entry);
+            }
+            rows.push_back(row);
+        }
+    });
+    buildAction.run();
+    QLOG_INFO() << "Similar fic lists calculated: " << calculated << " failed: " << failed << " stored: " << rows.size();
+
+    QDir().mkpath(QFileInfo(settings.fileName).absolutePath());
+    return core::SimilarFicTable::Save(settings.fileName, settings.neighbours, calculator.holder.FavouritesFingerprint(), rows, entries);
+}
+
+bool FillSimilarFicListFromTable(const core::SimilarFicTable& table, const core::FicStore& ficStore, uint32_t sourceFic,
+                                 const core::RecommendationList& params,
+                                 ProtoSpace::RecommendationListCreationResponse* response)
+{
+    if(params.resultLimit <= 0 || static_cast<uint32_t>(params.resultLimit) > table.NeighboursPerFic())
+        return false;
+    const auto* row = table.RowFor(sourceFic);
+    if(!row)
+        return false;
+
+    response->Clear();
+    auto* targetList = response->mutable_list();
+    targetList->set_success(true);
+    targetList->set_list_name(proto_converters::TS(params.name));
+    targetList->set_list_ready(true);
+
+    const auto count = std::min<uint32_t>(row->entryCount, static_cast<uint32_t>(params.resultLimit));
+    const auto* entries = table.EntriesOf(*row);
+    targetList->mutable_fic_ids()->Reserve(static_cast<int>(count));
+    targetList->mutable_fic_matches()->Reserve(static_cast<int>(count));
+    targetList->mutable_fic_votes()->Reserve(static_cast<int>(count));
+    targetList->mutable_purged()->Reserve(static_cast<int>(count));
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const auto& entry = entries[i];
+        if(!ficStore.Contains(entry.ficId))
+            continue;
+        // mood adjustment is never used for similar fic lists so nothing is purged
+        targetList->add_purged(0);
+        targetList->add_fic_matches(static_cast<int>(entry.matches));
+        targetList->add_fic_votes(static_cast<int>(entry.votes));
+        targetList->add_fic_ids(static_cast<int>(entry.ficId));
+        targetList->add_breakdowns()->set_id(static_cast<int>(entry.ficId));
+    }
+
+    auto* usedParams = targetList->mutable_used_params();
+    usedParams->set_is_automatic((row->flags & core::SimilarFicRow::rf_automatic) != 0);
+    usedParams->set_min_fics_to_match(row->minimumMatch);
+    usedParams->set_max_unmatched_to_one_matched(row->maxUnmatchedPerMatch);
+    usedParams->set_always_pick_at(params.alwaysPickAt);
+    usedParams->set_use_weighting(params.useWeighting);
+    usedParams->set_use_mood_filtering(params.useMoodAdjustment);
+    usedParams->set_use_dislikes(params.useDislikes);
+    usedParams->set_use_dead_fic_ignore(params.useDeadFicIgnore);
+    return true;
+}
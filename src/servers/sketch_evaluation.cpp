@@ -0,0 +1,119 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "servers/sketch_evaluation.h"
+#include "favholder.h"
+#include "core/recommendation_list.h"
+#include "logger/QsLog.h"
+
+#include <QElapsedTimer>
+#include <algorithm>
+#include <vector>
+
+namespace {
+struct TimedList{
+    QSet<int> fics;
+    qint64 milliseconds = 0;
+};
+
+TimedList CalculateList(core::RecCalculator& calculator, const QHash<uint32_t, core::FicWeightPtr>& sourceFics,
+                        int resultLimit, double sketchContainment)
+{
+    auto params = core::RecommendationList::NewRecList();
+    params->minimumMatch = 1;
+    params->isAutomatic = true;
+    params->useWeighting = true;
+    params->alwaysPickAt = 9999;
+    params->resultLimit = resultLimit;
+    params->sketchContainment = sketchContainment;
+
+    TimedList result;
+    QElapsedTimer timer;
+    timer.start();
+    const auto list = calculator.GetMatchedFicsForFavList(sourceFics, params);
+    result.milliseconds = timer.elapsed();
+    result.fics = list.limitedResults;
+    return result;
+}
+}
+
+void EvaluateRecommenderSketches(core::RecCalculator& calculator, const SketchEvaluationSettings& settings)
+{
+    const auto& holder = calculator.holder;
+    if(holder.recommenderSketches.IsEmpty())
+    {
+        QLOG_WARN() << "Recommender sketches aren't built, nothing to evaluate";
+        return;
+    }
+    std::vector<uint32_t> bigLists;
+    for(uint32_t ordinal = 0; ordinal < holder.authorOrdinals.Size(); ordinal++)
+        if(holder.authorOrdinals.favourites[ordinal]->cardinality() >= static_cast<uint64_t>(settings.minimumListSize))
+            bigLists.push_back(ordinal);
+    if(bigLists.empty() || settings.lists <= 0)
+    {
+        QLOG_WARN() << "No recommender lists of size: " << settings.minimumListSize;
+        return;
+    }
+    // spread over the whole id range so that the pick doesn't depend on the order of loading
+    std::vector<uint32_t> picked;
+    const auto step = std::max<size_t>(1, bigLists.size() / static_cast<size_t>(settings.lists));
+    for(size_t i = 0; i < bigLists.size() && picked.size() < static_cast<size_t>(settings.lists); i += step)
+        picked.push_back(bigLists[i]);
+    QLOG_INFO() << "Evaluating sketches on lists: " << picked.size() << " of: " << bigLists.size();
+
+    struct Totals{
+        double recall = 0;
+        qint64 milliseconds = 0;
+    };
+    QList<Totals> totals;
+    for(int i = 0; i < settings.containments.size(); i++)
+        totals.push_back({});
+    qint64 exactMilliseconds = 0;
+    int evaluated = 0;
+
+    for(auto ordinal : picked)
+    {
+        QHash<uint32_t, core::FicWeightPtr> sourceFics;
+        for(auto fic : *holder.authorOrdinals.favourites[ordinal])
+        {
+            const auto ficOrdinal = holder.ficStore.OrdinalFor(fic);
+            if(ficOrdinal != core::FicStore::invalidOrdinal)
+                sourceFics.insert(fic, holder.ficStore.Materialize(ficOrdinal));
+        }
+        const auto exact = CalculateList(calculator, sourceFics, settings.resultLimit, 0);
+        if(exact.fics.isEmpty())
+            continue;
+        evaluated++;
+        exactMilliseconds += exact.milliseconds;
+        for(int i = 0; i < settings.containments.size(); i++)
+        {
+            const auto approximate = CalculateList(calculator, sourceFics, settings.resultLimit, settings.containments.at(i));
+            const auto found = QSet<int>(exact.fics).intersect(approximate.fics).size();
+            totals[i].recall += static_cast<double>(found) / static_cast<double>(exact.fics.size());
+            totals[i].milliseconds += approximate.milliseconds;
+        }
+        QLOG_INFO() << "Evaluated list of author: " << holder.authorOrdinals.ids[ordinal] << " size: " << sourceFics.size();
+    }
+    if(evaluated == 0)
+        return;
+
+    QLOG_INFO() << "Exact path, lists: " << evaluated << " average ms: " << exactMilliseconds / evaluated;
+    for(int i = 0; i < settings.containments.size(); i++)
+        QLOG_INFO() << "Sketch containment: " << settings.containments.at(i)
+                    << " recall of top " << settings.resultLimit << ": " << totals[i].recall / evaluated
+                    << " average ms: " << totals[i].milliseconds / evaluated;
+}
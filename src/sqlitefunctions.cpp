@@ -26,11 +26,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include <QSettings>
 #include <QTextStream>
 #include <QCoreApplication>
+#include <algorithm>
+#include <cctype>
+#include <list>
+#include <unordered_map>
 //#include <third_party/quazip/quazip.h>
 //#include <third_party/quazip/JlCompress.h>
 #include "include/queryinterfaces.h"
 #include "include/transaction.h"
 #include "include/in_tag_accessor.h"
+#include "include/cancellation_token.h"
 #include "pure_sql.h"
 #include "logger/QsLog.h"
 #include "GlobalHeaders/snippets_templates.h"
@@ -410,6 +415,13 @@ void cfGetSecondFandom(sqlite3_context* ctx, int , sqlite3_value** argv)
     sqlite3_result_text(ctx, qPrintable(result), result.length(), SQLITE_TRANSIENT);
 }
 
+// a nonzero result interrupts the statement the same way sqlite3_interrupt does
+// called on the thread that runs the statement so it sees the token of the request being served there
+static int cfInterruptCancelled(void*)
+{
+    return CancellationScope::Current().IsCancelled() ? 1 : 0;
+}
+
 bool InstallCustomFunctions(sql::Database db){
     return InstallCustomFunctions(*static_cast<QSqlDatabase*>(db.internalPointer()));
 }
@@ -443,6 +455,8 @@ bool InstallCustomFunctions(QSqlDatabase db)
             sqlite3_create_function(db_handle, "cfInActiveTags", 1, SQLITE_UTF8 , nullptr, &cfInActiveTags, nullptr, nullptr);
             sqlite3_create_function(db_handle, "cfInFicSelection", 1, SQLITE_UTF8 , nullptr, &cfInFicSelection, nullptr, nullptr);
             sqlite3_create_function(db_handle, "cfGetFirstFandom", 1, SQLITE_UTF8 , nullptr, &cfGetFirstFandom, nullptr, nullptr);
+            // about a millisecond of work between the checks
+            sqlite3_progress_handler(db_handle, 10000, &cfInterruptCancelled, nullptr);
 
             //QLOG_INFO() << "Installed funcs succesfully";
             return true;
@@ -637,6 +651,118 @@ sql::Database InitSqliteDatabase(QString name, bool setDefault)
     return db;
 }
 
+// queries with inlined id lists would grow the cache indefinitely, the least recently used statement is dropped above this size
+static constexpr size_t maxCachedStatements = 128;
+struct CachedStatement{
+    sql::Query query;
+    // names of the :placeholders in the sql text, all of them are rebound on every checkout
+    std::vector<std::string> placeholders;
+    std::list<std::string>::iterator lruPosition;
+};
+struct StatementCache{
+    std::unordered_map<std::string, CachedStatement> statements;
+    // most recently used first
+    std::list<std::string> lru;
+
+    void Evict(std::unordered_map<std::string, CachedStatement>::iterator it){
+        lru.erase(it->second.lruPosition);
+        statements.erase(it);
+    }
+};
+static thread_local std::unordered_map<void*, StatementCache> statementCaches;
+
+static std::vector<std::string> ParsePlaceholders(const std::string& text)
+{
+    std::vector<std::string> result;
+    auto isNameChar = [](char c){return std::isalnum(static_cast<unsigned char>(c)) || c == '_';};
+    for(size_t i = 0; i + 1 < text.size(); i++)
+    {
+        // '::::' separators and times like '00:00' aren't placeholders
+        if(text[i] != ':' || !(std::isalpha(static_cast<unsigned char>(text[i+1])) || text[i+1] == '_'))
+            continue;
+        if(i > 0 && (text[i-1] == ':' || isNameChar(text[i-1])))
+            continue;
+        size_t end = i + 1;
+        while(end < text.size() && isNameChar(text[end]))
+            end++;
+        auto name = text.substr(i + 1, end - i - 1);
+        if(std::find(result.begin(), result.end(), name) == result.end())
+            result.push_back(std::move(name));
+        i = end - 1;
+    }
+    return result;
+}
+
+static void BindValues(sql::Query& q, const std::string& text, const QList<sql::QueryBinding>& bindings)
+{
+    for(const auto& binding : bindings)
+    {
+        if(text.find(binding.key) != std::string::npos)
+            q.bindValue(binding.key, binding.value);
+        else
+            qDebug() << "Key not found: " << binding.key;
+    }
+}
+
+static sql::Query PrepareUncached(const std::string& text, const QList<sql::QueryBinding>& bindings, sql::Database db)
+{
+    sql::Query q(db);
+    q.prepare(text);
+    BindValues(q, text, bindings);
+    return q;
+}
+
+void EnableStatementCache(sql::Database db)
+{
+    statementCaches[db.internalPointer()];
+}
+
+sql::Query PrepareCached(const std::string& text, const QList<sql::QueryBinding>& bindings, sql::Database db)
+{
+    auto cache = statementCaches.find(db.internalPointer());
+    if(cache == statementCaches.end())
+        return PrepareUncached(text, bindings, db);
+
+    auto& statements = cache->second;
+    auto it = statements.statements.find(text);
+    // a statement that failed, or was interrupted by the progress handler, is prepared again
+    if(it != statements.statements.end() && it->second.query.lastError().isValid())
+    {
+        QLOG_INFO() << "Evicting failed cached statement:" << QString::fromStdString(it->second.query.lastError().text());
+        statements.Evict(it);
+        it = statements.statements.end();
+    }
+    if(it == statements.statements.end())
+    {
+        auto placeholders = ParsePlaceholders(text);
+        sql::Query q(db);
+        if(!q.prepare(text))
+        {
+            BindValues(q, text, bindings);
+            return q;
+        }
+        if(statements.statements.size() >= maxCachedStatements)
+            statements.Evict(statements.statements.find(statements.lru.back()));
+        statements.lru.push_front(text);
+        it = statements.statements.emplace(text, CachedStatement{q, std::move(placeholders), statements.lru.begin()}).first;
+    }
+    else
+        statements.lru.splice(statements.lru.begin(), statements.lru, it->second.lruPosition);
+
+    auto& cached = it->second;
+    // values bound by the previous user of the statement would otherwise leak into this one
+    for(const auto& placeholder : cached.placeholders)
+    {
+        auto bound = std::find_if(bindings.begin(), bindings.end(), [&](const sql::QueryBinding& binding){return binding.key == placeholder;});
+        if(bound == bindings.end())
+            return PrepareUncached(text, bindings, db);
+    }
+    // releases the result set of the previous execution
+    cached.query.finish();
+    BindValues(cached.query, text, bindings);
+    return cached.query;
+}
+
 int CreateNewTask(sql::Database db)
 {
     Transaction tr(db);
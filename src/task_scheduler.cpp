@@ -0,0 +1,198 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017-2020  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "include/task_scheduler.h"
+
+#include <QThread>
+#include <algorithm>
+
+struct TaskScheduler::TaskGroup{
+    std::mutex lock;
+    std::condition_variable finished;
+    size_t remaining = 0;
+};
+
+TaskScheduler::TaskScheduler(int threads)
+{
+    threads = std::max(1, threads);
+    for(int i = 0; i < threads; i++)
+        queues.emplace_back(new WorkerQueue);
+    for(int i = 0; i < threads; i++)
+        workers.emplace_back(&TaskScheduler::WorkerLoop, this, static_cast<size_t>(i));
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for(auto& worker : workers)
+        worker.join();
+}
+
+TaskScheduler &TaskScheduler::Instance()
+{
+    static TaskScheduler scheduler(QThread::idealThreadCount() - 1);
+    return scheduler;
+}
+
+void TaskScheduler::Run(std::vector<std::function<void()>> &&tasks)
+{
+    if(tasks.empty())
+        return;
+    if(tasks.size() == 1)
+    {
+        tasks.front()();
+        return;
+    }
+
+    TaskGroup group;
+    group.remaining = tasks.size();
+    const size_t firstQueue = nextQueue.fetch_add(tasks.size());
+    for(size_t i = 0; i < tasks.size(); i++)
+    {
+        auto& queue = *queues[(firstQueue + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.tasks.push_back({std::move(tasks[i]), &group});
+        queuedTasks++;
+    }
+    {
+        // workers check queuedTasks under this lock, taking it here means none of them misses the notification
+        std::lock_guard<std::mutex> guard(sleepLock);
+    }
+    wakeUp.notify_all();
+
+    Task task;
+    while(TryTake(firstQueue % queues.size(), task))
+        Execute(task);
+    // whatever is left of the group is running on the workers
+    std::unique_lock<std::mutex> lock(group.lock);
+    group.finished.wait(lock, [&group](){return group.remaining == 0;});
+}
+
+std::vector<TaskRange> TaskScheduler::SplitByCost(size_t count, const std::function<uint64_t (size_t)> &cost) const
+{
+    std::vector<TaskRange> ranges;
+    if(count == 0)
+        return ranges;
+    std::vector<uint64_t> costs(count);
+    uint64_t totalCost = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        // empty items still need to be visited
+        costs[i] = cost(i) + 1;
+        totalCost += costs[i];
+    }
+    // a few chunks per thread, the calling thread included, so that there is something left to steal
+    const uint64_t chunkCount = static_cast<uint64_t>(workers.size() + 1) * 4;
+    const uint64_t chunkCost = std::max<uint64_t>(1, totalCost / chunkCount);
+    size_t begin = 0;
+    uint64_t currentCost = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        currentCost += costs[i];
+        if(currentCost >= chunkCost)
+        {
+            ranges.push_back({begin, i + 1});
+            begin = i + 1;
+            currentCost = 0;
+        }
+    }
+    if(begin < count)
+        ranges.push_back({begin, count});
+    return ranges;
+}
+
+std::vector<TaskRange> TaskScheduler::SplitEvenly(size_t count, size_t minimumChunk) const
+{
+    std::vector<TaskRange> ranges;
+    if(count == 0)
+        return ranges;
+    const size_t chunkCount = std::max<size_t>(1, std::min((workers.size() + 1) * 4, count / std::max<size_t>(1, minimumChunk)));
+    const size_t chunkSize = count / chunkCount;
+    for(size_t i = 0; i < chunkCount; i++)
+        ranges.push_back({i * chunkSize, i == chunkCount - 1 ? count : (i + 1) * chunkSize});
+    return ranges;
+}
+
+void TaskScheduler::ParallelFor(const std::vector<TaskRange> &ranges, const std::function<void (size_t, size_t)> &body)
+{
+    std::vector<std::function<void()>> tasks;
+    tasks.reserve(ranges.size());
+    for(const auto& range : ranges)
+        tasks.push_back([&body, range](){body(range.first, range.second);});
+    Run(std::move(tasks));
+}
+
+void TaskScheduler::WorkerLoop(size_t index)
+{
+    Task task;
+    while(true)
+    {
+        if(TryTake(index, task))
+        {
+            Execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepLock);
+        wakeUp.wait(lock, [this](){return stopping || queuedTasks.load() > 0;});
+        if(stopping && queuedTasks.load() == 0)
+            return;
+    }
+}
+
+bool TaskScheduler::TryTake(size_t index, Task &task)
+{
+    {
+        auto& own = *queues[index];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if(!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queuedTasks--;
+            return true;
+        }
+    }
+    for(size_t offset = 1; offset < queues.size(); offset++)
+    {
+        auto& other = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> guard(other.lock);
+        if(!other.tasks.empty())
+        {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            queuedTasks--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::Execute(Task &task)
+{
+    task.function();
+    task.function = nullptr;
+    auto* group = task.group;
+    // the group lives on the stack of the thread that waits for it
+    // it can only go away once this lock is released
+    std::lock_guard<std::mutex> guard(group->lock);
+    if(--group->remaining == 0)
+        group->finished.notify_all();
+}
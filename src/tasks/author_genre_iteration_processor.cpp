@@ -21,9 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include "include/Interfaces/genres.h"
 #include "include/timeutils.h"
 #include "include/statistics_utils.h"
-
-#include <QThread>
-#include <QtConcurrent>
+#include "include/task_scheduler.h"
 
 AuthorGenreIterationProcessor::AuthorGenreIterationProcessor()
 {
@@ -37,129 +35,63 @@ struct AuthorGenreData{
     std::array<double, 22> genreFactors;
 };
 
-struct IteratorTask{
-    QHash<int, Roaring>::iterator start;
-    QHash<int, Roaring>::iterator end;
-};
-
-
 struct GenreResult{
     AuthorGenreData genreData;
     genre_stats::ListMoodData moodData;
 };
+
 void AuthorGenreIterationProcessor::ReprocessGenreStats(QHash<int, QList<genre_stats::GenreBit> > inputFicData,
                                                         QHash<int, Roaring> inputAuthorData)
 {
-    statistics_utils::UserPageSource source;
-    statistics_utils::UserPageSink<AuthorGenreData> sink;
-
-    QList<IteratorTask> iteratorTasks;
-    int processingThreads = QThread::idealThreadCount()-1;
-    int chunkSize = inputAuthorData.size()/processingThreads;
-    int i = 0;
-    for(; i < processingThreads; i++)
-        iteratorTasks.push_back({std::next(inputAuthorData.begin(), i*chunkSize), (i + 1) == processingThreads ? inputAuthorData.end() : std::next(inputAuthorData.begin(), (i+1)*chunkSize)});
+    core::FicGenreVectors ficVectors;
+    ficVectors.Build(inputFicData);
+    ReprocessGenreStats(ficVectors, inputAuthorData);
+}
 
-    sink.tokens.reserve(inputAuthorData.size());
-    auto processor = [](IteratorTask task, const QHash<int, QList<genre_stats::GenreBit>> inputFicData) -> QList<GenreResult> {
-        auto it = task.start;
-        QList<GenreResult> result;
-        result.reserve(std::distance(task.start, task.end));
-        An<interfaces::GenreIndex> genreIndex;
-        thread_local AuthorGenreData data;
-        thread_local genre_stats::ListMoodData moodData;
-        thread_local QHash<QString, float> genreKeeper;
-        while(it != task.end)
+void AuthorGenreIterationProcessor::ReprocessGenreStats(const core::FicGenreVectors &ficVectors,
+                                                        const QHash<int, Roaring> &inputAuthorData)
+{
+    std::vector<QHash<int, Roaring>::const_iterator> authors;
+    authors.reserve(static_cast<size_t>(inputAuthorData.size()));
+    for(auto it = inputAuthorData.cbegin(); it != inputAuthorData.cend(); it++)
+        authors.push_back(it);
+
+    // chunks of about the same amount of fics so that the one holding the longest lists doesn't finish far behind the others
+    auto& scheduler = TaskScheduler::Instance();
+    const auto ranges = scheduler.SplitByCost(authors.size(), [&authors](size_t index) -> uint64_t {
+        return authors[index].value().cardinality();
+    });
+    std::vector<GenreResult> results(authors.size());
+    scheduler.ParallelFor(ranges, [&](size_t begin, size_t end){
+        core::FicGenreAccumulator accumulator;
+        for(size_t index = begin; index < end; index++)
         {
-            data.Clear();
-            moodData.Clear();
-            genreKeeper.clear();
-            //interfaces::Genres::LogGenreDistribution(data.genreFactors, "this is supposed to be clean");
-            data.authorId = it.key();
-            int ficTotal = it.value().cardinality();
-            //QLOG_INFO() << "Total fics for author id: " << it.key() << " : " << ficTotal;
-            for(auto ficId : it.value())
-            {
-                QHash<int, QList<genre_stats::GenreBit>>::const_iterator ficIt = inputFicData.find(ficId);
-                if(ficIt == inputFicData.end())
-                {
-                    QLOG_INFO() << "No data for fic: " << ficId;
-                    continue;
-                }
-                QString log = "genres for fic: " +  QString::number(ficId) + " ";
-                QHash<QString, float> moodHashForFic;
-                moodHashForFic.clear();
-                for(const auto& genreBit: ficIt.value())
-                {
-                    for(auto actualBit: std::as_const(genreBit.genres))
-                    {
-
-                        actualBit = actualBit.trimmed();
-                        //if(genreBit.isInTheOriginal)
-                        log +=  "{"  + actualBit + " " + QString::number(genreBit.relevance) + "} ";
-
-                        QString moodForGenre = interfaces::Genres::MoodForGenre(actualBit);
-
-//                        if( ((genreBit.relevance > 0.5 && moodForGenre != "Hurty" && moodForGenre != "Bondy") || genreBit.isInTheOriginal)
-//                                || genreBit.relevance > 1 )
-                        if(genreBit.isInTheOriginal)
-                        {
-                            genreKeeper[actualBit] += genreBit.relevance;
-
-                            if(!moodHashForFic.contains(moodForGenre) || moodHashForFic[moodForGenre] < genreBit.relevance)
-                                moodHashForFic[moodForGenre] = 1;
-                                //moodHashForFic[moodForGenre] = genreBit.relevance;
-
-                        }
-                    }
-                }
-
-                for(auto i = moodHashForFic.begin(); i != moodHashForFic.end(); i++)
-                    interfaces::Genres::WriteMoodValue(i.key(), i.value(), moodData);
-
-                //QLOG_INFO() << log;
-
-            }
-
-            for(auto i = genreKeeper.begin(); i != genreKeeper.end(); i++)
-            {
-                double factor = static_cast<double>(i.value())/static_cast<double>(ficTotal);
-                //QLOG_INFO() << "Appending value of: " << genre << " " << factor;
-                data.genreFactors[genreIndex->IndexByFFNName(i.key())] += factor;
-                //interfaces::Genres::LogGenreDistribution(data.genreFactors);
-            }
-            //QLOG_INFO() << "Genre distribution for author: " << data.authorId;
-            //interfaces::Genres::LogGenreDistribution(data.genreFactors);
-            //moodData.Log();
-            moodData.DivideByCount(ficTotal);
-            result.push_back({data, moodData});
-            it++;
+            const auto& it = authors[index];
+            auto& authorResult = results[index];
+            accumulator.Clear();
+            ficVectors.Accumulate(it.value(), accumulator);
+            authorResult.genreData.authorId = it.key();
+            accumulator.Finalize(static_cast<int>(it.value().cardinality()), authorResult.genreData.genreFactors, authorResult.moodData);
         }
-        return result;
-    };
+    });
 
-    QVector<QFuture<QList<GenreResult>>> futures;
-    futures.reserve(processingThreads);
-    for(int i = 0; i < processingThreads; i++)
+    resultingGenreAuthorData.reserve(resultingGenreAuthorData.size() + inputAuthorData.size());
+    resultingMoodAuthorData.reserve(resultingMoodAuthorData.size() + inputAuthorData.size());
+    for(const auto& data : results)
     {
-        futures.push_back(QtConcurrent::run(processor, iteratorTasks[i], inputFicData));
+        resultingGenreAuthorData[data.genreData.authorId] = data.genreData.genreFactors;
+        resultingMoodAuthorData [data.genreData.authorId] = data.moodData;
     }
-    for(auto future: futures)
-    {
-        future.waitForFinished();
-    }
-    for(const auto& future: futures)
-    {
-        const auto& result = future.result();
-        for(auto data : std::as_const(result))
-        {
-            resultingGenreAuthorData[data.genreData.authorId] = data.genreData.genreFactors;
-            resultingMoodAuthorData [data.genreData.authorId] = data.moodData;
-        }
-    }
-
-    //resultingMoodAuthorData = CreateMoodDataFromGenres(resultingGenreAuthorData);
+}
 
+void AuthorGenreIterationProcessor::CalcListGenreStats(const core::FicGenreVectors &ficVectors,
+                                                       const Roaring &fics,
+                                                       std::array<double, 22> &genreData,
+                                                       genre_stats::ListMoodData &moodData)
+{
+    core::FicGenreAccumulator accumulator;
+    ficVectors.Accumulate(fics, accumulator);
+    accumulator.Finalize(static_cast<int>(fics.cardinality()), genreData, moodData);
 }
 
 
@@ -0,0 +1,339 @@
+/*
+Flipper is a recommendation and search engine for fanfiction.net
+Copyright (C) 2017  Marchenko Nikolai
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "threaded_data/snapshot.h"
+#include "threaded_data/common_traits.h"
+#include "task_scheduler.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QBuffer>
+#include <QDataStream>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace thread_boost{
+namespace snapshot{
+static constexpr char magic[8] = {'F','L','I','P','S','N','A','P'};
+static constexpr uint64_t dataOffset = sizeof(Header) + sizeof(ShardInfo) * shardCount;
+
+QString SnapshotFileName(QString storageFolder, QString fileBase)
+{
+    return storageFolder + QString("/") + fileBase + QString(".snapshot");
+}
+
+bool SnapshotExists(QString storageFolder, QString fileBase)
+{
+    return QFile::exists(SnapshotFileName(storageFolder, fileBase));
+}
+
+uint64_t Checksum(const uchar *data, uint64_t size)
+{
+    // FNV-1a over 8 byte words, plenty for detecting truncated or damaged files
+    uint64_t hash = 14695981039346656037ULL;
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t i = 0;
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(uint64_t));
+        hash = (hash ^ word) * prime;
+    }
+    for(; i < size; i++)
+        hash = (hash ^ data[i]) * prime;
+    return hash;
+}
+}
+
+namespace Impl{
+template <typename KeyType>
+inline uint32_t ShardForKey(KeyType key){
+    return static_cast<uint32_t>(key) % snapshot::shardCount;
+}
+
+inline void PrepareStream(QDataStream& stream){
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream.setByteOrder(QDataStream::LittleEndian);
+}
+
+// false if the value can't be stored in a shard
+template <typename ValueType>
+bool WriteValue(QDataStream& out, const ValueType& value){
+    if constexpr(is_roaring<ValueType>::value)
+    {
+        const auto size = value.getSizeInBytes();
+        if(size > static_cast<size_t>(std::numeric_limits<int>::max()))
+            return false;
+        QByteArray buffer(static_cast<int>(size), Qt::Uninitialized);
+        value.write(buffer.data());
+        out << static_cast<quint32>(buffer.size());
+        out.writeRawData(buffer.constData(), buffer.size());
+    }
+    else if constexpr(is_shared_ptr<ValueType>::value)
+        value->Serialize(out);
+    else if constexpr(std::is_same<ValueType, std::array<double, 22>>::value)
+    {
+        for(auto item : value)
+            out << item;
+    }
+    else
+        out << value;
+    return out.status() == QDataStream::Ok;
+}
+
+template <typename ValueType>
+bool ReadValue(QDataStream& in, const char* shardBegin, uint64_t shardSize, ValueType& value){
+    if constexpr(is_roaring<ValueType>::value)
+    {
+        quint32 size = 0;
+        in >> size;
+        const auto position = static_cast<uint64_t>(in.device()->pos());
+        if(position + size > shardSize)
+            return false;
+        // bitmaps are read from the mapped pages directly, no intermediate byte array
+        value = Roaring::readSafe(shardBegin + position, size);
+        in.skipRawData(static_cast<int>(size));
+    }
+    else if constexpr(is_shared_ptr<ValueType>::value)
+    {
+        value = ValueType(new typename ValueType::value_type());
+        value->Deserialize(in);
+    }
+    else if constexpr(std::is_same<ValueType, std::array<double, 22>>::value)
+    {
+        for(auto& item : value)
+            in >> item;
+    }
+    else
+        in >> value;
+    return in.status() == QDataStream::Ok;
+}
+
+template <typename HashType>
+bool SaveSnapshotImpl(QString storageFolder, QString fileBase, const HashType& data){
+    const QString fileName = snapshot::SnapshotFileName(storageFolder, fileBase);
+    const QString tempFileName = fileName + QString(".tmp");
+    QFile file(tempFileName);
+    if(!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        qDebug() << "Could not open file: " << tempFileName;
+        return false;
+    }
+
+    auto fail = [&](QString reason){
+        qDebug() << reason << tempFileName;
+        file.remove();
+        return false;
+    };
+
+    QVector<snapshot::ShardInfo> shards(snapshot::shardCount);
+    uint64_t offset = snapshot::dataOffset;
+    if(!file.seek(static_cast<qint64>(offset)))
+        return fail("Failed seeking to the data of snapshot: ");
+    // one shard is serialized at a time so that only a fraction of the data is duplicated in memory
+    for(uint32_t shard = 0; shard < snapshot::shardCount; shard++)
+    {
+        QByteArray buffer;
+        bool serialized = true;
+        {
+            QDataStream out(&buffer, QIODevice::WriteOnly);
+            Impl::PrepareStream(out);
+            for(auto it = data.cbegin(); it != data.cend() && serialized; it++)
+            {
+                if(Impl::ShardForKey(it.key()) != shard)
+                    continue;
+                out << it.key();
+                serialized = Impl::WriteValue(out, it.value());
+                shards[shard].entryCount++;
+            }
+        }
+        if(!serialized)
+            return fail(QString("Snapshot shard %1 has a value that is too large, not saving: ").arg(shard));
+        shards[shard].offset = offset;
+        shards[shard].size = static_cast<uint64_t>(buffer.size());
+        shards[shard].checksum = snapshot::Checksum(reinterpret_cast<const uchar*>(buffer.constData()), shards[shard].size);
+        if(file.write(buffer) != buffer.size())
+            return fail(QString("Failed writing snapshot shard %1 into: ").arg(shard));
+        offset += shards[shard].size;
+    }
+
+    snapshot::Header header;
+    std::memcpy(header.magic, snapshot::magic, sizeof(header.magic));
+    header.version = snapshot::currentVersion;
+    header.shardCount = snapshot::shardCount;
+    header.entryCount = static_cast<uint64_t>(data.size());
+    const qint64 shardTableSize = static_cast<qint64>(sizeof(snapshot::ShardInfo) * snapshot::shardCount);
+    // a short write here would leave a file that looks valid but points past its end
+    if(!file.seek(0)
+            || file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != static_cast<qint64>(sizeof(header))
+            || file.write(reinterpret_cast<const char*>(shards.constData()), shardTableSize) != shardTableSize)
+        return fail("Failed writing the header of snapshot: ");
+    if(!file.flush())
+        return fail("Failed flushing snapshot: ");
+    file.close();
+
+    QFile::remove(fileName);
+    if(!QFile::rename(tempFileName, fileName))
+    {
+        qDebug() << "Could not move snapshot into place: " << fileName;
+        return false;
+    }
+    qDebug() << "Saved snapshot: " << fileName << " entries: " << header.entryCount << " bytes: " << offset;
+    return true;
+}
+
+template <typename HashType>
+struct ShardLoadResult{
+    bool success = false;
+    HashType data;
+};
+
+template <typename HashType>
+bool LoadSnapshotImpl(QString storageFolder, QString fileBase, HashType& destination){
+    using KeyType = typename HashType::key_type;
+    using ValueType = typename HashType::mapped_type;
+
+    const QString fileName = snapshot::SnapshotFileName(storageFolder, fileBase);
+    QFile file(fileName);
+    if(!file.open(QFile::ReadOnly))
+        return false;
+    const auto fileSize = static_cast<uint64_t>(file.size());
+    if(fileSize < snapshot::dataOffset)
+    {
+        qDebug() << "Snapshot is truncated: " << fileName;
+        return false;
+    }
+    uchar* mapped = file.map(0, file.size());
+    if(!mapped)
+    {
+        qDebug() << "Could not map snapshot: " << fileName;
+        return false;
+    }
+
+    snapshot::Header header;
+    std::memcpy(&header, mapped, sizeof(header));
+    if(std::memcmp(header.magic, snapshot::magic, sizeof(header.magic)) != 0
+            || header.version != snapshot::currentVersion
+            || header.shardCount != snapshot::shardCount)
+    {
+        qDebug() << "Snapshot has unsupported format: " << fileName << " version: " << header.version;
+        file.unmap(mapped);
+        return false;
+    }
+    QVector<snapshot::ShardInfo> shards(snapshot::shardCount);
+    std::memcpy(shards.data(), mapped + sizeof(header), sizeof(snapshot::ShardInfo) * snapshot::shardCount);
+
+    auto loadShard = [mapped, fileSize](const snapshot::ShardInfo& shard){
+        ShardLoadResult<HashType> result;
+        if(shard.offset < snapshot::dataOffset || shard.offset + shard.size > fileSize)
+            return result;
+        // QByteArray and QDataStream can't address more than that
+        if(shard.size > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+        {
+            qDebug() << "Snapshot shard is too large: " << shard.size;
+            return result;
+        }
+        const uchar* shardBegin = mapped + shard.offset;
+        if(snapshot::Checksum(shardBegin, shard.size) != shard.checksum)
+            return result;
+
+        QByteArray rawShard = QByteArray::fromRawData(reinterpret_cast<const char*>(shardBegin), static_cast<int>(shard.size));
+        QBuffer buffer(&rawShard);
+        buffer.open(QIODevice::ReadOnly);
+        QDataStream in(&buffer);
+        Impl::PrepareStream(in);
+        result.data.reserve(static_cast<int>(shard.entryCount));
+        for(uint64_t i = 0; i < shard.entryCount; i++)
+        {
+            KeyType key;
+            in >> key;
+            ValueType value;
+            if(!Impl::ReadValue(in, reinterpret_cast<const char*>(shardBegin), shard.size, value))
+                return result;
+            result.data.insert(key, value);
+        }
+        result.success = true;
+        return result;
+    };
+    // shards differ in size a lot when a few keys hold most of the data
+    std::vector<ShardLoadResult<HashType>> results(static_cast<size_t>(shards.size()));
+    auto& scheduler = TaskScheduler::Instance();
+    const auto ranges = scheduler.SplitByCost(results.size(), [&shards](size_t index) -> uint64_t {
+        return shards[static_cast<int>(index)].size;
+    });
+    scheduler.ParallelFor(ranges, [&](size_t begin, size_t end){
+        for(size_t index = begin; index < end; index++)
+            results[index] = loadShard(shards[static_cast<int>(index)]);
+    });
+
+    bool success = true;
+    destination.clear();
+    destination.reserve(static_cast<int>(header.entryCount));
+    for(const auto& shardResult: results)
+    {
+        if(!shardResult.success)
+        {
+            success = false;
+            break;
+        }
+        destination.unite(shardResult.data);
+    }
+    file.unmap(mapped);
+    if(!success || static_cast<uint64_t>(destination.size()) != header.entryCount)
+    {
+        qDebug() << "Snapshot is damaged: " << fileName;
+        destination.clear();
+        return false;
+    }
+    qDebug() << "Loaded snapshot: " << fileName << " entries: " << destination.size();
+    return true;
+}
+}
+
+bool SaveSnapshot(QString storageFolder, QString fileBase, const QHash<int, Roaring>& data){
+    return Impl::SaveSnapshotImpl(storageFolder, fileBase, data);
+}
+bool SaveSnapshot(QString storageFolder, QString fileBase, const QHash<int, core::FicWeightPtr>& data){
+    return Impl::SaveSnapshotImpl(storageFolder, fileBase, data);
+}
+bool SaveSnapshot(QString storageFolder, QString fileBase, const QHash<int, std::array<double, 22>>& data){
+    return Impl::SaveSnapshotImpl(storageFolder, fileBase, data);
+}
+bool SaveSnapshot(QString storageFolder, QString fileBase, const QHash<int, QList<genre_stats::GenreBit>>& data){
+    return Impl::SaveSnapshotImpl(storageFolder, fileBase, data);
+}
+bool SaveSnapshot(QString storageFolder, QString fileBase, const QHash<uint32_t, genre_stats::ListMoodData>& data){
+    return Impl::SaveSnapshotImpl(storageFolder, fileBase, data);
+}
+
+bool LoadSnapshot(QString storageFolder, QString fileBase, QHash<int, Roaring>& data){
+    return Impl::LoadSnapshotImpl(storageFolder, fileBase, data);
+}
+bool LoadSnapshot(QString storageFolder, QString fileBase, QHash<int, core::FicWeightPtr>& data){
+    return Impl::LoadSnapshotImpl(storageFolder, fileBase, data);
+}
+bool LoadSnapshot(QString storageFolder, QString fileBase, QHash<int, std::array<double, 22>>& data){
+    return Impl::LoadSnapshotImpl(storageFolder, fileBase, data);
+}
+bool LoadSnapshot(QString storageFolder, QString fileBase, QHash<int, QList<genre_stats::GenreBit>>& data){
+    return Impl::LoadSnapshotImpl(storageFolder, fileBase, data);
+}
+bool LoadSnapshot(QString storageFolder, QString fileBase, QHash<uint32_t, genre_stats::ListMoodData>& data){
+    return Impl::LoadSnapshotImpl(storageFolder, fileBase, data);
+}
+}
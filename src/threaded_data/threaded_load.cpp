@@ -17,14 +17,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
 #include "threaded_data/threaded_load.h"
 #include "threaded_data/common_traits.h"
+#include "task_scheduler.h"
 
 #include <QThread>
 #include <QDebug>
 #include <QStringList>
 #include <QDataStream>
-#include <QFuture>
-#include <QFutureWatcher>
-#include <QtConcurrent>
 #include <iostream>
 namespace thread_boost{
 namespace  Impl{
@@ -121,22 +119,24 @@ auto valueFetcher){
 
 
 auto loadMultiThreaded = [](auto loaderFunc, auto resultUnifier, QString nameBase,auto& destination){
-    QVector<QFuture<typename std::remove_reference<decltype(destination)>::type>> futures;
-    for(int i = 0; i < QThread::idealThreadCount()-1; i++)
-    {
-        futures.push_back(QtConcurrent::run([nameBase,i, loaderFunc](){
+    using ContainerType = typename std::remove_reference<decltype(destination)>::type;
+    // the amount of files depends on the core count of the machine that saved them
+    int fileCount = 0;
+    while(QFile::exists(QString("%1_%2.txt").arg(nameBase,QString::number(fileCount))))
+        fileCount++;
+    std::vector<ContainerType> results(static_cast<size_t>(fileCount));
+    auto& scheduler = TaskScheduler::Instance();
+    scheduler.ParallelFor(scheduler.SplitEvenly(results.size()), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++)
+        {
             qDebug() << "loading file: " << i;
-            return loaderFunc(nameBase, [](){return typename std::remove_reference<decltype(destination)>::type();},i);
-        }));
-    }
-    for(auto future: futures)
-    {
-        future.waitForFinished();
-    }
+            results[i] = loaderFunc(nameBase, [](){return ContainerType();}, static_cast<int>(i));
+        }
+    });
     qDebug() << "starting unification";
-    for(auto future: futures)
+    for(auto& result: results)
     {
-        resultUnifier(destination, future.result());
+        resultUnifier(destination, result);
     }
     qDebug() << "finished unification, size:" << destination.size() ;
 
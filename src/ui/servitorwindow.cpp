@@ -30,6 +30,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include "include/sqlitefunctions.h"
 
 #include "include/tasks/slash_task_processor.h"
+#include "include/data_code/fic_cooccurrence.h"
 #include <QTextCodec>
 #include <QSettings>
 #include <QSqlRecord>
@@ -1500,16 +1501,6 @@ void ServitorWindow::LoadDataForCalculation(CalcDataHolder& cdh)
 
 }
 
-struct FicPair{
-    //    /uint32_t count = 0;
-    //    float val1;
-    //    float val2;
-    //    float val3;
-    //    float val4;
-    //    float val5;
-    Roaring r;
-};
-
 //struct SmartHash{
 //    void CleanTemporaryStorage();
 //    void PrepareForList(const QList<QPair<uint32_t, uint32_t>>& list);
@@ -1644,148 +1635,35 @@ void ServitorWindow::CalcConstantMemory()
 
 void ServitorWindow::on_pbCalcWeights_clicked()
 {
-
-
-    //    CalcConstantMemory();
-    //    return;
     CalcDataHolder cdh;
     LoadDataForCalculation(cdh);
     ProcessCDHData(cdh);
-    //QHash<int, core::FicWeightResult> result;
-    //QSet<int> alreadyProcessed;
-
-    //QHash<QPair<int, int>, QSet<int>> meetingSet;
-    QHash<QPair<uint32_t, uint32_t>, FicPair> ficsMeeting;
-    QHash<QPair<uint32_t, uint32_t>, FicPair>::iterator ficsIterator;
-    QHash<QPair<int, int>, QSet<int>>::iterator meetingIterator;
-    //QHash<QPair<uint32_t, uint32_t>, Roaring> roaringSet;
-    QHash<QPair<uint32_t, uint32_t>, Roaring>::iterator roaringIterator;
-
-
-    //            {
-    //                auto ficIds = ficData.keys();
-    //                for(int i = 0; i < ficIds.size(); i++)
-    //                {
-    //                    if(i%10 == 0)
-    //                        qDebug() << "working at: " << i;
-    //                    auto fic1 = ficIds[i];
-    //                    for(int j = i+1; j < ficIds.size(); j++)
-    //                    {
-    //                        auto fic2 = ficIds[i];
-    //                        auto keys = cdh.favourites.keys();
-    //                        QVector<int> intersection;
-    //                        auto& set1 = ficsToFavLists[fic1];
-    //                        auto& set2 = ficsToFavLists[fic2];
-    //                        intersection.reserve(std::max(set1.size(), set2.size()));
-    //                        std::set_intersection(set1.begin(), set1.end(),
-    //                                              set2.begin(), set2.end(),
-    //                                               std::back_inserter(intersection));
-    //                        ficsMeeting[{fic1, fic2}].count = intersection.size();
-    //                    }
-    //                }
-    //            }
-    // need to create limited sets of unique pairs
-    //    QList<QPair<int, int>> pairList;
-    //    {
-    //        auto ficIds = ficData.keys();
-    //        for(int i = 0; i < ficIds.size(); i++)
-    //        {
-    //            for(int j = i+1; j < ficIds.size(); j++)
-    //            {
-    //                pairList.push_back({ficIds[i], ficIds[j]});
-    //            }
-    //        }
-    //    }
 
-    {
-        int counter = 0;
-        QPair<uint32_t, uint32_t> pair;
-        qDebug() << "full fav size: " << cdh.filteredFavourites.size();
-        for(const auto& fav : std::as_const(cdh.filteredFavourites))
-        {
-            auto values = fav.favourites.toList();
-            if(counter%100 == 0)
-                qDebug() << " At: " << counter << " size: " << values.size();
-            counter++;
-            if(counter > 213000 && counter%1000 == 0)
-                ficsMeeting.squeeze();
-
-            //qDebug() << "Reading list of size: " << values.size();
-            for(int i = 0; i < values.size(); i++)
-            {
-                for(int j = i+1; j < values.size(); j++)
-                {
-                    uint32_t fic1 = values[i];
-                    uint32_t fic2 = values[j];
-
-                    //QPair<uint32_t, uint32_t> pair (std::min(fic1,fic2), std::max(fic1,fic2));
-                    pair.first = std::min(fic1,fic2);
-                    pair.second = std::max(fic1,fic2);
-                    //QPair<uint32_t, uint32_t> pair2 = {std::min(fic1,fic2), std::max(fic1,fic2)};
-                    //qDebug() << pair;
-                    //qDebug() << pair2;
-                    //roaring attempt
-                    //                    roaringIterator = roaringSet.find(pair);
-                    //                    if(roaringIterator == roaringSet.end())
-                    //                    {
-                    //                        roaringSet[pair];
-                    //                        roaringIterator = roaringSet.find(pair);
-                    //                    }
-
-                    //                    roaringIterator->add(fav.id);
-                    //                    roaringIterator->shrinkToFit();
-                    //meeting attempt
-                    //                    meetingIterator = meetingSet.find(pair);
-                    //                    if(meetingIterator == meetingSet.end())
-                    //                    {
-                    //                        meetingSet[pair];
-                    //                        meetingIterator = meetingSet.find(pair);
-                    //                    }
-
-                    //                    meetingIterator->insert(key);
-                    //valueattempt
-                    ficsIterator = ficsMeeting.find(pair);
-                    if(ficsIterator == ficsMeeting.end())
-                    {
-                        ficsMeeting[pair];
-                        ficsIterator = ficsMeeting.find(pair);
-                    }
-
-                    //ficsIterator.value().count++;
-                    ficsIterator.value().r.add(fav.id);
-                    if(counter > 213000)
-                        ficsIterator.value().r.shrinkToFit();
-                    //                    pairCounter++;
-                }
-            }
-            //qDebug() << "List had: " << pairCounter << " pairs";
-        }
-    }
-    int countPairs = 0;
-    int countListRecords = 0;
+    QSettings settings("settings/servitor.ini", QSettings::IniFormat);
+    core::FicCooccurrenceSettings cooccurrenceSettings;
+    cooccurrenceSettings.workFolder = settings.value("Cooccurrence/workFolder", "TempData/cooccurrence").toString();
+    cooccurrenceSettings.partitions = settings.value("Cooccurrence/partitions", 64).toUInt();
+    cooccurrenceSettings.bufferedPairs = settings.value("Cooccurrence/bufferedPairs", 1u << 23).toUInt();
+    cooccurrenceSettings.minimumSupport = settings.value("Cooccurrence/minimumSupport", 2).toUInt();
+    cooccurrenceSettings.topNeighbours = settings.value("Cooccurrence/topNeighbours", 100).toUInt();
+    cooccurrenceSettings.threads = settings.value("Cooccurrence/threads", QThread::idealThreadCount()).toInt();
+
+    core::FicCooccurrenceMatrix matrix;
+    TimedAction action("Building fic cooccurrence",[&](){
+        matrix = core::BuildFicCooccurrence(cdh.filteredFavourites, cooccurrenceSettings);
+    });
+    action.run();
+    matrix.Save(settings.value("Cooccurrence/matrixFile", "TempData/fic_cooccurrence.bin").toString());
 
-    for(const auto& edge: std::as_const(ficsMeeting))
-    {
-        countPairs++;
-        countListRecords+=edge.r.cardinality();
-    }
-    qDebug() << "edge count: " << countPairs;
-    qDebug() << "list records count: " << countListRecords;
-    //    auto values = ficsMeeting.values();
-    //    std::sort(values.begin(), values.end(), [](const FicPair& fp1, const FicPair& fp2){
-    //        return fp1.count > fp2.count;
-    //    });
-    //    QString prototype = "SELECT * FROM fanfics where  id in (%1, %2)";
-    //    for(int i = 0; i < 10; i++)
-    //    {
-    //        QString temp = prototype;
-    //        //qDebug() << << values[i].fic1 << " " << values[i].fic2 << " " << values[i].meetings.size();
-    //        qDebug().noquote() << temp.arg(values[i].fic1) .arg(values[i].fic2);
-    //        qDebug() << "Met times: " << values[i].count;
-    //        qDebug() << " ";
-    //    }
-
-    //fanficsInterface->WriteFicRelations(result);
+    if(!settings.value("Cooccurrence/writeToDatabase", false).toBool())
+        return;
+    auto db = sql::Database::database();
+    database::Transaction transaction(db);
+    TimedAction writeAction("Writing fic relations",[&](){
+        if(env.interfaces.fanfics->WriteFicRelations(core::FicRelationsFromMatrix(matrix, ficData)))
+            transaction.finalize();
+    });
+    writeAction.run();
 }
 
 